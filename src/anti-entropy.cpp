@@ -0,0 +1,390 @@
+#include "anti-entropy.hpp"
+#include "command-codes.hpp"
+#include "tlv.hpp"
+
+#include <ndn-cxx/util/logger.hpp>
+
+#define LEAF_PAGE_SIZE 64
+#define AE_WINDOW 64
+#define BOOTSTRAP_WINDOW 256
+#define BOOTSTRAP_ATTEMPTS 3
+
+namespace kua {
+
+NDN_LOG_INIT(kua.antientropy);
+
+AntiEntropy::AntiEntropy(ConfigBundle& configBundle, const Bucket& bucket, ndn::Face& face,
+                         Dispatcher& dispatcher, std::shared_ptr<Store> store, Repair repair)
+  : m_bucket(bucket)
+  , m_nodePrefix(configBundle.nodePrefix)
+  , m_face(face)
+  , m_scheduler(face.getIoService())
+  , m_keyChain(configBundle.keyChain)
+  , m_dispatcher(dispatcher)
+  , m_store(store)
+  , m_repair(std::move(repair))
+  , m_rng(ndn::random::getRandomNumberEngine())
+  , m_intervalDist(ANTI_ENTROPY_INTERVAL_MS * 0.9, ANTI_ENTROPY_INTERVAL_MS * 1.1)
+{
+  scheduleRound();
+}
+
+void
+AntiEntropy::scheduleRound()
+{
+  m_roundEvent = m_scheduler.schedule(ndn::time::milliseconds(m_intervalDist(m_rng)),
+                                      [this] { startRound(); });
+}
+
+void
+AntiEntropy::startRound()
+{
+  scheduleRound();
+
+  // Skip while a walk (e.g. bootstrap) is still running
+  if (m_round)
+    return;
+
+  beginRound(nullptr);
+}
+
+bool
+AntiEntropy::beginRound(std::function<void(bool)> onFinish, bool isSpread)
+{
+  // Pick a random replica other than this node
+  std::vector<ndn::Name> peers;
+  for (const auto& host : m_bucket.confirmedHosts)
+    if (host.first != m_nodePrefix)
+      peers.push_back(host.first);
+
+  if (peers.empty())
+    return false;
+
+  std::uniform_int_distribution<size_t> peerDist(0, peers.size() - 1);
+
+  m_round = std::make_shared<Round>();
+  m_round->peer = peers[peerDist(m_rng)];
+  m_round->onFinish = std::move(onFinish);
+  if (isSpread)
+    m_round->peers = peers;
+
+  NDN_LOG_TRACE("#" << m_bucket.id << " : AE_ROUND : " << m_round->peer);
+  requestNode(m_round->peer, 0, 0, 0);
+  return true;
+}
+
+void
+AntiEntropy::finishRound(std::shared_ptr<Round> round)
+{
+  if (m_round == round)
+    m_round.reset();
+
+  NDN_LOG_TRACE("#" << m_bucket.id << " : AE_ROUND_DONE : " << round->peer
+                << " : FETCHED " << round->fetched << " : FAILED " << round->failures);
+
+  if (round->onFinish)
+    round->onFinish(round->failures == 0);
+}
+
+void
+AntiEntropy::bootstrap(std::function<void()> onCaughtUp)
+{
+  NDN_LOG_INFO("#" << m_bucket.id << " : BOOTSTRAP_START");
+
+  m_onCaughtUp = std::move(onCaughtUp);
+  m_bootstrapAttempts = 0;
+  bootstrapAttempt();
+}
+
+void
+AntiEntropy::bootstrapAttempt()
+{
+  m_bootstrapAttempts++;
+
+  auto done = [this] {
+    NDN_LOG_INFO("#" << m_bucket.id << " : BOOTSTRAP_DONE : "
+                 << m_store->getStats().nEntries << " entries");
+    auto onCaughtUp = std::move(m_onCaughtUp);
+    m_onCaughtUp = nullptr;
+    if (onCaughtUp)
+      onCaughtUp();
+  };
+
+  bool started = beginRound([this, done] (bool ok) {
+    // Retry failed walks, likely against another replica
+    if (!ok && m_bootstrapAttempts < BOOTSTRAP_ATTEMPTS)
+      return bootstrapAttempt();
+    done();
+  }, true);
+
+  // First replica of the bucket
+  if (!started)
+    done();
+}
+
+void
+AntiEntropy::express(const ndn::Interest& interest, std::function<void(const ndn::Data&)> onData)
+{
+  auto round = m_round;
+  if (!round)
+    return;
+
+  round->pending++;
+
+  m_queue.push_back([this, round, interest, onData] {
+    m_inFlight++;
+    m_face.expressInterest(interest,
+      [this, round, onData] (const auto&, const auto& data) {
+        onData(data);
+        complete(round, true);
+      },
+      [this, round] (const auto&, const auto&) {
+        complete(round, false);
+      },
+      [this, round] (const auto&) {
+        complete(round, false);
+      });
+  });
+
+  pump();
+}
+
+void
+AntiEntropy::complete(std::shared_ptr<Round> round, bool ok)
+{
+  m_inFlight--;
+
+  if (!ok)
+    round->failures++;
+
+  if (--round->pending == 0)
+    finishRound(round);
+
+  pump();
+}
+
+void
+AntiEntropy::pump()
+{
+  // A bootstrapping replica serves nothing yet, so it can pull harder
+  const size_t window = m_onCaughtUp ? BOOTSTRAP_WINDOW : AE_WINDOW;
+  while (m_inFlight < window && !m_queue.empty())
+  {
+    auto next = std::move(m_queue.front());
+    m_queue.pop_front();
+    next();
+  }
+}
+
+void
+AntiEntropy::requestNode(const ndn::Name& peer, size_t level, size_t index, uint64_t page)
+{
+  ndn::Name node;
+  node.appendNumber(level).appendNumber(index).appendNumber(page);
+
+  ndn::Name interestName(peer);
+  interestName.appendNumber(m_bucket.id);
+  interestName.append(node.wireEncode());
+  interestName.appendNumber(CommandCodes::DIGEST);
+
+  ndn::Interest interest(interestName);
+  interest.setCanBePrefix(false);
+  interest.setMustBeFresh(true);
+
+  ndn::security::SigningInfo interestSigningInfo;
+  interestSigningInfo.setSha256Signing();
+  interestSigningInfo.setSignedInterestFormat(ndn::security::SignedInterestFormat::V03);
+  m_keyChain.sign(interest, interestSigningInfo);
+
+  express(interest, [=] (const ndn::Data& data) {
+    try {
+      if (level < DigestTree::DEPTH)
+        onInternalNode(peer, level, index, data.getContent());
+      else
+        onLeaf(peer, index, page, data.getContent());
+    }
+    catch (const ndn::tlv::Error& e) {
+      NDN_LOG_DEBUG("#" << m_bucket.id << " : AE_BAD_REPLY : " << peer << " : " << e.what());
+    }
+  });
+}
+
+void
+AntiEntropy::onDigestRequest(const ndn::Name& node, const ndn::Interest& request)
+{
+  if (node.size() != 3 || !node[0].isNumber() || !node[1].isNumber() || !node[2].isNumber())
+    return;
+
+  const size_t level = node[0].toNumber();
+  const size_t index = node[1].toNumber();
+  const uint64_t page = node[2].toNumber();
+  const auto& tree = m_store->getDigestTree();
+
+  ndn::Data response(request.getName());
+  response.setFreshnessPeriod(ndn::time::milliseconds(0));
+
+  if (level < DigestTree::DEPTH)
+  {
+    size_t width = 1;
+    for (size_t l = 0; l < level; l++)
+      width *= DigestTree::FANOUT;
+
+    if (index >= width)
+      return;
+
+    // Own digest followed by the digests of all children
+    std::vector<uint8_t> buf;
+    buf.reserve((DigestTree::FANOUT + 1) * sizeof(DigestTree::Digest));
+
+    const auto& digest = tree.getNode(level, index);
+    buf.insert(buf.end(), digest.begin(), digest.end());
+
+    for (size_t c = 0; c < DigestTree::FANOUT; c++)
+    {
+      const auto& child = tree.getNode(level + 1, index * DigestTree::FANOUT + c);
+      buf.insert(buf.end(), child.begin(), child.end());
+    }
+
+    response.setContent(buf.data(), buf.size());
+  }
+  else if (level == DigestTree::DEPTH && index < DigestTree::NUM_LEAVES)
+  {
+    // One page of full names in the leaf
+    ndn::Block content(ndn::tlv::Content);
+
+    const auto& entries = tree.getLeaf(index);
+    auto it = entries.begin();
+    for (uint64_t i = 0; i < page * LEAF_PAGE_SIZE && it != entries.end(); i++)
+      it++;
+
+    for (size_t i = 0; i < LEAF_PAGE_SIZE && it != entries.end(); i++, it++)
+    {
+      ndn::Name fullName(it->first);
+      fullName.appendImplicitSha256Digest(it->second.data(), it->second.size());
+      content.push_back(fullName.wireEncode());
+
+      // Entries with a TTL keep it on the replica that pulls them
+      if (uint64_t ttl = m_store->getTtl(it->first))
+        content.push_back(ndn::encoding::makeNonNegativeIntegerBlock(tlv::EntryTtl, ttl));
+      content.push_back(ndn::encoding::makeNonNegativeIntegerBlock(tlv::EntryWriteTime,
+                                                                   m_store->getWriteTime(it->first)));
+    }
+
+    content.encode();
+    response.setContent(content);
+  }
+  else
+  {
+    return;
+  }
+
+  ndn::security::SigningInfo info;
+  info.setSha256Signing();
+  m_keyChain.sign(response, info);
+  m_dispatcher.put(response);
+}
+
+void
+AntiEntropy::onInternalNode(const ndn::Name& peer, size_t level, size_t index, const ndn::Block& content)
+{
+  constexpr size_t DIGEST_SIZE = sizeof(DigestTree::Digest);
+  if (content.value_size() != (DigestTree::FANOUT + 1) * DIGEST_SIZE)
+    NDN_THROW(ndn::tlv::Error("Unexpected digest node size"));
+
+  const auto& tree = m_store->getDigestTree();
+  const uint8_t* remote = content.value();
+
+  // Subtree is in sync
+  if (std::equal(remote, remote + DIGEST_SIZE, tree.getNode(level, index).begin()))
+    return;
+
+  for (size_t c = 0; c < DigestTree::FANOUT; c++)
+  {
+    const uint8_t* remoteChild = remote + (c + 1) * DIGEST_SIZE;
+    const size_t childIndex = index * DigestTree::FANOUT + c;
+
+    // Each subtree of the root from another replica when spread
+    const auto& round = m_round;
+    const ndn::Name& childPeer = level == 0 && round && !round->peers.empty()
+                                 ? round->peers[c % round->peers.size()] : peer;
+
+    if (!std::equal(remoteChild, remoteChild + DIGEST_SIZE, tree.getNode(level + 1, childIndex).begin()))
+      requestNode(childPeer, level + 1, childIndex, 0);
+  }
+}
+
+void
+AntiEntropy::onLeaf(const ndn::Name& peer, size_t index, uint64_t page, const ndn::Block& content)
+{
+  content.parse();
+
+  const auto& entries = m_store->getDigestTree().getLeaf(index);
+
+  size_t count = 0;
+  const auto& elements = content.elements();
+  for (auto it = elements.begin(); it != elements.end(); it++)
+  {
+    if (it->type() != ndn::tlv::Name)
+      continue;
+    count++;
+
+    ndn::Name fullName(*it);
+    if (fullName.empty() || !fullName[-1].isImplicitSha256Digest())
+      continue;
+
+    uint64_t ttl = 0, writeTime = 0;
+    for (; it + 1 != elements.end() && (it + 1)->type() != ndn::tlv::Name; it++)
+    {
+      if ((it + 1)->type() == tlv::EntryTtl)
+        ttl = ndn::encoding::readNonNegativeInteger(*(it + 1));
+      else if ((it + 1)->type() == tlv::EntryWriteTime)
+        writeTime = ndn::encoding::readNonNegativeInteger(*(it + 1));
+    }
+
+    // Pull entries missing here, and versions written later than the one here.
+    // Entries deleted here stay deleted.
+    const ndn::Name name = fullName.getPrefix(-1);
+    if (entries.count(name) ? !m_store->isSuperseded(name, writeTime, fullName[-1])
+                            : !m_store->isRemoved(name))
+      fetchEntry(peer, fullName, ttl, writeTime);
+  }
+
+  if (count == LEAF_PAGE_SIZE)
+    requestNode(peer, DigestTree::DEPTH, index, page + 1);
+}
+
+void
+AntiEntropy::fetchEntry(const ndn::Name& peer, const ndn::Name& fullName, uint64_t ttl, uint64_t writeTime)
+{
+  ndn::Name hint(peer);
+  hint.appendNumber(m_bucket.id);
+  hint.appendNumber(CommandCodes::FETCH);
+
+  ndn::Interest interest(fullName);
+  interest.setCanBePrefix(false);
+  interest.setMustBeFresh(false);
+  interest.setForwardingHint(ndn::DelegationList({{15893, hint }}));
+
+  auto round = m_round;
+  express(interest, [this, round, ttl, writeTime] (const ndn::Data& data) {
+    // The round is not over until the entry is stored, so bootstrap does not announce early
+    round->pending++;
+    m_repair(data, ttl, writeTime, [this, round, name = data.getName()] (bool ok) {
+      if (ok)
+      {
+        round->fetched++;
+        NDN_LOG_TRACE("#" << m_bucket.id << " : AE_FETCHED : " << name);
+      }
+      else
+      {
+        round->failures++;
+        NDN_LOG_TRACE("#" << m_bucket.id << " : FAILED_STORE_PUT : " << name);
+      }
+
+      if (--round->pending == 0)
+        finishRound(round);
+    });
+  });
+}
+
+} // namespace kua
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <ndn-cxx/util/scheduler.hpp>
+#include <ndn-cxx/util/random.hpp>
+
+#include <deque>
+
+#include "config-bundle.hpp"
+#include "bucket.hpp"
+#include "store.hpp"
+#include "dispatcher.hpp"
+
+namespace kua {
+
+/**
+ * Anti-entropy between replicas of a bucket.
+ *
+ * Periodically compares the digest tree of the local store with a random
+ * replica, descending only into subtrees that differ, and fetches the
+ * entries missing locally or written later at the peer. Fetched entries are
+ * handed to the worker, which stores them like inserts. The same walk bootstraps a new replica, with
+ * the subtrees of the root spread over all other replicas and a wider
+ * window, so a copy is not limited by a single source.
+ */
+class AntiEntropy
+{
+public:
+  /**
+   * Store a fetched entry with its TTL in ms or 0 and its write time,
+   * then call done with whether it was stored
+   */
+  using Repair = std::function<void(const ndn::Data&, uint64_t, uint64_t, std::function<void(bool)>)>;
+
+  AntiEntropy(ConfigBundle& configBundle, const Bucket& bucket, ndn::Face& face,
+              Dispatcher& dispatcher, std::shared_ptr<Store> store, Repair repair);
+
+  /**
+   * Pull the contents of the bucket from another replica.
+   * @param onCaughtUp called once the walk has completed
+   */
+  void
+  bootstrap(std::function<void()> onCaughtUp);
+
+  /** Reply to a digest request for the tree node /<level>/<index>/<page> */
+  void
+  onDigestRequest(const ndn::Name& node, const ndn::Interest& request);
+
+private:
+  /** State of one walk over the tree of a peer */
+  struct Round
+  {
+    ndn::Name peer;
+    /** Replicas the subtrees of the root are spread over */
+    std::vector<ndn::Name> peers;
+    size_t pending = 0;
+    size_t failures = 0;
+    size_t fetched = 0;
+    std::function<void(bool)> onFinish;
+  };
+
+  void
+  scheduleRound();
+
+  void
+  startRound();
+
+  /**
+   * Start a walk against a random other replica, or against all of them
+   * @return false if there is no other replica
+   */
+  bool
+  beginRound(std::function<void(bool)> onFinish, bool isSpread = false);
+
+  void
+  finishRound(std::shared_ptr<Round> round);
+
+  void
+  bootstrapAttempt();
+
+  void
+  requestNode(const ndn::Name& peer, size_t level, size_t index, uint64_t page);
+
+  void
+  onInternalNode(const ndn::Name& peer, size_t level, size_t index, const ndn::Block& content);
+
+  void
+  onLeaf(const ndn::Name& peer, size_t index, uint64_t page, const ndn::Block& content);
+
+  /** Fetch an entry from the peer by its full name, with its remaining TTL in ms or 0 and write time */
+  void
+  fetchEntry(const ndn::Name& peer, const ndn::Name& fullName, uint64_t ttl, uint64_t writeTime);
+
+  /** Queue an Interest of the current round, keeping at most AE_WINDOW in flight */
+  void
+  express(const ndn::Interest& interest, std::function<void(const ndn::Data&)> onData);
+
+  void
+  complete(std::shared_ptr<Round> round, bool ok);
+
+  void
+  pump();
+
+private:
+  const Bucket& m_bucket;
+  ndn::Name m_nodePrefix;
+  ndn::Face& m_face;
+  ndn::Scheduler m_scheduler;
+  ndn::KeyChain& m_keyChain;
+  Dispatcher& m_dispatcher;
+  std::shared_ptr<Store> m_store;
+  Repair m_repair;
+
+  ndn::random::RandomNumberEngine& m_rng;
+  std::uniform_int_distribution<> m_intervalDist;
+
+  ndn::scheduler::ScopedEventId m_roundEvent;
+
+  std::shared_ptr<Round> m_round;
+  std::deque<std::function<void()>> m_queue;
+  size_t m_inFlight = 0;
+
+  std::function<void()> m_onCaughtUp;
+  size_t m_bootstrapAttempts = 0;
+};
+
+} // namespace kua
@@ -48,6 +48,40 @@ AuctionMessage::wireEncode() const
     K_ENCODE_BLK(vv.encode(), tlv::AuctionWinnerList);
   }
 
+  if (!readerList.empty())
+  {
+    ndn::svs::VersionVector vv;
+    for (const auto& r : readerList)
+      vv.set(r, 1);
+    K_ENCODE_BLK(vv.encode(), tlv::AuctionReaderList);
+  }
+
+  if (messageType == Type::Load)
+    K_ENCODE_NNI(readRate, tlv::AuctionReadRate);
+
+  if (!rttList.empty())
+  {
+    ndn::svs::VersionVector vv;
+    for (const auto& r : rttList)
+      vv.set(r.first, r.second);
+    K_ENCODE_BLK(vv.encode(), tlv::AuctionRttList);
+  }
+
+  if (!failureDomain.empty())
+  {
+    size_t valLength = enc.prependByteArray(reinterpret_cast<const uint8_t*>(failureDomain.data()),
+                                            failureDomain.size());
+    totalLength += enc.prependVarNumber(valLength);
+    totalLength += enc.prependVarNumber(tlv::AuctionFailureDomain);
+    totalLength += valLength;
+  }
+
+  if (assignmentVersion > 0)
+    K_ENCODE_NNI(assignmentVersion, tlv::AuctionAssignmentVersion);
+
+  if (epoch > 0)
+    K_ENCODE_NNI(epoch, tlv::AuctionEpoch);
+
   K_ENCODE_NNI(bucketId, tlv::BucketId);
   K_ENCODE_NNI(auctionId, tlv::AuctionId);
   K_ENCODE_NNI(messageType, tlv::AuctionMessageType);
@@ -80,6 +114,12 @@ AuctionMessage::wireDecode(const ndn::Block& block)
     NDN_THROW(ndn::tlv::Error("Invalid AuctionMessage"));
   }
 
+  if (block.find(tlv::AuctionEpoch) != block.elements_end())
+    K_READ_NNI(epoch, tlv::AuctionEpoch);
+
+  if (block.find(tlv::AuctionAssignmentVersion) != block.elements_end())
+    K_READ_NNI(assignmentVersion, tlv::AuctionAssignmentVersion);
+
   if (block.find(tlv::AuctionBidAmount) != block.elements_end())
     K_READ_NNI(bidAmount, tlv::AuctionBidAmount);
 
@@ -94,6 +134,28 @@ AuctionMessage::wireDecode(const ndn::Block& block)
       winnerList.push_back(w.first);
   }
 
+  if (block.find(tlv::AuctionReaderList) != block.elements_end())
+  {
+    ndn::svs::VersionVector vv(block.get(tlv::AuctionReaderList).blockFromValue());
+    readerList.clear();
+    for (const auto& r : vv)
+      readerList.push_back(r.first);
+  }
+
+  if (block.find(tlv::AuctionReadRate) != block.elements_end())
+    K_READ_NNI(readRate, tlv::AuctionReadRate);
+
+  if (block.find(tlv::AuctionFailureDomain) != block.elements_end())
+    failureDomain = ndn::encoding::readString(block.get(tlv::AuctionFailureDomain));
+
+  if (block.find(tlv::AuctionRttList) != block.elements_end())
+  {
+    ndn::svs::VersionVector vv(block.get(tlv::AuctionRttList).blockFromValue());
+    rttList.clear();
+    for (const auto& r : vv)
+      rttList[r.first] = r.second;
+  }
+
 #undef K_READ_NNI
 }
 
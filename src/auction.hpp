@@ -6,6 +6,8 @@
 #include <ndn-cxx/encoding/block.hpp>
 #include <ndn-cxx/name.hpp>
 
+#include <map>
+
 typedef unsigned int auction_id_t;
 
 namespace kua {
@@ -18,6 +20,11 @@ struct AuctionMessage
     Win = 3,
     WinAck = 4,
     AuctionEnd = 5,
+    Lease = 6,
+    /** Read rate of a bucket at a host, from the host */
+    Load = 7,
+    /** Failure domain of a host and its round-trip times to others, from the host */
+    Topology = 8,
   };
 
   Type messageType;
@@ -25,6 +32,9 @@ struct AuctionMessage
   auction_id_t auctionId;
   bucket_id_t bucketId;
 
+  /** Leadership epoch of the master sending this message */
+  uint64_t epoch = 0;
+
   AuctionMessage() = default;
 
   AuctionMessage(Type _messageType,
@@ -39,6 +49,18 @@ struct AuctionMessage
 
   // TypeAuctionEnd
   std::vector<ndn::Name> winnerList;
+  /** Extra read-only replicas */
+  std::vector<ndn::Name> readerList;
+  /** Raised by the master with every change of the hosts; with the epoch, orders AuctionEnds */
+  uint64_t assignmentVersion = 0;
+
+  // TypeLoad: reads per second
+  uint64_t readRate = 0;
+
+  // TypeTopology
+  std::string failureDomain;
+  /** Smoothed round-trip time to each node probed, in microseconds */
+  std::map<ndn::Name, uint64_t> rttList;
 
   void
   wireDecode(const ndn::Block& block);
@@ -0,0 +1,265 @@
+#include "batch-transport.hpp"
+#include "config-bundle.hpp"
+
+#include <ndn-cxx/util/config-file.hpp>
+#include <ndn-cxx/util/logger.hpp>
+
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <tuple>
+
+namespace kua {
+
+NDN_LOG_INIT(kua.transport);
+
+std::shared_ptr<BatchTransport>
+BatchTransport::create()
+{
+  // Same lookup as the default transport of ndn::Face
+  std::string uri;
+  if (const char* env = std::getenv("NDN_CLIENT_TRANSPORT"))
+    uri = env;
+  else
+    uri = ndn::ConfigFile().getParsedConfiguration().get<std::string>("transport", "");
+
+  if (uri.empty())
+  {
+#ifdef __APPLE__
+    return std::make_shared<BatchTransport>("/var/run/nfd.sock");
+#else
+    return std::make_shared<BatchTransport>("/run/nfd.sock");
+#endif
+  }
+
+  const std::string scheme = "unix://";
+  if (uri.compare(0, scheme.size(), scheme) != 0)
+    return nullptr;
+
+  return std::make_shared<BatchTransport>(uri.substr(scheme.size()));
+}
+
+BatchTransport::BatchTransport(const std::string& socketPath)
+  : m_socketPath(socketPath)
+{ }
+
+BatchTransport::~BatchTransport()
+{
+  close();
+}
+
+void
+BatchTransport::connect(boost::asio::io_service& ioService, ReceiveCallback receiveCallback)
+{
+  Transport::connect(ioService, std::move(receiveCallback));
+
+  m_socket = std::make_unique<boost::asio::local::stream_protocol::socket>(ioService);
+
+  // The forwarder is local, so there is no point connecting asynchronously
+  boost::system::error_code error;
+  m_socket->connect(boost::asio::local::stream_protocol::endpoint(m_socketPath), error);
+  if (error)
+  {
+    m_socket.reset();
+    NDN_THROW(Error(error, "cannot connect to forwarder at " + m_socketPath));
+  }
+
+  m_isConnected = true;
+  resume();
+
+  // Packets sent before connecting
+  flush();
+}
+
+void
+BatchTransport::close()
+{
+  m_isConnected = false;
+  m_isReceiving = false;
+
+  if (!m_socket)
+    return;
+
+  boost::system::error_code error;
+  m_socket->cancel(error);
+  m_socket->shutdown(boost::asio::socket_base::shutdown_both, error);
+  m_socket->close(error);
+  m_socket.reset();
+
+  m_queue.clear();
+  m_queuedBytes = 0;
+  m_inputBufferSize = 0;
+}
+
+void
+BatchTransport::pause()
+{
+  // A read in flight completes, but the next one waits for resume
+  m_isReceiving = false;
+}
+
+void
+BatchTransport::resume()
+{
+  if (!m_isConnected)
+    return;
+
+  m_isReceiving = true;
+  if (!m_isReading)
+    asyncRead();
+}
+
+void
+BatchTransport::send(const ndn::Block& wire)
+{
+  m_queue.push_back(wire);
+  m_queuedBytes += wire.size();
+
+  if (!m_isConnected)
+    return;
+
+  if (m_queuedBytes >= BATCH_MAX_BYTES)
+    return flush();
+
+  // Coalesce with everything else sent in this turn
+  if (m_isFlushScheduled)
+    return;
+
+  m_isFlushScheduled = true;
+  m_ioService->post([self = shared_from_this()] {
+    self->m_isFlushScheduled = false;
+    self->flush();
+  });
+}
+
+void
+BatchTransport::send(const ndn::Block& header, const ndn::Block& payload)
+{
+  // Both go out in the same write
+  send(header);
+  send(payload);
+}
+
+void
+BatchTransport::flush()
+{
+  if (!m_isConnected || m_isWriting || m_queue.empty())
+    return;
+
+  m_writing.swap(m_queue);
+  m_queuedBytes = 0;
+  m_isWriting = true;
+
+  std::vector<boost::asio::const_buffer> buffers;
+  buffers.reserve(m_writing.size());
+  for (const auto& block : m_writing)
+    buffers.emplace_back(block.wire(), block.size());
+
+  NDN_LOG_TRACE("Writing " << m_writing.size() << " packets");
+
+  boost::asio::async_write(*m_socket, buffers,
+    [self = shared_from_this()] (const boost::system::error_code& error, size_t) {
+      self->onWrite(error);
+    });
+}
+
+void
+BatchTransport::onWrite(const boost::system::error_code& error)
+{
+  m_isWriting = false;
+  m_writing.clear();
+
+  // Closed, and possibly connected again since
+  if (error == boost::asio::error::operation_aborted)
+    return flush();
+
+  if (error)
+  {
+    close();
+    NDN_THROW(Error(error, "error while sending data to socket"));
+  }
+
+  // Packets queued while writing
+  flush();
+}
+
+void
+BatchTransport::asyncRead()
+{
+  m_isReading = true;
+  m_socket->async_read_some(
+    boost::asio::buffer(m_inputBuffer.data() + m_inputBufferSize,
+                        m_inputBuffer.size() - m_inputBufferSize),
+    [self = shared_from_this()] (const boost::system::error_code& error, size_t nBytesRead) {
+      self->onRead(error, nBytesRead);
+    });
+}
+
+void
+BatchTransport::onRead(const boost::system::error_code& error, size_t nBytesRead)
+{
+  m_isReading = false;
+
+  if (error == boost::asio::error::operation_aborted)
+  {
+    if (m_isConnected && m_isReceiving)
+      asyncRead();
+    return;
+  }
+
+  if (error)
+  {
+    close();
+    NDN_THROW(Error(error, "error while receiving data from socket"));
+  }
+
+  m_inputBufferSize += nBytesRead;
+
+  // Deliver every complete packet in the buffer
+  size_t offset = 0;
+  while (offset < m_inputBufferSize)
+  {
+    bool isOk = false;
+    ndn::Block element;
+    std::tie(isOk, element) = ndn::Block::fromBuffer(m_inputBuffer.data() + offset,
+                                                     m_inputBufferSize - offset);
+    if (!isOk)
+      break;
+
+    offset += element.size();
+    m_receiveCallback(element);
+
+    // The callback may have closed the transport
+    if (!m_isConnected)
+      return;
+  }
+
+  if (offset == 0 && m_inputBufferSize == m_inputBuffer.size())
+  {
+    close();
+    NDN_THROW(Error("input buffer full, but a valid TLV cannot be decoded"));
+  }
+
+  if (offset > 0)
+  {
+    std::memmove(m_inputBuffer.data(), m_inputBuffer.data() + offset, m_inputBufferSize - offset);
+    m_inputBufferSize -= offset;
+  }
+
+  if (m_isReceiving)
+    asyncRead();
+}
+
+std::shared_ptr<ndn::Face>
+makeFace()
+{
+  std::shared_ptr<BatchTransport> transport;
+  if (BATCH_TRANSMISSION)
+    transport = BatchTransport::create();
+
+  return transport ? std::make_shared<ndn::Face>(transport) : std::make_shared<ndn::Face>();
+}
+
+} // namespace kua
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/transport/transport.hpp>
+#include <ndn-cxx/encoding/block.hpp>
+
+#include <boost/asio/local/stream_protocol.hpp>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace kua {
+
+/**
+ * Unix socket transport to the local forwarder that coalesces writes.
+ *
+ * Packets sent in one turn of the event loop are queued and written
+ * together with a single gather write at the end of the turn, or as soon
+ * as BATCH_MAX_BYTES are queued. Packets sent while a write is in flight
+ * go out together when it completes.
+ */
+class BatchTransport : public ndn::Transport
+                     , public std::enable_shared_from_this<BatchTransport>
+{
+public:
+  /** Create a transport for the configured forwarder, or nullptr if it is not a unix socket */
+  static std::shared_ptr<BatchTransport>
+  create();
+
+  explicit
+  BatchTransport(const std::string& socketPath);
+
+  ~BatchTransport() override;
+
+  void
+  connect(boost::asio::io_service& ioService, ReceiveCallback receiveCallback) override;
+
+  void
+  close() override;
+
+  void
+  pause() override;
+
+  void
+  resume() override;
+
+  void
+  send(const ndn::Block& wire) override;
+
+  void
+  send(const ndn::Block& header, const ndn::Block& payload) override;
+
+private:
+  /** Write out the queued packets unless a write is in flight */
+  void
+  flush();
+
+  void
+  onWrite(const boost::system::error_code& error);
+
+  void
+  asyncRead();
+
+  void
+  onRead(const boost::system::error_code& error, size_t nBytesRead);
+
+private:
+  const std::string m_socketPath;
+  std::unique_ptr<boost::asio::local::stream_protocol::socket> m_socket;
+
+  /** Packets waiting for the next write */
+  std::vector<ndn::Block> m_queue;
+  size_t m_queuedBytes = 0;
+  bool m_isFlushScheduled = false;
+
+  /** Packets of the write in flight */
+  std::vector<ndn::Block> m_writing;
+  bool m_isWriting = false;
+
+  std::array<uint8_t, ndn::MAX_NDN_PACKET_SIZE> m_inputBuffer;
+  size_t m_inputBufferSize = 0;
+  bool m_isReading = false;
+};
+
+/** Face to the local forwarder, batching writes if enabled and the forwarder is on a unix socket */
+std::shared_ptr<ndn::Face>
+makeFace();
+
+} // namespace kua
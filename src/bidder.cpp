@@ -1,19 +1,23 @@
 #include "bidder.hpp"
 #include "worker.hpp"
+#include "checkpoint.hpp"
 
 #include <ndn-cxx/util/logger.hpp>
 
+#include <algorithm>
+#include <tuple>
+
 namespace kua {
 
 NDN_LOG_INIT(kua.bidder);
 
-Bidder::Bidder(ConfigBundle& configBundle, NodeWatcher& nodeWatcher)
+Bidder::Bidder(ConfigBundle& configBundle, SyncGroup& syncGroup, NodeWatcher& nodeWatcher)
   : m_configBundle(configBundle)
-  , m_syncPrefix(ndn::Name(configBundle.kuaPrefix).append("sync").append("auction"))
   , m_nodePrefix(configBundle.nodePrefix)
   , m_face(configBundle.face)
   , m_scheduler(m_face.getIoService())
   , m_keyChain(configBundle.keyChain)
+  , m_syncGroup(syncGroup)
   , m_nodeWatcher(nodeWatcher)
   , m_rndBid(1, 100)
   , m_rng(ndn::random::getRandomNumberEngine())
@@ -26,9 +30,27 @@ Bidder::Bidder(ConfigBundle& configBundle, NodeWatcher& nodeWatcher)
     return;
   }
 
-  // Initialize SVS
-  m_svs = std::make_unique<ndn::svs::SVSync>(
-    m_syncPrefix, m_nodePrefix, m_face, std::bind(&Bidder::updateCallback, this, _1));
+  // Follow the masters of our shards only
+  for (shard_id_t s : Bucket::shardsOfNode(m_nodePrefix))
+  {
+    NDN_LOG_INFO("Bidding in shard " << s);
+    m_shards.emplace(s, Shard());
+    m_syncGroup.subscribe(Bucket::auctionStream(s),
+      [] (const ndn::Name& node) { return ndn::Name(MASTER_PREFIX).isPrefixOf(node); },
+      std::bind(&Bidder::processMasterMessage, this, s, _1, _2));
+  }
+
+  m_dispatcher = std::make_unique<Dispatcher>(m_configBundle);
+
+  // Reopen buckets served before a restart; the auction stream reconciles them
+  if (!m_configBundle.stateDir.empty())
+    restore();
+
+  m_loadEvent = m_scheduler.schedule(ndn::time::milliseconds(LOAD_REPORT_INTERVAL_MS),
+                                     [this] { reportLoad(); });
+
+  // The failure domain is known right away, so the first auctions can use it
+  reportTopology();
 
   initialize();
 }
@@ -40,24 +62,30 @@ Bidder::initialize()
 }
 
 void
-Bidder::updateCallback(const std::vector<ndn::svs::MissingDataInfo>& missingInfo)
+Bidder::processMasterMessage(shard_id_t shard, const ndn::Name& sender, const ndn::Data& data)
 {
-  for (const auto m : missingInfo) {
-    if (m.nodeId != ndn::Name(MASTER_PREFIX)) {
-      continue;
-    }
+  AuctionMessage msg;
+  msg.wireDecode(data.getContent().blockFromValue());
 
-    for (ndn::svs::SeqNo i = m.low; i <= m.high; i++) {
-      m_svs->fetchData(m.nodeId, i, std::bind(&Bidder::processMasterMessage, this, _1), 10);
-    }
+  // Masters only auction buckets in their own range
+  if (msg.bucketId >= NUM_BUCKETS || Bucket::shardFromId(msg.bucketId) != shard)
+    return;
+
+  Shard& s = m_shards[shard];
+
+  // Fence off a deposed master that is still publishing
+  if (std::tie(msg.epoch, sender) < std::tie(s.masterEpoch, s.master))
+  {
+    NDN_LOG_DEBUG("Ignoring " << sender << " with stale epoch " << msg.epoch);
+    return;
   }
-}
 
-void
-Bidder::processMasterMessage(const ndn::Data& data)
-{
-  AuctionMessage msg;
-  msg.wireDecode(data.getContent().blockFromValue());
+  if (sender != s.master)
+    NDN_LOG_INFO("Following master " << sender << " for shard " << shard <<
+                 " with epoch " << msg.epoch);
+
+  s.masterEpoch = msg.epoch;
+  s.master = sender;
 
   switch (msg.messageType)
   {
@@ -75,7 +103,8 @@ Bidder::processMasterMessage(const ndn::Data& data)
         NDN_LOG_INFO("Won auction for #" << msg.bucketId);
 
         AuctionMessage rmsg(AuctionMessage::Type::WinAck, msg.auctionId, msg.bucketId);
-        m_svs->publishData(rmsg.wireEncode(), ndn::time::milliseconds(1000));
+        m_syncGroup.publish(Bucket::auctionStream(shard), rmsg.wireEncode(),
+                            ndn::time::milliseconds(1000));
 
         if (!m_buckets.count(msg.bucketId))
           m_buckets[msg.bucketId] = std::make_shared<Bucket>(msg.bucketId);
@@ -91,21 +120,8 @@ Bidder::processMasterMessage(const ndn::Data& data)
 
     case AuctionMessage::Type::AuctionEnd:
     {
-      if (!m_buckets.count(msg.bucketId))
-        return;
-
-      m_buckets[msg.bucketId]->confirmedHosts.clear();
-
-      for (const auto& w : msg.winnerList)
-      {
-        m_buckets[msg.bucketId]->confirmedHosts[w] = 1;
-        NDN_LOG_DEBUG("Confirmed node for #" << msg.bucketId << " " << w);
-      }
-
-      // Start the worker if not running
-      if (!m_buckets[msg.bucketId]->worker)
-        m_buckets[msg.bucketId]->worker = std::make_shared<Worker>(m_configBundle, *m_buckets[msg.bucketId]);
-
+      if (applyAuctionEnd(msg))
+        saveAssignment();
       break;
     }
 
@@ -114,6 +130,98 @@ Bidder::processMasterMessage(const ndn::Data& data)
   }
 }
 
+bool
+Bidder::applyAuctionEnd(const AuctionMessage& msg)
+{
+  // Messages are fetched one by one and the whole stream is replayed after a restart
+  auto applied = m_assignments.find(msg.bucketId);
+  if (applied != m_assignments.end() &&
+      std::tie(msg.epoch, msg.assignmentVersion) <=
+        std::tie(applied->second.epoch, applied->second.assignmentVersion))
+  {
+    NDN_LOG_DEBUG("Ignoring stale hosts of #" << msg.bucketId << " version " << msg.assignmentVersion);
+    return false;
+  }
+  m_assignments[msg.bucketId] = msg;
+
+  const bool confirmed =
+    std::find(msg.winnerList.begin(), msg.winnerList.end(), m_nodePrefix) != msg.winnerList.end() ||
+    std::find(msg.readerList.begin(), msg.readerList.end(), m_nodePrefix) != msg.readerList.end();
+
+  // The master's view wins over a restored or unacknowledged assignment
+  if (!confirmed)
+  {
+    auto it = m_buckets.find(msg.bucketId);
+    if (it == m_buckets.end())
+      return true;
+
+    NDN_LOG_INFO("Not a host of #" << msg.bucketId << ", dropping it");
+    if (it->second->worker)
+      m_dispatcher->removeWorker(msg.bucketId);
+    m_busyBuckets.erase(msg.bucketId);
+    m_buckets.erase(it);
+    return true;
+  }
+
+  // A bucket dropped by a stale message comes back with the newer one
+  auto& bucketPtr = m_buckets[msg.bucketId];
+  if (!bucketPtr)
+    bucketPtr = std::make_shared<Bucket>(msg.bucketId);
+
+  auto& bucket = *bucketPtr;
+  bucket.epoch = msg.epoch;
+  bucket.version = msg.assignmentVersion;
+  bucket.confirmedHosts.clear();
+  bucket.readHosts.clear();
+
+  for (const auto& w : msg.winnerList)
+  {
+    bucket.confirmedHosts[w] = 1;
+    NDN_LOG_DEBUG("Confirmed node for #" << msg.bucketId << " " << w);
+  }
+
+  for (const auto& r : msg.readerList)
+  {
+    bucket.readHosts[r] = 1;
+    NDN_LOG_DEBUG("Read replica for #" << msg.bucketId << " " << r);
+  }
+
+  // Start the worker if not running; a running one gets a copy on its own thread
+  if (!bucket.worker)
+  {
+    bucket.worker = std::make_shared<Worker>(m_configBundle, bucket, *m_dispatcher);
+    m_dispatcher->addWorker(bucket.id, bucket.worker);
+  }
+  else
+  {
+    bucket.worker->setHosts(bucket);
+  }
+  return true;
+}
+
+void
+Bidder::restore()
+{
+  auto msgs = Checkpoint::loadAssignment(Checkpoint::assignmentPath(m_configBundle.stateDir));
+
+  for (const auto& msg : msgs)
+  {
+    // Buckets of a shard we no longer bid in have no master to confirm them
+    if (msg.bucketId >= NUM_BUCKETS || !m_shards.count(Bucket::shardFromId(msg.bucketId)))
+      continue;
+
+    NDN_LOG_DEBUG("Restoring hosts of #" << msg.bucketId << " version " << msg.assignmentVersion);
+    applyAuctionEnd(msg);
+  }
+}
+
+void
+Bidder::saveAssignment()
+{
+  if (!m_configBundle.stateDir.empty())
+    Checkpoint::saveAssignment(Checkpoint::assignmentPath(m_configBundle.stateDir), m_assignments);
+}
+
 void
 Bidder::placeBid(bucket_id_t bucketId, auction_id_t auctionId)
 {
@@ -124,7 +232,65 @@ Bidder::placeBid(bucket_id_t bucketId, auction_id_t auctionId)
   msg.bidAmount = bidAmount;
 
   NDN_LOG_DEBUG("PLACE_BID for #" << bucketId << " AID " << auctionId << " $" << bidAmount);
-  m_svs->publishData(msg.wireEncode(), ndn::time::milliseconds(1000));
+  m_syncGroup.publish(Bucket::auctionStream(Bucket::shardFromId(bucketId)), msg.wireEncode(),
+                      ndn::time::milliseconds(1000));
+}
+
+void
+Bidder::reportLoad()
+{
+  m_loadEvent = m_scheduler.schedule(ndn::time::milliseconds(LOAD_REPORT_INTERVAL_MS),
+                                     [this] { reportLoad(); });
+
+  for (const auto& bucket : m_buckets)
+  {
+    if (!bucket.second->worker)
+      continue;
+
+    const uint64_t rate = bucket.second->worker->takeReadCount() * 1000 / LOAD_REPORT_INTERVAL_MS;
+
+    // Idle buckets are reported once, when they go idle
+    if (rate == 0 && !m_busyBuckets.count(bucket.first))
+      continue;
+
+    if (rate > 0)
+      m_busyBuckets.insert(bucket.first);
+    else
+      m_busyBuckets.erase(bucket.first);
+
+    AuctionMessage msg(AuctionMessage::Type::Load, 0, bucket.first);
+    msg.readRate = rate;
+
+    NDN_LOG_TRACE("LOAD for #" << bucket.first << " " << rate << "/s");
+    m_syncGroup.publish(Bucket::auctionStream(Bucket::shardFromId(bucket.first)), msg.wireEncode(),
+                        ndn::time::milliseconds(1000));
+  }
+}
+
+void
+Bidder::reportTopology()
+{
+  m_topologyEvent = m_scheduler.schedule(ndn::time::milliseconds(TOPOLOGY_REPORT_INTERVAL_MS),
+                                         [this] { reportTopology(); });
+
+  AuctionMessage msg(AuctionMessage::Type::Topology, 0, 0);
+  msg.failureDomain = m_configBundle.failureDomain;
+
+  // Nodes that went away are left out
+  const auto nodes = m_nodeWatcher.getNodeList();
+  for (const auto& rtt : m_nodeWatcher.getRtts())
+  {
+    if (!std::binary_search(nodes.begin(), nodes.end(), rtt.first))
+      continue;
+
+    const auto us = ndn::time::duration_cast<ndn::time::microseconds>(rtt.second).count();
+    msg.rttList[rtt.first] = std::max<uint64_t>(1, us);
+  }
+
+  NDN_LOG_TRACE("TOPOLOGY in " << msg.failureDomain << " with " << msg.rttList.size() << " RTTs");
+  for (const auto& shard : m_shards)
+    m_syncGroup.publish(Bucket::auctionStream(shard.first), msg.wireEncode(),
+                        ndn::time::milliseconds(1000));
 }
 
-} // namespace kua
\ No newline at end of file
+} // namespace kua
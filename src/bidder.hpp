@@ -1,11 +1,13 @@
 #pragma once
 
-#include <ndn-svs/svsync.hpp>
+#include <set>
 
 #include "config-bundle.hpp"
 #include "node-watcher.hpp"
+#include "sync-group.hpp"
 #include "bucket.hpp"
 #include "auction.hpp"
+#include "dispatcher.hpp"
 
 namespace kua {
 
@@ -13,7 +15,14 @@ class Bidder
 {
 public:
   /** Initialize the bidder with the sync prefix */
-  Bidder(ConfigBundle& configBundle, NodeWatcher& nodeWatcher);
+  Bidder(ConfigBundle& configBundle, SyncGroup& syncGroup, NodeWatcher& nodeWatcher);
+
+  /** Get the buckets served by this node */
+  const std::map<bucket_id_t, std::shared_ptr<Bucket>>&
+  getBuckets() const
+  {
+    return m_buckets;
+  }
 
 private:
   /**
@@ -22,34 +31,73 @@ private:
   void
   initialize();
 
-  /** On SVS update */
+  /** Process packet from master */
   void
-  updateCallback(const std::vector<ndn::svs::MissingDataInfo>& missingInfo);
+  processMasterMessage(shard_id_t shard, const ndn::Name& sender, const ndn::Data& data);
 
-  /** Process packet from master */
+  /**
+   * Apply the final host list of a bucket, starting or dropping its worker.
+   * @return false if an AuctionEnd as new was applied already
+   */
+  bool
+  applyAuctionEnd(const AuctionMessage& msg);
+
+  /** Reopen buckets from the last checkpoint */
+  void
+  restore();
+
+  /** Checkpoint the buckets served by this node */
   void
-  processMasterMessage(const ndn::Data& data);
+  saveAssignment();
 
   /** Place bid for a bucket */
   void
   placeBid(bucket_id_t bucketId, auction_id_t auctionId);
 
+  /** Report the read rate of each bucket served to its master */
+  void
+  reportLoad();
+
+  /** Report the failure domain of this node and its round-trip times to the masters */
+  void
+  reportTopology();
+
+private:
+  /** Control plane shard this node bids in */
+  struct Shard
+  {
+    /** Epoch and name of the newest master seen; older ones are ignored */
+    uint64_t masterEpoch = 0;
+    ndn::Name master;
+  };
+
 private:
   ConfigBundle& m_configBundle;
-  ndn::Name m_syncPrefix;
   ndn::Name m_nodePrefix;
   ndn::Face& m_face;
   ndn::Scheduler m_scheduler;
   ndn::KeyChain& m_keyChain;
+  SyncGroup& m_syncGroup;
   NodeWatcher& m_nodeWatcher;
 
+  /** Request dispatcher for workers on this node */
+  std::unique_ptr<Dispatcher> m_dispatcher;
+
   /** Buckets won by this node */
   std::map<bucket_id_t, std::shared_ptr<Bucket>> m_buckets;
 
+  /** Last AuctionEnd applied for each bucket, served here or not; checkpointed */
+  std::map<bucket_id_t, AuctionMessage> m_assignments;
+
   std::uniform_int_distribution<> m_rndBid;
   ndn::random::RandomNumberEngine& m_rng;
 
-  std::unique_ptr<ndn::svs::SVSync> m_svs;
+  std::map<shard_id_t, Shard> m_shards;
+
+  ndn::scheduler::ScopedEventId m_loadEvent;
+  ndn::scheduler::ScopedEventId m_topologyEvent;
+  /** Buckets whose last report was not idle */
+  std::set<bucket_id_t> m_busyBuckets;
 };
 
 } // namespace kua
\ No newline at end of file
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <ndn-cxx/name.hpp>
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace kua {
+
+/**
+ * Blocked counting Bloom filter over names.
+ *
+ * A name selects one block of counters the size of a cache line and
+ * sets K counters within it, so a lookup touches a single cache line.
+ * Counters allow removal; a counter that saturates is never decremented,
+ * which can only add false positives, never false negatives.
+ */
+class BloomFilter
+{
+public:
+  static constexpr size_t BLOCK_SIZE = 64;
+  static constexpr size_t K = 6;
+  /** About 1% false positives at capacity */
+  static constexpr size_t COUNTERS_PER_ENTRY = 12;
+
+  explicit
+  BloomFilter(size_t capacity)
+    : m_capacity(capacity)
+    , m_blocks((capacity * COUNTERS_PER_ENTRY + BLOCK_SIZE - 1) / BLOCK_SIZE + 1)
+  { }
+
+  void
+  insert(const ndn::Name& name)
+  {
+    forEachCounter(name, [] (uint8_t& counter) {
+      if (counter < UINT8_MAX)
+        counter++;
+    });
+    m_size++;
+  }
+
+  /** Remove a name that was inserted */
+  void
+  erase(const ndn::Name& name)
+  {
+    forEachCounter(name, [] (uint8_t& counter) {
+      if (counter > 0 && counter < UINT8_MAX)
+        counter--;
+    });
+    m_size--;
+  }
+
+  /** False if the name is definitely absent */
+  bool
+  mayContain(const ndn::Name& name) const
+  {
+    const uint64_t hash = std::hash<ndn::Name>()(name);
+    const Block& block = m_blocks[mix(hash) % m_blocks.size()];
+
+    uint64_t bits = mix(hash ^ SEED);
+    for (size_t i = 0; i < K; i++, bits >>= 6)
+    {
+      if (block.counters[bits & (BLOCK_SIZE - 1)] == 0)
+        return false;
+    }
+    return true;
+  }
+
+  size_t
+  size() const
+  {
+    return m_size;
+  }
+
+  size_t
+  capacity() const
+  {
+    return m_capacity;
+  }
+
+  /** Expected false positive rate from the counters in use in each block; scans the filter */
+  double
+  falsePositiveRate() const
+  {
+    double sum = 0;
+    for (const auto& block : m_blocks)
+    {
+      size_t nonZero = 0;
+      for (uint8_t counter : block.counters)
+        nonZero += counter > 0;
+      sum += std::pow(double(nonZero) / BLOCK_SIZE, K);
+    }
+    return sum / m_blocks.size();
+  }
+
+private:
+  struct alignas(BLOCK_SIZE) Block
+  {
+    std::array<uint8_t, BLOCK_SIZE> counters{};
+  };
+
+  static constexpr uint64_t SEED = 0x9e3779b97f4a7c15;
+
+  /** Finalizer of splitmix64, so that every bit of the name hash counts */
+  static uint64_t
+  mix(uint64_t x)
+  {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+  }
+
+  template<typename F>
+  void
+  forEachCounter(const ndn::Name& name, F&& f)
+  {
+    const uint64_t hash = std::hash<ndn::Name>()(name);
+    Block& block = m_blocks[mix(hash) % m_blocks.size()];
+
+    // Counters may repeat within a block; that only costs accuracy
+    uint64_t bits = mix(hash ^ SEED);
+    for (size_t i = 0; i < K; i++, bits >>= 6)
+      f(block.counters[bits & (BLOCK_SIZE - 1)]);
+  }
+
+private:
+  size_t m_capacity;
+  size_t m_size = 0;
+  std::vector<Block> m_blocks;
+};
+
+} // namespace kua
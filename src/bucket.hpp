@@ -4,11 +4,14 @@
 
 #include <ndn-cxx/name.hpp>
 
+#include <algorithm>
 #include <map>
+#include <vector>
 
 namespace kua {
 
 typedef unsigned int bucket_id_t;
+typedef unsigned int shard_id_t;
 
 class Worker;
 
@@ -21,21 +24,112 @@ public:
   bucket_id_t id;
   std::map<ndn::Name, int> pendingHosts;
   std::map<ndn::Name, int> confirmedHosts;
+  /** Extra read-only replicas of a hot bucket; writes reach them but only confirmed hosts acknowledge */
+  std::map<ndn::Name, int> readHosts;
+  /** Master epoch and assignment version of the AuctionEnd the hosts were taken from */
+  uint64_t epoch = 0;
+  uint64_t version = 0;
   std::shared_ptr<Worker> worker;
 
-  static inline bucket_id_t
-  idFromName(const ndn::Name& origName)
+  /**
+   * Get the name of the segment run a name belongs to.
+   * Segments of a run are always placed in the same bucket.
+   */
+  static inline ndn::Name
+  runName(const ndn::Name& origName)
   {
     ndn::Name name(origName);
 
     if (name.size() >= 1 && name[-1].isSegment()) {
       uint64_t seg = name[-1].toSegment();
       name.erase(-1);
-      name.appendSegment(seg / 100);
+      name.appendSegment(seg / SEGMENT_RUN_SIZE);
     }
 
+    return name;
+  }
+
+  static inline bucket_id_t
+  idFromName(const ndn::Name& origName)
+  {
+    static std::hash<ndn::Name> hashFunc;
+    return hashFunc(runName(origName)) % NUM_BUCKETS;
+  }
+
+  /**
+   * Check if a bucket stores erasure-coded stripes instead of replicas.
+   * The last NUM_EC_BUCKETS buckets are erasure-coded.
+   */
+  static inline bool
+  isErasureCoded(bucket_id_t id)
+  {
+    return id + NUM_EC_BUCKETS >= NUM_BUCKETS;
+  }
+
+  /** Get the number of hosts a bucket is auctioned to */
+  static inline size_t
+  numHosts(bucket_id_t id)
+  {
+    return isErasureCoded(id) ? EC_DATA_FRAGMENTS + EC_PARITY_FRAGMENTS : NUM_REPLICA;
+  }
+
+  /** Get the largest range to insert with one command; stripes are never split */
+  static inline size_t
+  rangePackSize(bucket_id_t id, size_t maxPack)
+  {
+    if (!isErasureCoded(id) || maxPack < EC_DATA_FRAGMENTS)
+      return maxPack;
+    return maxPack / EC_DATA_FRAGMENTS * EC_DATA_FRAGMENTS;
+  }
+
+  /**
+   * Get the control plane shard whose master auctions a bucket.
+   * Each shard owns a contiguous range of bucket IDs.
+   */
+  static inline shard_id_t
+  shardFromId(bucket_id_t id)
+  {
+    return id * NUM_MASTER_SHARDS / NUM_BUCKETS;
+  }
+
+  /**
+   * Get the shards a node bids in.
+   * Picks the MASTER_SHARDS_PER_NODE highest rendezvous hashes, so every
+   * master can tell which nodes to expect bids from.
+   */
+  static inline std::vector<shard_id_t>
+  shardsOfNode(const ndn::Name& node)
+  {
     static std::hash<ndn::Name> hashFunc;
-    return hashFunc(name) % NUM_BUCKETS;
+
+    std::vector<std::pair<size_t, shard_id_t>> scores;
+    for (shard_id_t s = 0; s < NUM_MASTER_SHARDS; s++)
+      scores.emplace_back(hashFunc(ndn::Name(node).appendNumber(s)), s);
+
+    const size_t count = std::min<size_t>(MASTER_SHARDS_PER_NODE, NUM_MASTER_SHARDS);
+    std::partial_sort(scores.begin(), scores.begin() + count, scores.end(),
+                      std::greater<std::pair<size_t, shard_id_t>>());
+
+    std::vector<shard_id_t> shards;
+    for (size_t i = 0; i < count; i++)
+      shards.push_back(scores[i].second);
+    std::sort(shards.begin(), shards.end());
+    return shards;
+  }
+
+  /** Check if a node bids in a shard */
+  static inline bool
+  nodeInShard(const ndn::Name& node, shard_id_t shard)
+  {
+    auto shards = shardsOfNode(node);
+    return std::binary_search(shards.begin(), shards.end(), shard);
+  }
+
+  /** Get the stream of the sync group carrying the auctions of a shard */
+  static inline ndn::Name
+  auctionStream(shard_id_t shard)
+  {
+    return ndn::Name("auction").appendNumber(shard);
   }
 };
 
@@ -0,0 +1,431 @@
+#include "checkpoint.hpp"
+#include "tlv.hpp"
+
+#include <ndn-cxx/util/logger.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#define CHECKPOINT_MAX_BLOCK_SIZE (1 << 24)
+
+namespace kua {
+
+NDN_LOG_INIT(kua.checkpoint);
+
+/** Wall clock time in ms, as expiries must hold across restarts */
+static uint64_t
+nowMs()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static bool
+syncPath(const std::string& path, int flags)
+{
+  const int fd = ::open(path.c_str(), flags);
+  if (fd < 0)
+    return false;
+
+  const bool ok = ::fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+}
+
+std::string
+Checkpoint::assignmentPath(const std::string& stateDir)
+{
+  return stateDir + "/assignment";
+}
+
+std::string
+Checkpoint::storePath(const std::string& stateDir, bucket_id_t bucketId)
+{
+  return stateDir + "/bucket-" + std::to_string(bucketId) + ".store";
+}
+
+void
+Checkpoint::saveAssignment(const std::string& path, const std::map<bucket_id_t, AuctionMessage>& assignments)
+{
+  // Buckets not served here are kept too, so stale messages replayed later cannot revive them
+  writeFile(path, [&assignments] (std::ostream& os) {
+    for (const auto& assignment : assignments)
+    {
+      auto block = assignment.second.wireEncode();
+      os.write(reinterpret_cast<const char*>(block.wire()), block.size());
+    }
+  });
+}
+
+std::vector<AuctionMessage>
+Checkpoint::loadAssignment(const std::string& path)
+{
+  std::vector<AuctionMessage> msgs;
+  std::ifstream is(path, std::ios::binary);
+
+  ndn::Block block;
+  while (readBlock(is, block))
+  {
+    try {
+      AuctionMessage msg;
+      msg.wireDecode(block);
+      msgs.push_back(msg);
+    }
+    catch (const ndn::tlv::Error& e) {
+      NDN_LOG_WARN("Bad assignment record in " << path << " : " << e.what());
+      break;
+    }
+  }
+
+  return msgs;
+}
+
+bool
+Checkpoint::mergeLog(const std::string& path, WriteAheadLog& wal, bucket_id_t bucketId,
+                     uint64_t from, uint64_t to)
+{
+  // Only the last record of a name counts; keep its position rather than its packet
+  std::unordered_map<ndn::Name, uint64_t> latest;
+  wal.readRecords(bucketId, from, to, [&latest] (uint64_t position, WriteAheadLog::RecordType,
+                                                 uint64_t, uint64_t, const ndn::Block& block) {
+    latest[blockName(block)] = position;
+  });
+
+  std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+  const std::string tmpPath = path + ".tmp";
+  std::ofstream os(tmpPath, std::ios::binary | std::ios::trunc);
+  const uint64_t now = nowMs();
+
+  // Entries the log did not touch are copied without decoding them
+  std::ifstream is(path, std::ios::binary);
+  ndn::Block block;
+  while (readBlock(is, block))
+  {
+    try {
+      const uint64_t expiry = blockExpiry(block);
+      if ((expiry > 0 && expiry <= now) || latest.count(blockName(block)) > 0)
+        continue;
+
+      os.write(reinterpret_cast<const char*>(block.wire()), block.size());
+    }
+    catch (const ndn::tlv::Error& e) {
+      NDN_LOG_WARN("Bad store record in " << path << " : " << e.what());
+      break;
+    }
+  }
+
+  Compressor compressor(STORE_COMPRESSION ? Codec::AUTO : Codec::NONE);
+  wal.readRecords(bucketId, from, to, [&] (uint64_t position, WriteAheadLog::RecordType type,
+                                           uint64_t expiry, uint64_t writeTime, const ndn::Block& record) {
+    if ((expiry > 0 && expiry <= now) || latest[blockName(record)] != position)
+      return;
+
+    const auto entry = type == WriteAheadLog::PUT ? encodeEntry(ndn::Data(record), expiry, writeTime, compressor)
+                                                  : encodeTombstone(ndn::Name(record), expiry);
+    os.write(reinterpret_cast<const char*>(entry.wire()), entry.size());
+  });
+
+  os.flush();
+  if (!os.good())
+  {
+    NDN_LOG_ERROR("Failed to write checkpoint " << tmpPath);
+    return false;
+  }
+  os.close();
+
+  return replaceFile(tmpPath, path);
+}
+
+size_t
+Checkpoint::loadStore(const std::string& path, Store& store)
+{
+  std::ifstream is(path, std::ios::binary);
+  size_t count = 0;
+
+  ndn::Block block;
+  const uint64_t now = nowMs();
+  while (readBlock(is, block))
+  {
+    try {
+      const uint64_t expiry = blockExpiry(block);
+      if (expiry > 0 && expiry <= now)
+        continue;
+
+      // Applied the same way as live inserts and deletes
+      if (block.type() == tlv::CheckpointTombstone)
+      {
+        store.remove(blockName(block));
+        continue;
+      }
+
+      ndn::Data data = block.type() == tlv::CheckpointEntry ? decodeEntry(block) : ndn::Data(block);
+
+      if (store.put(data))
+        count++;
+      store.clearTombstone(data.getName());
+      store.setTtl(data.getName(), expiry > 0 ? expiry - now : 0);
+      store.setWriteTime(data.getName(), blockWriteTime(block));
+    }
+    catch (const ndn::tlv::Error& e) {
+      NDN_LOG_WARN("Bad store record in " << path << " : " << e.what());
+      break;
+    }
+  }
+
+  return count;
+}
+
+ndn::Block
+Checkpoint::encodeEntry(const ndn::Data& data, uint64_t expiry, uint64_t writeTime, Compressor& compressor)
+{
+  const auto& wire = data.wireEncode();
+
+  // The name stays readable so that merges copy entries without decompressing them
+  ndn::Block block(tlv::CheckpointEntry);
+  block.push_back(data.getName().wireEncode());
+  if (auto bytes = compressor.compress(wire.wire(), wire.size()))
+  {
+    block.push_back(ndn::encoding::makeNonNegativeIntegerBlock(tlv::CheckpointCodec,
+                                                               static_cast<uint64_t>(compressor.getCodec())));
+    block.push_back(ndn::encoding::makeNonNegativeIntegerBlock(tlv::CheckpointRawSize, wire.size()));
+    block.push_back(ndn::encoding::makeBinaryBlock(tlv::CheckpointCompressed, bytes->data(), bytes->size()));
+  }
+  else
+  {
+    block.push_back(wire);
+  }
+
+  if (expiry > 0)
+    block.push_back(ndn::encoding::makeNonNegativeIntegerBlock(tlv::CheckpointExpiry, expiry));
+  block.push_back(ndn::encoding::makeNonNegativeIntegerBlock(tlv::EntryWriteTime, writeTime));
+
+  block.encode();
+  return block;
+}
+
+ndn::Block
+Checkpoint::encodeTombstone(const ndn::Name& name, uint64_t expiry)
+{
+  ndn::Block block(tlv::CheckpointTombstone);
+  block.push_back(name.wireEncode());
+  block.push_back(ndn::encoding::makeNonNegativeIntegerBlock(tlv::CheckpointExpiry, expiry));
+  block.encode();
+  return block;
+}
+
+ndn::Data
+Checkpoint::decodeEntry(const ndn::Block& entry)
+{
+  entry.parse();
+
+  auto it = entry.find(tlv::CheckpointCompressed);
+  if (it == entry.elements_end())
+    return ndn::Data(entry.get(ndn::tlv::Data));
+
+  const auto codec = static_cast<Codec>(ndn::encoding::readNonNegativeInteger(entry.get(tlv::CheckpointCodec)));
+  const auto rawSize = ndn::encoding::readNonNegativeInteger(entry.get(tlv::CheckpointRawSize));
+  if (rawSize > CHECKPOINT_MAX_BLOCK_SIZE)
+    NDN_THROW(ndn::tlv::Error("Checkpoint entry too large"));
+
+  auto wire = Compressor::decompress(codec, it->value(), it->value_size(), rawSize);
+  if (!wire)
+    NDN_THROW(ndn::tlv::Error("Cannot decompress checkpoint entry"));
+
+  return ndn::Data(ndn::Block(wire));
+}
+
+ndn::Name
+Checkpoint::blockName(const ndn::Block& block)
+{
+  if (block.type() == ndn::tlv::Name)
+    return ndn::Name(block);
+
+  // Packets, checkpoint entries and tombstones all hold the name
+  block.parse();
+  return ndn::Name(block.get(ndn::tlv::Name));
+}
+
+uint64_t
+Checkpoint::blockExpiry(const ndn::Block& block)
+{
+  if (block.type() != tlv::CheckpointEntry && block.type() != tlv::CheckpointTombstone)
+    return 0;
+
+  block.parse();
+  auto it = block.find(tlv::CheckpointExpiry);
+  return it != block.elements_end() ? ndn::encoding::readNonNegativeInteger(*it) : 0;
+}
+
+uint64_t
+Checkpoint::blockWriteTime(const ndn::Block& block)
+{
+  if (block.type() != tlv::CheckpointEntry)
+    return 0;
+
+  block.parse();
+  auto it = block.find(tlv::EntryWriteTime);
+  return it != block.elements_end() ? ndn::encoding::readNonNegativeInteger(*it) : 0;
+}
+
+bool
+Checkpoint::writeFile(const std::string& path, const std::function<void(std::ostream&)>& writer)
+{
+  const auto dir = std::filesystem::path(path).parent_path();
+  std::filesystem::create_directories(dir);
+
+  const std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream os(tmpPath, std::ios::binary | std::ios::trunc);
+    writer(os);
+    os.flush();
+
+    if (!os.good())
+    {
+      NDN_LOG_ERROR("Failed to write checkpoint " << tmpPath);
+      return false;
+    }
+  }
+
+  return replaceFile(tmpPath, path);
+}
+
+bool
+Checkpoint::replaceFile(const std::string& tmpPath, const std::string& path)
+{
+  const auto dir = std::filesystem::path(path).parent_path();
+
+  if (!syncPath(tmpPath, O_RDONLY))
+  {
+    NDN_LOG_ERROR("Failed to sync checkpoint " << tmpPath);
+    return false;
+  }
+
+  if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+  {
+    NDN_LOG_ERROR("Failed to replace checkpoint " << path);
+    return false;
+  }
+
+  // Make the rename durable too
+  return syncPath(dir.empty() ? "." : dir.string(), O_RDONLY | O_DIRECTORY);
+}
+
+/** Read a TLV VAR-NUMBER, keeping its raw bytes */
+static bool
+readVarNumber(std::istream& is, uint64_t& number, std::vector<uint8_t>& raw)
+{
+  int first = is.get();
+  if (first == EOF)
+    return false;
+
+  raw.push_back(first);
+
+  size_t len = first < 253 ? 0 : first == 253 ? 2 : first == 254 ? 4 : 8;
+  number = len == 0 ? first : 0;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    int c = is.get();
+    if (c == EOF)
+      return false;
+
+    raw.push_back(c);
+    number = (number << 8) | static_cast<uint8_t>(c);
+  }
+
+  return true;
+}
+
+bool
+Checkpoint::readBlock(std::istream& is, ndn::Block& block)
+{
+  std::vector<uint8_t> header;
+  uint64_t type = 0, length = 0;
+
+  if (!readVarNumber(is, type, header) || !readVarNumber(is, length, header) ||
+      length > CHECKPOINT_MAX_BLOCK_SIZE)
+    return false;
+
+  auto buf = std::make_shared<ndn::Buffer>(header.size() + length);
+  std::copy(header.begin(), header.end(), buf->begin());
+
+  is.read(reinterpret_cast<char*>(buf->data() + header.size()), length);
+  if (static_cast<uint64_t>(is.gcount()) != length)
+    return false;
+
+  block = ndn::Block(buf);
+  return true;
+}
+
+namespace coro {
+namespace {
+
+class MergeLogAwaiter : public detail::CallbackAwaiter<bool>
+{
+public:
+  MergeLogAwaiter(std::thread& thread, boost::asio::io_service& ioService, const std::string& path,
+                  WriteAheadLog& wal, bucket_id_t bucketId, uint64_t from, uint64_t to,
+                  const CancelToken& token)
+    : CallbackAwaiter(token)
+    , m_thread(thread)
+    , m_ioService(ioService)
+    , m_path(path)
+    , m_wal(wal)
+    , m_bucketId(bucketId)
+    , m_from(from)
+    , m_to(to)
+  { }
+
+protected:
+  void
+  begin(const Pending& pending) final
+  {
+    // The last merge has posted its result already
+    if (m_thread.joinable())
+      m_thread.join();
+
+    m_thread = std::thread([this, pending, &ioService = m_ioService, &wal = m_wal, path = m_path,
+                            bucketId = m_bucketId, from = m_from, to = m_to] {
+      const bool ok = Checkpoint::mergeLog(path, wal, bucketId, from, to);
+      ioService.post([this, pending, ok] {
+        if (*pending)
+          complete(ok);
+      });
+    });
+  }
+
+  void
+  onCancel() final
+  {
+    // The merge runs to completion; the checkpoint is still valid
+  }
+
+private:
+  std::thread& m_thread;
+  boost::asio::io_service& m_ioService;
+  std::string m_path;
+  WriteAheadLog& m_wal;
+  bucket_id_t m_bucketId;
+  uint64_t m_from;
+  uint64_t m_to;
+};
+
+} // namespace
+
+Task<bool>
+mergeLog(std::thread& thread, boost::asio::io_service& ioService, std::string path,
+         WriteAheadLog& wal, bucket_id_t bucketId, uint64_t from, uint64_t to, CancelToken token)
+{
+  co_return co_await MergeLogAwaiter(thread, ioService, path, wal, bucketId, from, to, token);
+}
+
+} // namespace coro
+
+} // namespace kua
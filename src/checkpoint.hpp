@@ -0,0 +1,113 @@
+#pragma once
+
+#include "bucket.hpp"
+#include "store.hpp"
+#include "auction.hpp"
+#include "coro.hpp"
+#include "codec.hpp"
+#include "write-ahead-log.hpp"
+
+#include <istream>
+#include <string>
+#include <thread>
+
+namespace kua {
+
+/**
+ * On-disk snapshots of bucket assignments and store contents for warm restarts.
+ *
+ * Store checkpoints are brought up to date by merging write-ahead log
+ * records into them. Files are plain concatenations of TLV blocks and are
+ * replaced atomically.
+ */
+class Checkpoint
+{
+public:
+  static std::string
+  assignmentPath(const std::string& stateDir);
+
+  static std::string
+  storePath(const std::string& stateDir, bucket_id_t bucketId);
+
+  /** Write the last AuctionEnd message applied for each bucket */
+  static void
+  saveAssignment(const std::string& path, const std::map<bucket_id_t, AuctionMessage>& assignments);
+
+  static std::vector<AuctionMessage>
+  loadAssignment(const std::string& path);
+
+  /**
+   * Fold the log records of a bucket in a range of positions into its
+   * checkpoint. Untouched entries are copied over, so the store is not read
+   * and this can run on any thread.
+   * @return false if the file was not replaced
+   */
+  static bool
+  mergeLog(const std::string& path, WriteAheadLog& wal, bucket_id_t bucketId,
+           uint64_t from, uint64_t to);
+
+  /**
+   * Put all unexpired entries from a snapshot into a store, with their
+   * remaining TTL, and restore its tombstones
+   * @return number of entries loaded
+   */
+  static size_t
+  loadStore(const std::string& path, Store& store);
+
+private:
+  /**
+   * Wrap an entry with its expiry and write time in ms since the epoch,
+   * compressing it if that pays off
+   */
+  static ndn::Block
+  encodeEntry(const ndn::Data& data, uint64_t expiry, uint64_t writeTime, Compressor& compressor);
+
+  static ndn::Block
+  encodeTombstone(const ndn::Name& name, uint64_t expiry);
+
+  static ndn::Data
+  decodeEntry(const ndn::Block& entry);
+
+  /** Name of a packet, a name block, or a checkpoint entry or tombstone */
+  static ndn::Name
+  blockName(const ndn::Block& block);
+
+  /** Expiry of a checkpoint entry or tombstone, or 0 if it has none */
+  static uint64_t
+  blockExpiry(const ndn::Block& block);
+
+  /** Write time of a checkpoint entry, or 0 if unknown */
+  static uint64_t
+  blockWriteTime(const ndn::Block& block);
+
+  /**
+   * Write blocks produced by a generator to a temporary file and rename it
+   * into place, syncing both so the new file survives a crash
+   */
+  static bool
+  writeFile(const std::string& path, const std::function<void(std::ostream&)>& writer);
+
+  /** Sync a complete temporary file and rename it over the checkpoint */
+  static bool
+  replaceFile(const std::string& tmpPath, const std::string& path);
+
+  /** Read the next TLV block from a stream */
+  static bool
+  readBlock(std::istream& is, ndn::Block& block);
+};
+
+namespace coro {
+
+/**
+ * Merge log records into a checkpoint on a thread, and wait for it without
+ * blocking the event loop. The caller joins the thread before its io_service
+ * goes away.
+ */
+Task<bool>
+mergeLog(std::thread& thread, boost::asio::io_service& ioService, std::string path,
+         WriteAheadLog& wal, bucket_id_t bucketId, uint64_t from, uint64_t to,
+         CancelToken token = CancelToken());
+
+} // namespace coro
+
+} // namespace kua
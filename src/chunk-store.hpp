@@ -0,0 +1,169 @@
+#pragma once
+
+#include "codec.hpp"
+
+#include <ndn-cxx/util/sha256.hpp>
+
+#include <array>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace kua {
+
+/**
+ * Content-addressed chunk store with reference counting.
+ *
+ * Packet contents are indexed by their SHA-256 digest, so identical
+ * segments under different names are held once. One chunk store is shared
+ * by the workers of a node, as versions of an object hash to different
+ * buckets; its index is guarded by a mutex. Chunks are compressed by the
+ * store that first puts them, outside of the lock.
+ */
+class ChunkStore
+{
+public:
+  typedef std::array<uint8_t, 32> Key;
+
+  struct Stats
+  {
+    /** Unique contents */
+    uint64_t nChunks = 0;
+    uint64_t chunkBytes = 0;
+    /** Size of the contents as held, after compression */
+    uint64_t storedBytes = 0;
+
+    uint64_t nCompressed = 0;
+    uint64_t nUncompressed = 0;
+    uint64_t compressNs = 0;
+    uint64_t decompressNs = 0;
+  };
+
+  /** Contents smaller than this are not worth indexing */
+  static constexpr size_t MIN_SIZE = 256;
+
+  /** Add a reference to the chunk with this content, storing it if new */
+  inline Key
+  acquire(const uint8_t* data, size_t size, Compressor& compressor)
+  {
+    Key key{};
+    auto digest = ndn::util::Sha256::computeDigest(data, size);
+    std::copy_n(digest->begin(), key.size(), key.begin());
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = m_chunks.find(key);
+      if (it != m_chunks.end())
+      {
+        it->second.refs++;
+        return key;
+      }
+    }
+
+    Chunk chunk;
+    chunk.rawSize = size;
+
+    auto start = std::chrono::steady_clock::now();
+    chunk.bytes = compressor.compress(data, size);
+    const uint64_t compressNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+
+    if (chunk.bytes)
+      chunk.codec = compressor.getCodec();
+    else
+      chunk.bytes = std::make_shared<ndn::Buffer>(data, size);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.compressNs += compressNs;
+
+    // Another worker may have stored the same content meanwhile
+    auto it = m_chunks.find(key);
+    if (it != m_chunks.end())
+    {
+      it->second.refs++;
+      return key;
+    }
+
+    if (chunk.codec != Codec::NONE)
+      m_stats.nCompressed++;
+    else
+      m_stats.nUncompressed++;
+
+    m_stats.nChunks++;
+    m_stats.chunkBytes += size;
+    m_stats.storedBytes += chunk.bytes->size();
+
+    m_chunks.emplace(key, std::move(chunk));
+    return key;
+  }
+
+  /** Drop a reference to a chunk, freeing it with the last one */
+  inline void
+  release(const Key& key)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_chunks.find(key);
+    if (it == m_chunks.end() || --it->second.refs > 0)
+      return;
+
+    m_stats.nChunks--;
+    m_stats.chunkBytes -= it->second.rawSize;
+    m_stats.storedBytes -= it->second.bytes->size();
+    m_chunks.erase(it);
+  }
+
+  /** Get the original content of a chunk */
+  inline ndn::ConstBufferPtr
+  get(const Key& key)
+  {
+    Codec codec;
+    size_t rawSize;
+    ndn::ConstBufferPtr bytes;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = m_chunks.find(key);
+      if (it == m_chunks.end())
+        return nullptr;
+
+      codec = it->second.codec;
+      rawSize = it->second.rawSize;
+      bytes = it->second.bytes;
+    }
+
+    if (codec == Codec::NONE)
+      return bytes;
+
+    // Chunk bytes are never modified, so they can be read after unlocking
+    auto start = std::chrono::steady_clock::now();
+    auto raw = Compressor::decompress(codec, bytes->data(), bytes->size(), rawSize);
+    const uint64_t decompressNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.decompressNs += decompressNs;
+    return raw;
+  }
+
+  Stats
+  getStats() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+  }
+
+private:
+  struct Chunk
+  {
+    Codec codec = Codec::NONE;
+    size_t rawSize = 0;
+    size_t refs = 1;
+    ndn::ConstBufferPtr bytes;
+  };
+
+  mutable std::mutex m_mutex;
+  std::map<Key, Chunk> m_chunks;
+  Stats m_stats;
+};
+
+} // namespace kua
@@ -0,0 +1,122 @@
+#include "codec.hpp"
+
+#ifdef KUA_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef KUA_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define ZSTD_LEVEL 3
+
+namespace kua {
+
+bool
+Compressor::isAvailable(Codec codec)
+{
+  switch (codec)
+  {
+#ifdef KUA_HAVE_LZ4
+    case Codec::LZ4: return true;
+#endif
+#ifdef KUA_HAVE_ZSTD
+    case Codec::ZSTD: return true;
+#endif
+    case Codec::NONE: return true;
+    default: return false;
+  }
+}
+
+Compressor::Compressor(Codec codec)
+  : m_codec(codec)
+{
+  if (m_codec == Codec::AUTO)
+    m_codec = isAvailable(Codec::ZSTD) ? Codec::ZSTD
+            : isAvailable(Codec::LZ4) ? Codec::LZ4
+            : Codec::NONE;
+
+  if (!isAvailable(m_codec))
+    m_codec = Codec::NONE;
+}
+
+ndn::ConstBufferPtr
+Compressor::compress(const uint8_t* data, size_t size)
+{
+  if (m_codec == Codec::NONE || size < MIN_SIZE)
+    return nullptr;
+
+  // Back off on incompressible streams, probing now and then
+  if (m_failRun >= SKIP_AFTER && ++m_skipped % PROBE_INTERVAL != 0)
+    return nullptr;
+
+  auto out = std::make_shared<ndn::Buffer>();
+  size_t outSize = 0;
+
+  switch (m_codec)
+  {
+#ifdef KUA_HAVE_LZ4
+    case Codec::LZ4:
+    {
+      out->resize(LZ4_compressBound(size));
+      outSize = LZ4_compress_default(reinterpret_cast<const char*>(data),
+                                     reinterpret_cast<char*>(out->data()),
+                                     size, out->size());
+      break;
+    }
+#endif
+#ifdef KUA_HAVE_ZSTD
+    case Codec::ZSTD:
+    {
+      out->resize(ZSTD_compressBound(size));
+      outSize = ZSTD_compress(out->data(), out->size(), data, size, ZSTD_LEVEL);
+      if (ZSTD_isError(outSize))
+        outSize = 0;
+      break;
+    }
+#endif
+    default:
+      return nullptr;
+  }
+
+  if (outSize == 0 || outSize > size - size / 8)
+  {
+    m_failRun++;
+    return nullptr;
+  }
+
+  m_failRun = 0;
+  out->resize(outSize);
+  out->shrink_to_fit();
+  return out;
+}
+
+ndn::ConstBufferPtr
+Compressor::decompress(Codec codec, const uint8_t* data, size_t size, size_t rawSize)
+{
+  auto out = std::make_shared<ndn::Buffer>(rawSize);
+
+  switch (codec)
+  {
+#ifdef KUA_HAVE_LZ4
+    case Codec::LZ4:
+    {
+      int res = LZ4_decompress_safe(reinterpret_cast<const char*>(data),
+                                    reinterpret_cast<char*>(out->data()),
+                                    size, rawSize);
+      return res == static_cast<int>(rawSize) ? out : nullptr;
+    }
+#endif
+#ifdef KUA_HAVE_ZSTD
+    case Codec::ZSTD:
+    {
+      size_t res = ZSTD_decompress(out->data(), rawSize, data, size);
+      return res == rawSize ? out : nullptr;
+    }
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+} // namespace kua
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <ndn-cxx/encoding/buffer.hpp>
+
+#include <cstdint>
+
+namespace kua {
+
+enum class Codec : uint8_t
+{
+  NONE = 0,
+  LZ4 = 1,
+  ZSTD = 2,
+  /** Best codec compiled in */
+  AUTO = 255,
+};
+
+/**
+ * Per-store record compressor.
+ *
+ * Records that do not shrink by at least 1/8 are stored raw. After a run of
+ * such records only every PROBE_INTERVAL-th record is tried, so incompressible
+ * streams cost almost no codec CPU.
+ */
+class Compressor
+{
+public:
+  static constexpr size_t MIN_SIZE = 256;
+  static constexpr unsigned SKIP_AFTER = 8;
+  static constexpr unsigned PROBE_INTERVAL = 32;
+
+  explicit
+  Compressor(Codec codec);
+
+  Codec
+  getCodec() const
+  {
+    return m_codec;
+  }
+
+  /**
+   * Compress a record.
+   * @return compressed bytes, or nullptr if the record should be stored raw
+   */
+  ndn::ConstBufferPtr
+  compress(const uint8_t* data, size_t size);
+
+  /** Decompress a record of known original size */
+  static ndn::ConstBufferPtr
+  decompress(Codec codec, const uint8_t* data, size_t size, size_t rawSize);
+
+  static bool
+  isAvailable(Codec codec);
+
+private:
+  Codec m_codec;
+  unsigned m_failRun = 0;
+  unsigned m_skipped = 0;
+};
+
+} // namespace kua
@@ -7,7 +7,15 @@ enum CommandCodes
   INSERT          = 0b00000001,
   NO_REPLICATE    = 0b00000010,
   IS_RANGE        = 0b00000100,
+  DIGEST          = 0b00001000,
+  DELETE          = 0b00010000,
+  /** A TTL in milliseconds precedes the command code */
+  HAS_TTL         = 0b00100000,
+  /** A resume token precedes the command code */
+  LIST            = 0b01000000,
   FETCH           = 0b10000000,
+  /** The node to fetch the data from precedes the command code */
+  HAS_SOURCE      = 0b100000000,
 };
 
 } // namespace kua
\ No newline at end of file
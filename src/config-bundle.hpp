@@ -4,8 +4,14 @@
 #include <ndn-cxx/security/key-chain.hpp>
 #include <ndn-cxx/face.hpp>
 
+#include <functional>
+#include <memory>
+
 namespace kua {
 
+class ChunkStore;
+class WriteAheadLog;
+
 struct ConfigBundle
 {
   const ndn::Name kuaPrefix;
@@ -13,6 +19,28 @@ struct ConfigBundle
   ndn::Face& face;
   ndn::KeyChain& keyChain;
   const bool isMaster;
+
+  /**
+   * Factory for the faces used by bucket workers.
+   * If not set, each worker connects its own face and runs it in a separate thread.
+   * Faces returned by the factory must share the io_service of the main face.
+   */
+  std::function<std::shared_ptr<ndn::Face>()> workerFaceFactory = nullptr;
+
+  /** Directory for checkpoints used on warm restart. Disabled if empty. */
+  std::string stateDir;
+
+  /** Log of inserts shared by the workers, under the state directory */
+  std::shared_ptr<WriteAheadLog> wal;
+
+  /** Contents deduplicated across the stores of all workers */
+  std::shared_ptr<ChunkStore> chunks;
+
+  /** Control plane shard run by this master */
+  unsigned int masterShard = 0;
+
+  /** Label of the rack, zone or site of this node; replicas avoid sharing one */
+  std::string failureDomain;
 };
 
 } // namespace kua
@@ -21,4 +49,34 @@ struct ConfigBundle
 #define MASTER_PREFIX "/master"
 #define NUM_BUCKETS 16
 #define NUM_REPLICA 3
+#define SEGMENT_RUN_SIZE 100
 #define AUCTION_TIME_LIMIT 5
+#define MASTER_LEASE_INTERVAL_MS 1000
+#define MASTER_LEASE_TIMEOUT_MS 3000
+#define NUM_MASTER_SHARDS 1
+#define MASTER_SHARDS_PER_NODE NUM_MASTER_SHARDS
+#define ANTI_ENTROPY_INTERVAL_MS 30000
+#define STORE_COMPRESSION 1
+#define CHECKPOINT_INTERVAL_MS 60000
+#define CHECKPOINT_MIN_LOG_BYTES (4 << 20)
+#define CHECKPOINT_LOG_FRACTION 4
+#define TTL_TICK_MS 1000
+#define TOMBSTONE_LIFETIME_MS (4 * ANTI_ENTROPY_INTERVAL_MS)
+#define BATCH_TRANSMISSION 1
+#define BATCH_MAX_BYTES 65536
+#define NUM_EC_BUCKETS 0
+#define EC_DATA_FRAGMENTS 4
+#define EC_PARITY_FRAGMENTS 2
+#define LOAD_REPORT_INTERVAL_MS 5000
+#define HOT_BUCKET_READ_RATE 1000
+#define HOT_BUCKET_CHECKS 10
+#define COOL_BUCKET_CHECKS 60
+#define MAX_READ_REPLICAS 4
+#define WRITE_AHEAD_LOG 1
+#define WAL_COMMIT_WINDOW_US 2000
+#define WAL_COMMIT_MAX_BYTES (4 << 20)
+#define RTT_PROBES_PER_HEARTBEAT 4
+#define TOPOLOGY_REPORT_INTERVAL_MS 30000
+#define PLACEMENT_CANDIDATES 8
+#define PLACEMENT_RTT_WEIGHT 10
+#define PLACEMENT_DOMAIN_WEIGHT 1000
@@ -0,0 +1,678 @@
+#pragma once
+
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/util/scheduler.hpp>
+
+#include <cassert>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace kua {
+namespace coro {
+
+/**
+ * Cancellation token shared between a caller and the operations it starts.
+ *
+ * Cancelling resumes every operation waiting on the token, which completes
+ * with a CANCELLED status. Tokens can be chained to a parent and armed with
+ * a deadline. Like the awaitables below, tokens are used only from the
+ * thread running the face they belong to.
+ */
+class CancelToken
+{
+public:
+  CancelToken()
+    : m_state(std::make_shared<State>())
+  { }
+
+  /** Make a token that is also cancelled with the parent */
+  static CancelToken
+  childOf(const CancelToken& parent)
+  {
+    CancelToken token;
+    std::weak_ptr<State> weak = token.m_state;
+    token.m_state->parent = parent.m_state;
+    token.m_state->parentSub = parent.subscribe([weak] {
+      if (auto state = weak.lock())
+        cancel(*state);
+    });
+    return token;
+  }
+
+  /** Make a child token that is cancelled after a timeout */
+  static CancelToken
+  deadline(ndn::Scheduler& scheduler, ndn::time::nanoseconds timeout,
+           const CancelToken& parent = CancelToken())
+  {
+    CancelToken token = childOf(parent);
+    std::weak_ptr<State> weak = token.m_state;
+    token.m_state->timer = scheduler.schedule(timeout, [weak] {
+      if (auto state = weak.lock())
+        cancel(*state);
+    });
+    return token;
+  }
+
+  void
+  cancel() const
+  {
+    cancel(*m_state);
+  }
+
+  bool
+  isCancelled() const
+  {
+    return m_state->cancelled;
+  }
+
+  /** Call back on cancellation; returns an ID to unsubscribe with */
+  uint64_t
+  subscribe(std::function<void()> callback) const
+  {
+    m_state->callbacks[++m_state->lastId] = std::move(callback);
+    return m_state->lastId;
+  }
+
+  void
+  unsubscribe(uint64_t id) const
+  {
+    m_state->callbacks.erase(id);
+  }
+
+private:
+  struct State
+  {
+    ~State()
+    {
+      if (auto p = parent.lock())
+        p->callbacks.erase(parentSub);
+    }
+
+    bool cancelled = false;
+    uint64_t lastId = 0;
+    std::map<uint64_t, std::function<void()>> callbacks;
+
+    std::weak_ptr<State> parent;
+    uint64_t parentSub = 0;
+    ndn::scheduler::ScopedEventId timer;
+  };
+
+  static void
+  cancel(State& state)
+  {
+    if (state.cancelled)
+      return;
+
+    state.cancelled = true;
+    state.timer.cancel();
+
+    // Callbacks resume coroutines, which may unsubscribe others
+    while (!state.callbacks.empty())
+    {
+      auto it = state.callbacks.begin();
+      auto callback = std::move(it->second);
+      state.callbacks.erase(it);
+      callback();
+    }
+  }
+
+private:
+  std::shared_ptr<State> m_state;
+};
+
+namespace detail {
+
+struct PromiseBase
+{
+  std::coroutine_handle<> continuation;
+  std::exception_ptr exception;
+  bool detached = false;
+
+  std::suspend_always
+  initial_suspend() noexcept
+  {
+    return {};
+  }
+
+  void
+  unhandled_exception()
+  {
+    exception = std::current_exception();
+  }
+};
+
+template<typename T>
+struct Promise : PromiseBase
+{
+  std::optional<T> value;
+
+  void
+  return_value(T v)
+  {
+    value = std::move(v);
+  }
+
+  T
+  result()
+  {
+    if (exception)
+      std::rethrow_exception(exception);
+    return std::move(*value);
+  }
+};
+
+template<>
+struct Promise<void> : PromiseBase
+{
+  void
+  return_void()
+  { }
+
+  void
+  result()
+  {
+    if (exception)
+      std::rethrow_exception(exception);
+  }
+};
+
+/** Resume the awaiter when a task finishes, or free a detached task */
+template<typename P>
+struct FinalAwaiter
+{
+  bool
+  await_ready() noexcept
+  {
+    return false;
+  }
+
+  std::coroutine_handle<>
+  await_suspend(std::coroutine_handle<P> h) noexcept
+  {
+    auto& promise = h.promise();
+    if (promise.detached)
+    {
+      if (promise.exception)
+        std::terminate();
+      h.destroy();
+      return std::noop_coroutine();
+    }
+    return promise.continuation ? promise.continuation : std::noop_coroutine();
+  }
+
+  void
+  await_resume() noexcept
+  { }
+};
+
+} // namespace detail
+
+/**
+ * Lazily started coroutine returning T.
+ *
+ * A task runs when first awaited, or earlier with start(), and resumes its
+ * awaiter when it finishes. Tasks that were started and have already
+ * finished are awaited without suspending, so several can be started and
+ * then awaited in turn to run them concurrently.
+ */
+template<typename T = void>
+class Task
+{
+public:
+  struct promise_type : detail::Promise<T>
+  {
+    Task
+    get_return_object()
+    {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    detail::FinalAwaiter<promise_type>
+    final_suspend() noexcept
+    {
+      return {};
+    }
+  };
+
+  using Handle = std::coroutine_handle<promise_type>;
+
+public:
+  Task() = default;
+
+  explicit
+  Task(Handle h)
+    : m_handle(h)
+  { }
+
+  Task(Task&& other) noexcept
+    : m_handle(std::exchange(other.m_handle, nullptr))
+    , m_started(other.m_started)
+  { }
+
+  Task&
+  operator=(Task&& other) noexcept
+  {
+    if (this != &other)
+    {
+      reset();
+      m_handle = std::exchange(other.m_handle, nullptr);
+      m_started = other.m_started;
+    }
+    return *this;
+  }
+
+  ~Task()
+  {
+    reset();
+  }
+
+  /** Run the task until it first suspends */
+  void
+  start()
+  {
+    if (!m_started)
+    {
+      m_started = true;
+      m_handle.resume();
+    }
+  }
+
+  /** Run the task to completion on its own, destroying it when done */
+  void
+  detach()
+  {
+    auto h = std::exchange(m_handle, nullptr);
+    h.promise().detached = true;
+    if (h.done())
+      h.destroy();
+    else if (!m_started)
+      h.resume();
+  }
+
+  bool
+  await_ready() const noexcept
+  {
+    return m_handle.done();
+  }
+
+  std::coroutine_handle<>
+  await_suspend(std::coroutine_handle<> awaiter) noexcept
+  {
+    m_handle.promise().continuation = awaiter;
+    if (m_started)
+      return std::noop_coroutine();
+
+    m_started = true;
+    return m_handle;
+  }
+
+  T
+  await_resume()
+  {
+    return m_handle.promise().result();
+  }
+
+private:
+  void
+  reset()
+  {
+    if (m_handle)
+      m_handle.destroy();
+    m_handle = nullptr;
+  }
+
+private:
+  Handle m_handle;
+  bool m_started = false;
+};
+
+/** Start a task in the background; it must not throw */
+inline void
+spawn(Task<void> task)
+{
+  task.detach();
+}
+
+/**
+ * One-shot event a coroutine can wait on.
+ * Setting the event resumes the waiter right away.
+ */
+class Event
+{
+public:
+  void
+  set()
+  {
+    m_set = true;
+    if (auto waiter = std::exchange(m_waiter, nullptr))
+      waiter.resume();
+  }
+
+  bool
+  await_ready() const noexcept
+  {
+    return m_set;
+  }
+
+  void
+  await_suspend(std::coroutine_handle<> h) noexcept
+  {
+    m_waiter = h;
+  }
+
+  void
+  await_resume() const noexcept
+  { }
+
+private:
+  bool m_set = false;
+  std::coroutine_handle<> m_waiter;
+};
+
+/** Outcome of an Interest */
+struct Response
+{
+  enum class Status {
+    DATA,
+    NACK,
+    TIMEOUT,
+    CANCELLED,
+  };
+
+  Status status = Status::CANCELLED;
+  std::optional<ndn::Data> data;
+  ndn::lp::NackReason nackReason = ndn::lp::NackReason::NONE;
+
+  explicit
+  operator bool() const
+  {
+    return status == Status::DATA;
+  }
+};
+
+inline const char*
+toString(Response::Status status)
+{
+  switch (status)
+  {
+    case Response::Status::DATA: return "DATA";
+    case Response::Status::NACK: return "NACK";
+    case Response::Status::TIMEOUT: return "TIMEOUT";
+    case Response::Status::CANCELLED: return "CANCELLED";
+  }
+  return "";
+}
+
+inline std::ostream&
+operator<<(std::ostream& os, Response::Status status)
+{
+  return os << toString(status);
+}
+
+namespace detail {
+
+/**
+ * Base for awaitables completed by a callback or by cancellation.
+ * Callbacks hold the pending flag rather than the awaiter, since a face
+ * may still deliver a cancelled Interest's Data after the awaiter is gone.
+ */
+template<typename T>
+class CallbackAwaiter
+{
+public:
+  explicit
+  CallbackAwaiter(const CancelToken& token)
+    : m_token(token)
+    , m_pending(std::make_shared<bool>(false))
+  { }
+
+  CallbackAwaiter(const CallbackAwaiter&) = delete;
+
+  virtual
+  ~CallbackAwaiter()
+  {
+    *m_pending = false;
+    if (m_sub)
+      m_token.unsubscribe(m_sub);
+  }
+
+  bool
+  await_ready() const noexcept
+  {
+    return m_token.isCancelled();
+  }
+
+  void
+  await_suspend(std::coroutine_handle<> h)
+  {
+    m_waiter = h;
+    *m_pending = true;
+    m_sub = m_token.subscribe([this] {
+      m_sub = 0;
+      onCancel();
+      complete(T{});
+    });
+    begin(m_pending);
+  }
+
+  T
+  await_resume()
+  {
+    if (m_sub)
+      m_token.unsubscribe(m_sub);
+    m_sub = 0;
+    return std::move(m_result);
+  }
+
+protected:
+  using Pending = std::shared_ptr<bool>;
+
+  /** Start the operation; callbacks must check the flag before completing */
+  virtual void
+  begin(const Pending& pending) = 0;
+
+  virtual void
+  onCancel() = 0;
+
+  void
+  complete(T result)
+  {
+    if (!*m_pending)
+      return;
+
+    *m_pending = false;
+    m_result = std::move(result);
+    std::exchange(m_waiter, nullptr).resume();
+  }
+
+private:
+  CancelToken m_token;
+  uint64_t m_sub = 0;
+  Pending m_pending;
+  std::coroutine_handle<> m_waiter;
+  T m_result{};
+};
+
+class InterestAwaiter : public CallbackAwaiter<Response>
+{
+public:
+  InterestAwaiter(ndn::Face& face, const ndn::Interest& interest, const CancelToken& token)
+    : CallbackAwaiter(token)
+    , m_face(face)
+    , m_interest(interest)
+  { }
+
+protected:
+  void
+  begin(const Pending& pending) final
+  {
+    m_handle = m_face.expressInterest(m_interest,
+      [this, pending] (const auto&, const ndn::Data& data) {
+        if (!*pending)
+          return;
+        Response r;
+        r.status = Response::Status::DATA;
+        r.data = data;
+        complete(std::move(r));
+      },
+      [this, pending] (const auto&, const ndn::lp::Nack& nack) {
+        if (!*pending)
+          return;
+        Response r;
+        r.status = Response::Status::NACK;
+        r.nackReason = nack.getReason();
+        complete(std::move(r));
+      },
+      [this, pending] (const auto&) {
+        if (!*pending)
+          return;
+        Response r;
+        r.status = Response::Status::TIMEOUT;
+        complete(std::move(r));
+      });
+  }
+
+  void
+  onCancel() final
+  {
+    m_handle.cancel();
+  }
+
+private:
+  ndn::Face& m_face;
+  ndn::Interest m_interest;
+  ndn::PendingInterestHandle m_handle;
+};
+
+class SleepAwaiter : public CallbackAwaiter<bool>
+{
+public:
+  SleepAwaiter(ndn::Scheduler& scheduler, ndn::time::nanoseconds duration,
+               const CancelToken& token)
+    : CallbackAwaiter(token)
+    , m_scheduler(scheduler)
+    , m_duration(duration)
+  { }
+
+protected:
+  void
+  begin(const Pending&) final
+  {
+    m_event = m_scheduler.schedule(m_duration, [this] { complete(true); });
+  }
+
+  void
+  onCancel() final
+  {
+    m_event.cancel();
+  }
+
+private:
+  ndn::Scheduler& m_scheduler;
+  ndn::time::nanoseconds m_duration;
+  ndn::scheduler::ScopedEventId m_event;
+};
+
+template<typename T>
+Task<void>
+watch(Task<T>& task, size_t index, std::optional<std::pair<size_t, T>>& winner, Event& first)
+{
+  T result = co_await task;
+  if (!winner)
+  {
+    winner.emplace(index, std::move(result));
+    first.set();
+  }
+}
+
+} // namespace detail
+
+/**
+ * Express an Interest and wait for Data, a Nack or the Interest lifetime.
+ * Errors are returned in the response, never thrown.
+ */
+inline detail::InterestAwaiter
+expressInterest(ndn::Face& face, const ndn::Interest& interest,
+                const CancelToken& token = CancelToken())
+{
+  return detail::InterestAwaiter(face, interest, token);
+}
+
+/** Express an Interest as a task, to run it alongside others */
+inline Task<Response>
+send(ndn::Face& face, ndn::Interest interest, CancelToken token = CancelToken())
+{
+  co_return co_await expressInterest(face, interest, token);
+}
+
+/** Wait for a duration; returns false if cancelled first */
+inline detail::SleepAwaiter
+sleep(ndn::Scheduler& scheduler, ndn::time::nanoseconds duration,
+      const CancelToken& token = CancelToken())
+{
+  return detail::SleepAwaiter(scheduler, duration, token);
+}
+
+/** Run tasks concurrently and collect their results in order */
+template<typename T>
+Task<std::vector<T>>
+whenAll(std::vector<Task<T>> tasks)
+{
+  for (auto& task : tasks)
+    task.start();
+
+  std::vector<T> results;
+  results.reserve(tasks.size());
+  for (auto& task : tasks)
+    results.push_back(co_await task);
+  co_return results;
+}
+
+/** Run tasks concurrently and wait for all of them */
+inline Task<void>
+whenAll(std::vector<Task<void>> tasks)
+{
+  for (auto& task : tasks)
+    task.start();
+
+  for (auto& task : tasks)
+    co_await task;
+}
+
+/**
+ * Run tasks concurrently and return the index and result of the first to finish.
+ * The token is then cancelled, and the others are awaited so nothing outlives
+ * the call; tasks should stop early on it and must not throw.
+ */
+template<typename T>
+Task<std::pair<size_t, T>>
+whenAny(std::vector<Task<T>> tasks, CancelToken token)
+{
+  assert(!tasks.empty());
+
+  std::optional<std::pair<size_t, T>> winner;
+  Event first;
+
+  std::vector<Task<void>> watchers;
+  for (size_t i = 0; i < tasks.size(); i++)
+    watchers.push_back(detail::watch(tasks[i], i, winner, first));
+
+  for (auto& watcher : watchers)
+    watcher.start();
+
+  co_await first;
+  token.cancel();
+
+  for (auto& watcher : watchers)
+    co_await watcher;
+
+  co_return std::move(*winner);
+}
+
+} // namespace coro
+} // namespace kua
@@ -0,0 +1,78 @@
+#include "digest-tree.hpp"
+
+namespace kua {
+
+DigestTree::DigestTree()
+  : m_leaves(NUM_LEAVES)
+{
+  size_t width = 1;
+  for (size_t l = 0; l <= DEPTH; l++, width *= FANOUT)
+    m_levels.emplace_back(width, Digest{});
+}
+
+size_t
+DigestTree::leafOf(const ndn::Name& name)
+{
+  static std::hash<ndn::Name> hashFunc;
+  return hashFunc(name) % NUM_LEAVES;
+}
+
+void
+DigestTree::insert(const ndn::Name& name, const Digest& digest)
+{
+  const size_t leaf = leafOf(name);
+  auto& entries = m_leaves[leaf];
+
+  auto it = entries.find(name);
+  if (it != entries.end())
+  {
+    if (it->second == digest)
+      return;
+
+    apply(leaf, it->second);
+    it->second = digest;
+  }
+  else
+  {
+    entries.emplace(name, digest);
+  }
+
+  apply(leaf, digest);
+}
+
+void
+DigestTree::insert(const ndn::Name& name, const ndn::name::Component& implicitDigest)
+{
+  Digest digest{};
+  std::copy_n(implicitDigest.value(), std::min(implicitDigest.value_size(), digest.size()),
+              digest.begin());
+  insert(name, digest);
+}
+
+void
+DigestTree::erase(const ndn::Name& name)
+{
+  const size_t leaf = leafOf(name);
+  auto& entries = m_leaves[leaf];
+
+  auto it = entries.find(name);
+  if (it == entries.end())
+    return;
+
+  apply(leaf, it->second);
+  entries.erase(it);
+}
+
+void
+DigestTree::apply(size_t leaf, const Digest& delta)
+{
+  size_t index = leaf;
+  for (size_t l = DEPTH + 1; l-- > 0; index /= FANOUT)
+  {
+    auto& node = m_levels[l][index];
+    for (size_t i = 0; i < node.size(); i++)
+      node[i] ^= delta[i];
+  }
+}
+
+} // namespace kua
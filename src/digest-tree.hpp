@@ -0,0 +1,79 @@
+#pragma once
+
+#include <ndn-cxx/name.hpp>
+
+#include <array>
+#include <map>
+#include <vector>
+
+namespace kua {
+
+/**
+ * Fixed-shape hash tree over the entries of a store.
+ *
+ * Entries are partitioned into leaves by the hash of their name. The digest
+ * of every node is the XOR of the digests of the entries below it, so updates
+ * only touch the nodes on the path from one leaf to the root.
+ */
+class DigestTree
+{
+public:
+  typedef std::array<uint8_t, 32> Digest;
+
+  static constexpr size_t FANOUT = 16;
+  /** Leaves are at this level, the root is at level 0 */
+  static constexpr size_t DEPTH = 3;
+  static constexpr size_t NUM_LEAVES = FANOUT * FANOUT * FANOUT;
+
+  DigestTree();
+
+  /** Add an entry or replace its digest */
+  void
+  insert(const ndn::Name& name, const Digest& digest);
+
+  /** Add an entry from the implicit digest component of its full name */
+  void
+  insert(const ndn::Name& name, const ndn::name::Component& implicitDigest);
+
+  /** Remove an entry if it exists */
+  void
+  erase(const ndn::Name& name);
+
+  /** Get the digest of a node */
+  const Digest&
+  getNode(size_t level, size_t index) const
+  {
+    return m_levels.at(level).at(index);
+  }
+
+  /** Get the entries of a leaf */
+  const std::map<ndn::Name, Digest>&
+  getLeaf(size_t index) const
+  {
+    return m_leaves.at(index);
+  }
+
+  /** Get the digest of an entry, or null if it is absent */
+  const Digest*
+  find(const ndn::Name& name) const
+  {
+    const auto& leaf = m_leaves[leafOf(name)];
+    auto it = leaf.find(name);
+    return it != leaf.end() ? &it->second : nullptr;
+  }
+
+  static size_t
+  leafOf(const ndn::Name& name);
+
+private:
+  /** XOR a digest into all nodes on the path from a leaf to the root */
+  void
+  apply(size_t leaf, const Digest& delta);
+
+private:
+  /** Node digests for each level; level l has FANOUT^l nodes */
+  std::vector<std::vector<Digest>> m_levels;
+  std::vector<std::map<ndn::Name, Digest>> m_leaves;
+};
+
+} // namespace kua
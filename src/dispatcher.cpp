@@ -0,0 +1,191 @@
+#include "dispatcher.hpp"
+#include "worker.hpp"
+#include "command-codes.hpp"
+#include "ring-log.hpp"
+#include "workload-trace.hpp"
+
+#include <ndn-cxx/util/logger.hpp>
+
+namespace kua {
+
+NDN_LOG_INIT(kua.dispatcher);
+RLOG_INIT(kua.dispatcher)
+
+Dispatcher::Dispatcher(ConfigBundle& configBundle)
+  : m_kuaPrefix(configBundle.kuaPrefix)
+  , m_nodePrefix(configBundle.nodePrefix)
+  , m_face(configBundle.face)
+  , m_scheduler(m_face.getIoService())
+  , m_nlsr(configBundle.keyChain, m_face)
+{
+  NDN_LOG_INFO("Constructing Dispatcher");
+
+  // Get all interests
+  m_face.setInterestFilter("/", std::bind(&Dispatcher::onInterest, this, _1, _2));
+}
+
+void
+Dispatcher::addWorker(bucket_id_t bucketId, std::shared_ptr<Worker> worker)
+{
+  m_workers.at(bucketId) = worker;
+
+  // Register for unique node; the bucket prefix follows once the worker is caught up
+  registerPrefix(ndn::Name(m_nodePrefix).appendNumber(bucketId));
+}
+
+void
+Dispatcher::announce(bucket_id_t bucketId)
+{
+  m_face.getIoService().post([this, bucketId] {
+    if (m_workers.at(bucketId))
+      registerPrefix(ndn::Name(m_kuaPrefix).appendNumber(bucketId));
+  });
+}
+
+void
+Dispatcher::removeWorker(bucket_id_t bucketId)
+{
+  m_workers.at(bucketId) = nullptr;
+
+  // Scoped handles unregister on destruction
+  m_registrations.erase(ndn::Name(m_nodePrefix).appendNumber(bucketId));
+  m_registrations.erase(ndn::Name(m_kuaPrefix).appendNumber(bucketId));
+}
+
+void
+Dispatcher::put(const ndn::Data& data)
+{
+  m_face.getIoService().post([this, data] {
+    m_face.put(data);
+    if (WorkloadTrace::isEnabled())
+      WorkloadTrace::recordReply(data);
+  });
+}
+
+void
+Dispatcher::registerPrefix(const ndn::Name& prefix)
+{
+  m_registrations[prefix] =
+    m_face.registerPrefix(prefix,
+                          [this, prefix] (const auto&) {
+                            m_nlsr.advertise(prefix);
+                          },
+                          std::bind(&Dispatcher::onRegisterFailed, this, _1, _2));
+}
+
+void
+Dispatcher::onRegisterFailed(const ndn::Name& prefix, const std::string& reason)
+{
+  NDN_LOG_ERROR("ERROR: Failed to register prefix '" << prefix
+             << "' with the local forwarder (" << reason << ")");
+
+  if (m_failedRegistrations >= 50) {
+    NDN_LOG_ERROR("FATAL: Too many failures to register prefix '" << prefix
+             << "' with the local forwarder (" << reason << ")");
+    m_face.shutdown();
+    return;
+  }
+
+  m_scheduler.schedule(ndn::time::milliseconds(300), [this, prefix] {
+    // Skip if the worker was removed in the meantime
+    if (m_registrations.count(prefix))
+      registerPrefix(prefix);
+  });
+
+  m_failedRegistrations += 1;
+}
+
+void
+Dispatcher::onInterest(const ndn::InterestFilter&, const ndn::Interest& interest)
+{
+  auto reqName = interest.isSigned() ? interest.getName().getPrefix(-1) : interest.getName();
+
+  // Ignore interests from localhost
+  if (ndn::Name("localhost").isPrefixOf(reqName)) return;
+
+  // Command Code: /<kua-or-node-prefix>/<bucket>/<data-name>/[<ttl>]/[<resume-token>]/[<source>]/<command-code>
+  if (reqName.size() > 1 && reqName[-1].isNumber())
+  {
+    const ndn::Name* prefix = m_kuaPrefix.isPrefixOf(reqName) ? &m_kuaPrefix
+                            : m_nodePrefix.isPrefixOf(reqName) ? &m_nodePrefix
+                            : nullptr;
+
+    const uint64_t ccode = reqName[-1].toNumber();
+    const size_t nArgs = 1 + !!(ccode & CommandCodes::HAS_TTL) + !!(ccode & CommandCodes::LIST) +
+                         !!(ccode & CommandCodes::HAS_SOURCE);
+
+    if (prefix && reqName.size() == prefix->size() + 2 + nArgs && reqName[prefix->size()].isNumber())
+    {
+      auto worker = getWorker(reqName[prefix->size()].toNumber());
+
+      if (worker && (ccode & (CommandCodes::INSERT | CommandCodes::DELETE | CommandCodes::DIGEST |
+                              CommandCodes::LIST)))
+      {
+        RLOG_DEBUG("NEW_REQ : {}", reqName);
+
+        try {
+          ndn::Name argName(reqName.get(prefix->size() + 1).blockFromValue());
+
+          if (WorkloadTrace::isEnabled())
+          {
+            WorkloadTrace::recordRequest(interest, ccode, reqName[prefix->size()].toNumber(),
+                                         countSegments(argName, ccode),
+                                         prefix == &m_kuaPrefix ? WorkloadTrace::FROM_CLIENT : 0);
+          }
+
+          // Optional arguments in a fixed order
+          size_t arg = prefix->size() + 2;
+          const uint64_t ttl = (ccode & CommandCodes::HAS_TTL) ? reqName[arg++].toNumber() : 0;
+          const ndn::Name after = (ccode & CommandCodes::LIST) ? ndn::Name(reqName[arg++].blockFromValue())
+                                                               : ndn::Name();
+          const ndn::Name source = (ccode & CommandCodes::HAS_SOURCE) ? ndn::Name(reqName[arg++].blockFromValue())
+                                                                      : ndn::Name();
+
+          if (ccode & CommandCodes::INSERT)
+            worker->handleInsert(argName, interest, ccode, ttl, source);
+          else if (ccode & CommandCodes::DELETE)
+            worker->handleDelete(argName, interest, ccode);
+          else if (ccode & CommandCodes::LIST)
+            worker->handleList(argName, after, interest);
+          else
+            worker->handleDigest(argName, interest);
+        }
+        catch (const ndn::tlv::Error& e) {
+          RLOG_DEBUG("BAD_REQ : {} : {}", reqName, e.what());
+        }
+        return;
+      }
+    }
+  }
+
+  // FETCH command: forwarding hint is /<prefix>/<bucket>/<FETCH>
+  for (const auto& delegation : interest.getForwardingHint())
+  {
+    const auto& hint = delegation.name;
+    if (hint.size() > 2 && hint[-1].isNumber() && hint[-2].isNumber() &&
+        hint[-1].toNumber() == CommandCodes::FETCH)
+    {
+      if (auto worker = getWorker(hint[-2].toNumber()))
+      {
+        if (WorkloadTrace::isEnabled())
+        {
+          WorkloadTrace::recordRequest(interest, CommandCodes::FETCH, hint[-2].toNumber(), 1,
+                                       m_kuaPrefix.isPrefixOf(hint) ? WorkloadTrace::FROM_CLIENT : 0);
+        }
+        worker->handleFetch(interest);
+      }
+      return;
+    }
+  }
+}
+
+uint32_t
+Dispatcher::countSegments(const ndn::Name& dataName, uint64_t ccode)
+{
+  if ((ccode & CommandCodes::IS_RANGE) && dataName.size() > 2 && dataName[-1].isSegment() &&
+      dataName[-2].isSegment() && dataName[-1].toSegment() >= dataName[-2].toSegment())
+    return dataName[-1].toSegment() - dataName[-2].toSegment() + 1;
+  return 1;
+}
+
+} // namespace kua
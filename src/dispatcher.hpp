@@ -0,0 +1,83 @@
+#pragma once
+
+#include <ndn-cxx/util/scheduler.hpp>
+
+#include <array>
+#include <map>
+
+#include "config-bundle.hpp"
+#include "bucket.hpp"
+#include "nlsr.hpp"
+
+namespace kua {
+
+class Worker;
+
+/**
+ * Per-node request dispatcher.
+ *
+ * Receives all requests for the node on the main face, parses the command
+ * once and hands it to the queue of the worker owning the bucket.
+ */
+class Dispatcher
+{
+public:
+  Dispatcher(ConfigBundle& configBundle);
+
+  /** Route requests for a bucket to its worker and register the node bucket prefix */
+  void
+  addWorker(bucket_id_t bucketId, std::shared_ptr<Worker> worker);
+
+  /**
+   * Register the bucket prefix so that reads reach this node.
+   * May be called from any worker thread.
+   */
+  void
+  announce(bucket_id_t bucketId);
+
+  /** Stop routing requests for a bucket and unregister its prefixes */
+  void
+  removeWorker(bucket_id_t bucketId);
+
+  /** Reply to a dispatched request. May be called from any worker thread. */
+  void
+  put(const ndn::Data& data);
+
+private:
+  void
+  onInterest(const ndn::InterestFilter&, const ndn::Interest& interest);
+
+  void
+  registerPrefix(const ndn::Name& prefix);
+
+  void
+  onRegisterFailed(const ndn::Name& prefix, const std::string& reason);
+
+  /** Segments a command covers, for the workload trace */
+  static uint32_t
+  countSegments(const ndn::Name& dataName, uint64_t ccode);
+
+  /** Get the worker for a bucket, or nullptr if this node does not serve it */
+  inline std::shared_ptr<Worker>
+  getWorker(uint64_t bucketId)
+  {
+    return bucketId < m_workers.size() ? m_workers[bucketId] : nullptr;
+  }
+
+private:
+  ndn::Name m_kuaPrefix;
+  ndn::Name m_nodePrefix;
+  ndn::Face& m_face;
+  ndn::Scheduler m_scheduler;
+  NLSR m_nlsr;
+
+  /** Workers indexed by bucket ID */
+  std::array<std::shared_ptr<Worker>, NUM_BUCKETS> m_workers;
+
+  /** Prefixes registered for workers */
+  std::map<ndn::Name, ndn::ScopedRegisteredPrefixHandle> m_registrations;
+
+  size_t m_failedRegistrations = 0;
+};
+
+} // namespace kua
@@ -0,0 +1,310 @@
+#include "erasure-code.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ERASURE_CODE_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ERASURE_CODE_NEON
+#endif
+
+/** Primitive polynomial x^8 + x^4 + x^3 + x^2 + 1 */
+#define GF_POLYNOMIAL 0x11d
+
+namespace kua {
+
+namespace {
+
+struct GaloisTables
+{
+  std::array<uint8_t, 512> exp;
+  std::array<uint8_t, 256> log;
+
+  GaloisTables()
+  {
+    unsigned x = 1;
+    for (unsigned i = 0; i < 255; i++)
+    {
+      exp[i] = exp[i + 255] = x;
+      log[x] = i;
+      x <<= 1;
+      if (x & 0x100)
+        x ^= GF_POLYNOMIAL;
+    }
+    exp[510] = exp[511] = exp[0];
+    log[0] = 0;
+  }
+};
+
+const GaloisTables gf;
+
+/** Products of a constant with every low nibble and every high nibble */
+struct NibbleTables
+{
+  alignas(16) uint8_t lo[16];
+  alignas(16) uint8_t hi[16];
+
+  explicit
+  NibbleTables(uint8_t c)
+  {
+    for (unsigned i = 0; i < 16; i++)
+    {
+      lo[i] = ErasureCode::mul(c, i);
+      hi[i] = ErasureCode::mul(c, i << 4);
+    }
+  }
+};
+
+void
+mulAddScalar(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len)
+{
+  const unsigned logC = gf.log[c];
+  for (size_t i = 0; i < len; i++)
+  {
+    if (src[i])
+      dst[i] ^= gf.exp[logC + gf.log[src[i]]];
+  }
+}
+
+#ifdef ERASURE_CODE_X86
+__attribute__((target("ssse3"))) void
+mulAddSsse3(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len)
+{
+  const NibbleTables t(c);
+  const __m128i lo = _mm_load_si128(reinterpret_cast<const __m128i*>(t.lo));
+  const __m128i hi = _mm_load_si128(reinterpret_cast<const __m128i*>(t.hi));
+  const __m128i mask = _mm_set1_epi8(0x0f);
+
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16)
+  {
+    const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    const __m128i pl = _mm_shuffle_epi8(lo, _mm_and_si128(s, mask));
+    const __m128i ph = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+    d = _mm_xor_si128(d, _mm_xor_si128(pl, ph));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), d);
+  }
+  mulAddScalar(dst + i, src + i, c, len - i);
+}
+
+__attribute__((target("avx2"))) void
+mulAddAvx2(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len)
+{
+  const NibbleTables t(c);
+  const __m256i lo = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(t.lo)));
+  const __m256i hi = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(t.hi)));
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32)
+  {
+    const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    const __m256i pl = _mm256_shuffle_epi8(lo, _mm256_and_si256(s, mask));
+    const __m256i ph = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+    __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    d = _mm256_xor_si256(d, _mm256_xor_si256(pl, ph));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), d);
+  }
+  mulAddScalar(dst + i, src + i, c, len - i);
+}
+#endif
+
+#ifdef ERASURE_CODE_NEON
+void
+mulAddNeon(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len)
+{
+  const NibbleTables t(c);
+  const uint8x16_t lo = vld1q_u8(t.lo);
+  const uint8x16_t hi = vld1q_u8(t.hi);
+  const uint8x16_t mask = vdupq_n_u8(0x0f);
+
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16)
+  {
+    const uint8x16_t s = vld1q_u8(src + i);
+    const uint8x16_t pl = vqtbl1q_u8(lo, vandq_u8(s, mask));
+    const uint8x16_t ph = vqtbl1q_u8(hi, vshrq_n_u8(s, 4));
+    vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), veorq_u8(pl, ph)));
+  }
+  mulAddScalar(dst + i, src + i, c, len - i);
+}
+#endif
+
+} // namespace
+
+uint8_t
+ErasureCode::mul(uint8_t a, uint8_t b)
+{
+  if (a == 0 || b == 0)
+    return 0;
+  return gf.exp[gf.log[a] + gf.log[b]];
+}
+
+uint8_t
+ErasureCode::inv(uint8_t a)
+{
+  return gf.exp[255 - gf.log[a]];
+}
+
+ErasureCode::Kernel
+ErasureCode::bestKernel()
+{
+#if defined(ERASURE_CODE_X86)
+  if (__builtin_cpu_supports("avx2"))
+    return Kernel::AVX2;
+  if (__builtin_cpu_supports("ssse3"))
+    return Kernel::SSSE3;
+#elif defined(ERASURE_CODE_NEON)
+  return Kernel::NEON;
+#endif
+  return Kernel::SCALAR;
+}
+
+std::string
+ErasureCode::kernelName(Kernel kernel)
+{
+  switch (kernel)
+  {
+    case Kernel::SSSE3: return "ssse3";
+    case Kernel::AVX2: return "avx2";
+    case Kernel::NEON: return "neon";
+    default: return "scalar";
+  }
+}
+
+ErasureCode::ErasureCode(size_t k, size_t m, Kernel kernel)
+  : m_k(k)
+  , m_m(m)
+  , m_kernel(kernel)
+  , m_matrix((k + m) * k, 0)
+{
+  // Cauchy matrix 1 / (x_j + y_i) needs k + m distinct elements
+  if (k == 0 || k + m > 256)
+    throw std::invalid_argument("Unsupported erasure code parameters");
+
+  for (size_t i = 0; i < k; i++)
+    m_matrix[i * k + i] = 1;
+
+  for (size_t j = 0; j < m; j++)
+    for (size_t i = 0; i < k; i++)
+      m_matrix[(k + j) * k + i] = inv(static_cast<uint8_t>((k + j) ^ i));
+}
+
+void
+ErasureCode::mulAdd(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len) const
+{
+  if (c == 0)
+    return;
+
+  switch (m_kernel)
+  {
+#ifdef ERASURE_CODE_X86
+    case Kernel::AVX2: return mulAddAvx2(dst, src, c, len);
+    case Kernel::SSSE3: return mulAddSsse3(dst, src, c, len);
+#endif
+#ifdef ERASURE_CODE_NEON
+    case Kernel::NEON: return mulAddNeon(dst, src, c, len);
+#endif
+    default: return mulAddScalar(dst, src, c, len);
+  }
+}
+
+void
+ErasureCode::encode(const uint8_t* const* data, size_t n, uint8_t* const* parity, size_t len) const
+{
+  for (size_t j = 0; j < m_m; j++)
+  {
+    std::memset(parity[j], 0, len);
+    for (size_t i = 0; i < n; i++)
+      mulAdd(parity[j], data[i], row(m_k + j)[i], len);
+  }
+}
+
+bool
+ErasureCode::reconstruct(const std::vector<const uint8_t*>& fragments, size_t n,
+                         const std::vector<uint8_t*>& output, size_t len) const
+{
+  bool isMissing = false;
+  for (size_t i = 0; i < n; i++)
+    isMissing |= fragments[i] == nullptr;
+  if (!isMissing)
+    return true;
+
+  // Any k known rows; data rows past n are known to be zero
+  std::vector<size_t> rows;
+  for (size_t f = 0; f < m_k + m_m && rows.size() < m_k; f++)
+  {
+    if ((f < m_k && f >= n) || fragments[f] != nullptr)
+      rows.push_back(f);
+  }
+  if (rows.size() < m_k)
+    return false;
+
+  // Invert the rows by Gauss-Jordan elimination
+  const size_t k = m_k;
+  std::vector<uint8_t> a(k * k), b(k * k, 0);
+  for (size_t r = 0; r < k; r++)
+  {
+    std::memcpy(&a[r * k], row(rows[r]), k);
+    b[r * k + r] = 1;
+  }
+
+  for (size_t col = 0; col < k; col++)
+  {
+    size_t pivot = col;
+    while (pivot < k && a[pivot * k + col] == 0)
+      pivot++;
+    if (pivot == k)
+      return false;
+
+    if (pivot != col)
+    {
+      std::swap_ranges(&a[pivot * k], &a[pivot * k] + k, &a[col * k]);
+      std::swap_ranges(&b[pivot * k], &b[pivot * k] + k, &b[col * k]);
+    }
+
+    const uint8_t scale = inv(a[col * k + col]);
+    for (size_t c = 0; c < k; c++)
+    {
+      a[col * k + c] = mul(a[col * k + c], scale);
+      b[col * k + c] = mul(b[col * k + c], scale);
+    }
+
+    for (size_t r = 0; r < k; r++)
+    {
+      const uint8_t factor = a[r * k + col];
+      if (r == col || factor == 0)
+        continue;
+      for (size_t c = 0; c < k; c++)
+      {
+        a[r * k + c] ^= mul(factor, a[col * k + c]);
+        b[r * k + c] ^= mul(factor, b[col * k + c]);
+      }
+    }
+  }
+
+  // Each missing fragment is a combination of the known ones
+  for (size_t i = 0; i < n; i++)
+  {
+    if (fragments[i] != nullptr)
+      continue;
+
+    std::memset(output[i], 0, len);
+    for (size_t r = 0; r < k; r++)
+    {
+      if (rows[r] < m_k && rows[r] >= n)
+        continue;
+      mulAdd(output[i], fragments[rows[r]], b[i * k + r], len);
+    }
+  }
+
+  return true;
+}
+
+} // namespace kua
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace kua {
+
+/**
+ * Systematic Reed-Solomon code over GF(2^8).
+ *
+ * A stripe of k data fragments gets m parity fragments, and any k of the
+ * k+m fragments recover the rest. Parity rows form a Cauchy matrix, so
+ * every choice of k rows is invertible. All arithmetic reduces to
+ * multiplying a buffer by a constant and adding it to another, which is
+ * done 16 or 32 bytes at a time with table lookups when the CPU allows.
+ */
+class ErasureCode
+{
+public:
+  enum class Kernel
+  {
+    SCALAR,
+    SSSE3,
+    AVX2,
+    NEON,
+  };
+
+  /** Fastest kernel on this CPU */
+  static Kernel
+  bestKernel();
+
+  static std::string
+  kernelName(Kernel kernel);
+
+  ErasureCode(size_t k, size_t m, Kernel kernel = bestKernel());
+
+  size_t
+  k() const
+  {
+    return m_k;
+  }
+
+  size_t
+  m() const
+  {
+    return m_m;
+  }
+
+  /**
+   * Compute the m parity fragments of a stripe.
+   * Data fragments from n up to k are taken as zero, so short stripes
+   * need no padding fragments.
+   */
+  void
+  encode(const uint8_t* const* data, size_t n, uint8_t* const* parity, size_t len) const;
+
+  /**
+   * Recover missing data fragments in place.
+   * @param fragments k+m pointers, data first; nullptr where missing.
+   *        Missing data fragments below n are written to @p output.
+   * @param n number of data fragments in the stripe
+   * @param output buffers for the missing data fragments, indexed like fragments
+   * @return false if fewer than n fragments are present
+   */
+  bool
+  reconstruct(const std::vector<const uint8_t*>& fragments, size_t n,
+              const std::vector<uint8_t*>& output, size_t len) const;
+
+  /** dst ^= c * src */
+  void
+  mulAdd(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len) const;
+
+  static uint8_t
+  mul(uint8_t a, uint8_t b);
+
+  static uint8_t
+  inv(uint8_t a);
+
+private:
+  /** Row of the generator matrix for a fragment */
+  const uint8_t*
+  row(size_t fragment) const
+  {
+    return &m_matrix[fragment * m_k];
+  }
+
+private:
+  size_t m_k;
+  size_t m_m;
+  Kernel m_kernel;
+  /** (k+m) x k generator matrix, identity on top */
+  std::vector<uint8_t> m_matrix;
+};
+
+} // namespace kua
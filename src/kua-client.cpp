@@ -0,0 +1,837 @@
+#include "kua-client.hpp"
+#include "config-bundle.hpp"
+#include "bucket.hpp"
+#include "command-codes.hpp"
+#include "coro.hpp"
+#include "range-bitmap.hpp"
+#include "ring-log.hpp"
+#include "tlv.hpp"
+
+#include <ndn-cxx/security/signing-helpers.hpp>
+#include <ndn-cxx/util/random.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <optional>
+
+#define INSERT_RANGE_MAX_PACK 50
+
+namespace kua {
+
+RLOG_INIT(kua.client)
+
+namespace {
+
+/** Segments of an object being inserted or fetched */
+struct Object
+{
+  ndn::Name name;
+  std::vector<std::shared_ptr<ndn::Data>> segments;
+  /** Next segment to send */
+  size_t next = 0;
+  /** Segments stored or fetched */
+  size_t done = 0;
+  /** Sent with range inserts, so replicas skip only segments this put stored */
+  uint64_t insertId = 0;
+};
+
+/**
+ * Congestion window shared by all operations, in segments in flight.
+ * It grows by one segment per window of Data and halves at most once per
+ * window on timeouts. Waiters get room in the order they asked for it.
+ */
+class Window
+{
+public:
+  Window(boost::asio::io_service& ioService, size_t initial, size_t max)
+    : m_ioService(ioService)
+    , m_size(initial)
+    , m_max(max)
+  { }
+
+  class Acquire
+  {
+  public:
+    Acquire(Window& window, size_t n)
+      : m_window(window)
+      , m_n(n)
+    { }
+
+    bool
+    await_ready()
+    {
+      return m_window.m_waiters.empty() && m_window.tryTake(m_n);
+    }
+
+    void
+    await_suspend(std::coroutine_handle<> h)
+    {
+      m_window.m_waiters.emplace_back(m_n, h);
+    }
+
+    void
+    await_resume()
+    { }
+
+  private:
+    Window& m_window;
+    size_t m_n;
+  };
+
+  /** Wait for room for n segments; a single request larger than the window gets it when idle */
+  Acquire
+  acquire(size_t n)
+  {
+    return Acquire(*this, n);
+  }
+
+  void
+  release(size_t n, bool isLoss)
+  {
+    m_inFlight -= n;
+
+    if (!isLoss)
+    {
+      m_size = std::min<double>(m_max, m_size + n / m_size);
+      m_sinceDecrease += n;
+    }
+    else if (m_sinceDecrease >= m_size)
+    {
+      m_size = std::max(1.0, m_size / 2);
+      m_sinceDecrease = 0;
+      RLOG_DEBUG("WINDOW_DECREASE : {}", m_size);
+    }
+
+    // Resume on a later turn, so a release never runs another operation inline
+    while (!m_waiters.empty() && tryTake(m_waiters.front().first))
+    {
+      auto h = m_waiters.front().second;
+      m_waiters.pop_front();
+      m_ioService.post([h] { h.resume(); });
+    }
+  }
+
+private:
+  bool
+  tryTake(size_t n)
+  {
+    if (m_inFlight > 0 && m_inFlight + n > m_size)
+      return false;
+
+    m_inFlight += n;
+    return true;
+  }
+
+private:
+  boost::asio::io_service& m_ioService;
+  double m_size;
+  const double m_max;
+  size_t m_inFlight = 0;
+  double m_sinceDecrease = 0;
+  std::deque<std::pair<size_t, std::coroutine_handle<>>> m_waiters;
+};
+
+/** Prefix registration shared by the inserts of all names under it */
+struct Registration
+{
+  ndn::ScopedRegisteredPrefixHandle handle;
+  size_t nUsers = 0;
+  /** Whether the forwarder accepted it, once it answered */
+  std::optional<bool> result;
+  std::vector<std::function<void(bool)>> waiters;
+};
+
+class RegistrationAwaiter : public coro::detail::CallbackAwaiter<bool>
+{
+public:
+  explicit
+  RegistrationAwaiter(std::shared_ptr<Registration> registration)
+    : CallbackAwaiter(coro::CancelToken())
+    , m_registration(std::move(registration))
+  { }
+
+protected:
+  void
+  begin(const Pending& pending) final
+  {
+    m_registration->waiters.push_back([this, pending] (bool isOk) {
+      if (*pending)
+        complete(isOk);
+    });
+  }
+
+  void
+  onCancel() final
+  { }
+
+private:
+  std::shared_ptr<Registration> m_registration;
+};
+
+} // namespace
+
+class KuaClient::Impl
+{
+public:
+  Impl(ndn::Face& face, ndn::KeyChain& keyChain, const Options& options)
+    : m_face(face)
+    , m_keyChain(keyChain)
+    , m_options(options)
+    , m_window(face.getIoService(), options.initialWindow, options.maxWindow)
+  {
+    // Look the key up once instead of for every packet
+    try {
+      m_dataSigning = ndn::security::signingByKey(m_keyChain.getPib().getDefaultIdentity().getDefaultKey());
+    }
+    catch (const ndn::security::Pib::Error&) {
+      // Signing with the default SigningInfo creates an identity
+    }
+    m_interestSigning = m_dataSigning;
+    m_interestSigning.setSignedInterestFormat(ndn::security::SignedInterestFormat::V03);
+
+    // Objects being inserted are looked up here; registrations only route to us
+    m_filter = m_face.setInterestFilter("/", [this] (const auto&, const auto& interest) {
+      onInterest(interest);
+    });
+  }
+
+  /** Run an operation on the thread of the face and report its result */
+  template<typename R>
+  void
+  run(std::function<coro::Task<R>()> operation, std::function<void(const R&)> callback)
+  {
+    m_face.getIoService().post([operation, callback] {
+      coro::spawn([] (std::function<coro::Task<R>()> operation,
+                      std::function<void(const R&)> callback) -> coro::Task<> {
+        R result;
+        try {
+          result = co_await operation();
+        }
+        catch (const std::exception& e) {
+          result = R();
+          result.error = e.what();
+        }
+        if (callback)
+          callback(result);
+      }(operation, callback));
+    });
+  }
+
+  coro::Task<Result>
+  putObject(ndn::Name name, ndn::ConstBufferPtr content, ndn::time::milliseconds ttl)
+  {
+    auto object = makeObject(name, *content);
+
+    Result result;
+    auto registration = co_await registerName(name);
+    if (!registration->result.value_or(false))
+    {
+      releaseName(registration);
+      result.error = "REGISTER_FAILED=" + name.toUri();
+      co_return result;
+    }
+    m_published[name] = object;
+
+    // Keep about a window of segments in flight
+    std::vector<coro::Task<>> window;
+    const size_t nLoops = std::max<size_t>(1, m_options.maxWindow / INSERT_RANGE_MAX_PACK);
+    for (size_t i = 0; i < nLoops; i++)
+      window.push_back(insertLoop(object, ttl));
+    co_await coro::whenAll(std::move(window));
+
+    auto it = m_published.find(name);
+    if (it != m_published.end() && it->second == object)
+      m_published.erase(it);
+    releaseName(registration);
+
+    if (object->done != object->segments.size())
+      result.error = "INSERT_FAILED SEGMENTS=" + std::to_string(object->segments.size() - object->done);
+    co_return result;
+  }
+
+  coro::Task<GetResult>
+  getObject(ndn::Name name)
+  {
+    auto object = std::make_shared<Object>();
+    object->name = name;
+
+    GetResult result;
+
+    // The first segment tells how many there are
+    std::string error;
+    if (!co_await fetchSegment(object, ndn::Name(name).appendSegment(0), error))
+    {
+      result.error = error;
+      co_return result;
+    }
+    object->next = 1;
+
+    // No more loops than segments left to fetch
+    const size_t nLoops = std::min<size_t>(m_options.maxWindow, object->segments.size() - object->next);
+    std::vector<coro::Task<>> window;
+    for (size_t i = 0; i < nLoops; i++)
+      window.push_back(fetchLoop(object));
+    co_await coro::whenAll(std::move(window));
+
+    if (object->done != object->segments.size())
+    {
+      result.error = "FETCH_FAILED SEGMENTS=" + std::to_string(object->segments.size() - object->done);
+      co_return result;
+    }
+
+    auto buffer = std::make_shared<ndn::Buffer>();
+    for (const auto& data : object->segments)
+    {
+      const auto& c = data->getContent();
+      buffer->insert(buffer->end(), c.value_begin(), c.value_end());
+    }
+    result.content = buffer;
+    co_return result;
+  }
+
+  coro::Task<Result>
+  removeObject(ndn::Name name)
+  {
+    auto object = std::make_shared<Object>();
+    object->name = name;
+
+    Result result;
+
+    // The first segment tells how many there are
+    if (!co_await fetchSegment(object, ndn::Name(name).appendSegment(0), result.error))
+      co_return result;
+
+    // Each run of segments is in one bucket
+    const uint64_t nSegments = object->segments.size();
+    std::vector<coro::Task<coro::Response>> deletes;
+    for (uint64_t seg = 0; seg < nSegments; seg += SEGMENT_RUN_SIZE)
+    {
+      const uint64_t endSeg = std::min<uint64_t>(seg + SEGMENT_RUN_SIZE, nSegments) - 1;
+
+      ndn::Name range(name);
+      range.appendSegment(seg);
+      const auto bucketId = Bucket::idFromName(range);
+      range.appendSegment(endSeg);
+
+      deletes.push_back(sendCommand(bucketId, range, CommandCodes::DELETE | CommandCodes::IS_RANGE, 0, 1));
+    }
+
+    auto results = co_await coro::whenAll(std::move(deletes));
+    const auto failed = std::count_if(results.begin(), results.end(), [] (const auto& r) { return !r; });
+
+    if (failed)
+      result.error = "DELETE_FAILED RANGES=" + std::to_string(failed);
+    co_return result;
+  }
+
+  coro::Task<ListResult>
+  listObjects(ndn::Name prefix)
+  {
+    // Names under a prefix are spread over all buckets
+    std::vector<std::vector<ndn::Name>> names(NUM_BUCKETS);
+    std::vector<coro::Task<bool>> buckets;
+    for (bucket_id_t bucketId = 0; bucketId < NUM_BUCKETS; bucketId++)
+      buckets.push_back(listBucket(bucketId, prefix, names[bucketId]));
+
+    auto results = co_await coro::whenAll(std::move(buckets));
+    const auto failed = std::count(results.begin(), results.end(), false);
+
+    ListResult result;
+    if (failed)
+      result.error = "LIST_FAILED BUCKETS=" + std::to_string(failed);
+    for (auto& bucketNames : names)
+      result.names.insert(result.names.end(), bucketNames.begin(), bucketNames.end());
+    co_return result;
+  }
+
+private:
+  std::shared_ptr<Object>
+  makeObject(const ndn::Name& name, const ndn::Buffer& content)
+  {
+    auto object = std::make_shared<Object>();
+    object->name = name;
+    object->insertId = ndn::random::generateWord64();
+
+    const size_t segmentSize = std::max<size_t>(1, m_options.segmentSize);
+    for (size_t offset = 0; offset < content.size() || object->segments.empty(); offset += segmentSize)
+    {
+      auto data = std::make_shared<ndn::Data>(ndn::Name(name).appendSegment(object->segments.size()));
+      data->setFreshnessPeriod(ndn::time::seconds(10));
+      data->setContent(content.data() + offset, std::min(segmentSize, content.size() - offset));
+      object->segments.push_back(data);
+    }
+
+    auto finalBlockId = ndn::name::Component::fromSegment(object->segments.size() - 1);
+    for (const auto& data : object->segments)
+    {
+      data->setFinalBlock(finalBlockId);
+      m_keyChain.sign(*data, m_dataSigning);
+    }
+
+    RLOG_DEBUG("PUT : {} : {} segments", name, object->segments.size());
+    return object;
+  }
+
+  void
+  onInterest(const ndn::Interest& interest)
+  {
+    const ndn::Name& iname = interest.getName();
+    if (iname.empty())
+      return;
+
+    std::shared_ptr<ndn::Data> data;
+    if (iname[-1].isSegment())
+    {
+      auto it = m_published.find(iname.getPrefix(-1));
+      const auto segmentNo = iname[-1].toSegment();
+      if (it != m_published.end() && segmentNo < it->second->segments.size())
+        data = it->second->segments[segmentNo];
+    }
+    else
+    {
+      // Unspecified segment, return the first one
+      auto it = m_published.find(iname);
+      if (it != m_published.end() && interest.matchesData(*it->second->segments[0]))
+        data = it->second->segments[0];
+    }
+
+    if (data != nullptr)
+      m_face.put(*data);
+  }
+
+  /** Register a name unless a registration covers it already */
+  coro::Task<std::shared_ptr<Registration>>
+  registerName(ndn::Name name)
+  {
+    std::shared_ptr<Registration> registration;
+    for (size_t i = 0; i <= name.size() && !registration; i++)
+    {
+      auto it = m_registrations.find(name.getPrefix(i));
+      if (it != m_registrations.end())
+        registration = it->second;
+    }
+
+    if (!registration)
+    {
+      registration = std::make_shared<Registration>();
+      m_registrations[name] = registration;
+
+      std::weak_ptr<Registration> weak = registration;
+      auto settle = [weak] (bool isOk) {
+        auto registration = weak.lock();
+        if (!registration || registration->result)
+          return;
+        registration->result = isOk;
+        for (const auto& waiter : std::exchange(registration->waiters, {}))
+          waiter(isOk);
+      };
+
+      registration->handle = m_face.registerPrefix(name,
+        [settle] (const auto&) { settle(true); },
+        [settle, name] (const auto&, const auto& reason) {
+          RLOG_INFO("REGISTER_FAILED : {} : {}", name, reason);
+          settle(false);
+        });
+    }
+
+    registration->nUsers++;
+    if (!registration->result)
+      co_await RegistrationAwaiter(registration);
+    co_return registration;
+  }
+
+  void
+  releaseName(const std::shared_ptr<Registration>& registration)
+  {
+    // Failed registrations go too, so the next insert tries again
+    if (--registration->nUsers > 0 && registration->result.value_or(false))
+      return;
+
+    for (auto it = m_registrations.begin(); it != m_registrations.end(); ++it)
+    {
+      if (it->second == registration)
+      {
+        m_registrations.erase(it);
+        break;
+      }
+    }
+  }
+
+  /** Express an Interest in the shared window, counting it as some segments */
+  coro::Task<coro::Response>
+  express(ndn::Interest interest, size_t weight)
+  {
+    weight = std::min(weight, m_options.maxWindow);
+    co_await m_window.acquire(weight);
+    auto response = co_await coro::expressInterest(m_face, interest);
+    m_window.release(weight, response.status == coro::Response::Status::TIMEOUT);
+    co_return response;
+  }
+
+  /** One slot of the fetch window */
+  coro::Task<>
+  fetchLoop(std::shared_ptr<Object> object)
+  {
+    std::string error;
+    while (object->next < object->segments.size())
+      co_await fetchSegment(object, ndn::Name(object->name).appendSegment(object->next++), error);
+  }
+
+  coro::Task<bool>
+  fetchSegment(std::shared_ptr<Object> object, ndn::Name interestName, std::string& error)
+  {
+    const auto bucketId = Bucket::idFromName(interestName);
+
+    ndn::Name hint(m_options.kuaPrefix);
+    hint.appendNumber(bucketId);
+    hint.appendNumber(CommandCodes::FETCH);
+
+    ndn::Interest interest(interestName);
+    interest.setMustBeFresh(false);
+    interest.setCanBePrefix(false);
+    interest.setForwardingHint(ndn::DelegationList({{15893, hint }}));
+
+    for (size_t attempt = 0; attempt < m_options.maxRetries; attempt++)
+    {
+      auto response = co_await express(interest, 1);
+
+      if (response.status == coro::Response::Status::TIMEOUT)
+      {
+        RLOG_DEBUG("FETCH_RETRY : {}", interestName);
+        continue;
+      }
+
+      if (!response)
+      {
+        RLOG_INFO("FETCH_FAILED : {} : {}", interestName, coro::toString(response.status));
+        error = std::string("FETCH_") + coro::toString(response.status) + "=" + interestName.toUri();
+        co_return false;
+      }
+
+      RLOG_TRACE("FETCH_SUCCESS : {}", interestName);
+      const ndn::Data& data = *response.data;
+
+      if (!data.getFinalBlock().has_value() || !data.getName()[-1].isSegment())
+      {
+        error = "FETCH_BAD_SEGMENT=" + interestName.toUri();
+        co_return false;
+      }
+
+      const auto sz = data.getFinalBlock().value().toSegment();
+      if (sz + 1 != object->segments.size())
+        object->segments.resize(sz + 1);
+
+      const auto segmentNo = static_cast<size_t>(data.getName()[-1].toSegment());
+      if (segmentNo >= object->segments.size())
+      {
+        error = "FETCH_BAD_SEGMENT=" + interestName.toUri();
+        co_return false;
+      }
+
+      object->segments[segmentNo] = std::make_shared<ndn::Data>(data);
+      object->done++;
+      co_return true;
+    }
+
+    error = "FETCH_TIMEOUT=" + interestName.toUri();
+    co_return false;
+  }
+
+  /** One slot of the insert window */
+  coro::Task<>
+  insertLoop(std::shared_ptr<Object> object, ndn::time::milliseconds ttl)
+  {
+    while (object->next < object->segments.size())
+      co_await insertRange(object, ttl);
+  }
+
+  coro::Task<>
+  insertRange(std::shared_ptr<Object> object, ndn::time::milliseconds ttl)
+  {
+    const auto& segments = object->segments;
+
+    // Start segment
+    const auto firstName = segments[object->next]->getName();
+
+    // Range end segment
+    auto endSeg = firstName[-1].toSegment() - 1;
+    const auto firstSeg = endSeg;
+
+    const auto bucketId = Bucket::idFromName(firstName);
+
+    // Erasure-coded stripes must not be split over commands
+    const auto maxPack = Bucket::rangePackSize(bucketId, INSERT_RANGE_MAX_PACK);
+
+    while (object->next < segments.size() &&
+           Bucket::idFromName(segments[object->next]->getName()) == bucketId &&
+           endSeg - firstSeg < maxPack)
+    {
+      object->next++;
+      endSeg++;
+    }
+
+    const uint64_t startSeg = firstSeg + 1;
+    const uint64_t count = endSeg - firstSeg;
+    const ndn::Name prefix = firstName.getPrefix(-1);
+
+    uint64_t ccode = CommandCodes::INSERT | CommandCodes::IS_RANGE;
+    if (ttl > ndn::time::milliseconds(0))
+      ccode |= CommandCodes::HAS_TTL;
+
+    // Send again only the runs of segments that are not stored yet
+    std::vector<bool> stored(count, false);
+    uint64_t nStored = 0;
+    for (size_t attempt = 0; attempt < m_options.maxRetries && nStored < count; attempt++)
+    {
+      std::vector<std::pair<uint64_t, uint64_t>> runs;
+      std::vector<coro::Task<coro::Response>> commands;
+      for (uint64_t i = 0; i < count; i++)
+      {
+        if (stored[i])
+          continue;
+
+        uint64_t j = i;
+        while (j + 1 < count && !stored[j + 1])
+          j++;
+
+        runs.emplace_back(i, j);
+        commands.push_back(sendCommand(bucketId,
+                                       ndn::Name(prefix).appendSegment(startSeg + i).appendSegment(startSeg + j),
+                                       ccode, ttl.count(), j - i + 1, object->insertId));
+        i = j;
+      }
+
+      if (attempt > 0)
+        RLOG_DEBUG("INSERT_RETRY : {} : {} of {} segments in {} runs", prefix, count - nStored, count, runs.size());
+
+      auto responses = co_await coro::whenAll(std::move(commands));
+
+      const uint64_t nStoredBefore = nStored;
+      for (size_t r = 0; r < runs.size(); r++)
+      {
+        if (!responses[r])
+          continue;
+
+        const auto [first, last] = runs[r];
+        try {
+          const auto runStored = RangeBitmap::decode(responses[r].data->getContent(), last - first + 1);
+          for (uint64_t i = first; i <= last; i++)
+          {
+            if (runStored[i - first] && !stored[i])
+            {
+              stored[i] = true;
+              nStored++;
+            }
+          }
+        }
+        catch (const ndn::tlv::Error& e) {
+          RLOG_INFO("INSERT_BAD_REPLY : {} : {}", prefix, e.what());
+        }
+      }
+
+      // Commands that failed outright were already retried
+      if (nStored == nStoredBefore)
+        break;
+    }
+
+    object->done += nStored;
+  }
+
+  /** Collect the names under a prefix in a bucket, one page at a time */
+  coro::Task<bool>
+  listBucket(bucket_id_t bucketId, ndn::Name prefix, std::vector<ndn::Name>& names)
+  {
+    ndn::Name after;
+    while (true)
+    {
+      ndn::Name interestName(m_options.kuaPrefix);
+      interestName.appendNumber(bucketId);
+      interestName.append(prefix.wireEncode());
+      interestName.append(after.wireEncode());
+      interestName.appendNumber(CommandCodes::LIST);
+
+      coro::Response response;
+      for (size_t attempt = 0; attempt < m_options.maxRetries; attempt++)
+      {
+        ndn::Interest interest(interestName);
+        interest.setCanBePrefix(false);
+        interest.setMustBeFresh(true);
+        interest.setInterestLifetime(ndn::time::milliseconds(3000));
+
+        response = co_await express(interest, 1);
+        if (response.status != coro::Response::Status::TIMEOUT)
+          break;
+      }
+
+      if (!response)
+      {
+        RLOG_INFO("LIST_FAILED : {} : {}", bucketId, coro::toString(response.status));
+        co_return false;
+      }
+
+      // Names of the page, then a resume token if more follow
+      after.clear();
+      try {
+        const auto& content = response.data->getContent();
+        content.parse();
+        for (const auto& element : content.elements())
+        {
+          if (element.type() == ndn::tlv::Name)
+            names.emplace_back(element);
+          else if (element.type() == tlv::ListResumeToken)
+            after = ndn::Name(element.blockFromValue());
+        }
+      }
+      catch (const ndn::tlv::Error& e) {
+        RLOG_INFO("LIST_BAD_REPLY : {} : {}", bucketId, e.what());
+        co_return false;
+      }
+
+      if (after.empty())
+        co_return true;
+    }
+  }
+
+  /**
+   * Send a command for a data name to a bucket, retrying on timeout; returns the last response.
+   * @param weight segments the command moves, as counted in the window
+   * @param insertId put the command belongs to, or 0 if none
+   */
+  coro::Task<coro::Response>
+  sendCommand(bucket_id_t bucketId, ndn::Name dataName, uint64_t ccode, uint64_t ttl, size_t weight,
+              uint64_t insertId = 0)
+  {
+    ndn::Name interestName(m_options.kuaPrefix);
+    interestName.appendNumber(bucketId);
+    interestName.append(dataName.wireEncode());
+    if (ccode & CommandCodes::HAS_TTL)
+      interestName.appendNumber(ttl);
+    interestName.appendNumber(ccode);
+
+    coro::Response response;
+    for (size_t attempt = 0; attempt < m_options.maxRetries; attempt++)
+    {
+      // Signed afresh for each attempt
+      ndn::Interest interest(interestName);
+      interest.setCanBePrefix(false);
+      interest.setMustBeFresh(true);
+      interest.setInterestLifetime(ndn::time::milliseconds(3000));
+      if (insertId != 0)
+        interest.setApplicationParameters(ndn::encoding::makeNonNegativeIntegerBlock(tlv::InsertId, insertId));
+      m_keyChain.sign(interest, m_interestSigning);
+
+      response = co_await express(interest, weight);
+      if (response)
+      {
+        RLOG_TRACE("CMD_SUCCESS : {}", interestName);
+        co_return response;
+      }
+
+      if (response.status != coro::Response::Status::TIMEOUT)
+      {
+        RLOG_INFO("CMD_FAILED : {} : {}", interestName, coro::toString(response.status));
+        co_return response;
+      }
+
+      RLOG_DEBUG("CMD_RETRY : {}", interestName);
+    }
+
+    co_return response;
+  }
+
+private:
+  ndn::Face& m_face;
+  ndn::KeyChain& m_keyChain;
+  const Options m_options;
+
+  ndn::security::SigningInfo m_dataSigning;
+  ndn::security::SigningInfo m_interestSigning;
+
+  Window m_window;
+
+  ndn::ScopedInterestFilterHandle m_filter;
+  /** Objects being inserted, by name */
+  std::map<ndn::Name, std::shared_ptr<Object>> m_published;
+  std::map<ndn::Name, std::shared_ptr<Registration>> m_registrations;
+};
+
+KuaClient::KuaClient(ndn::Face& face, ndn::KeyChain& keyChain)
+  : KuaClient(face, keyChain, Options())
+{
+}
+
+KuaClient::KuaClient(ndn::Face& face, ndn::KeyChain& keyChain, const Options& options)
+  : m_impl(std::make_unique<Impl>(face, keyChain, options))
+{
+}
+
+KuaClient::~KuaClient() = default;
+
+void
+KuaClient::put(const ndn::Name& name, ndn::ConstBufferPtr content, ndn::time::milliseconds ttl,
+               Callback callback)
+{
+  Impl* impl = m_impl.get();
+  impl->run<Result>([impl, name, content, ttl] { return impl->putObject(name, content, ttl); },
+                    std::move(callback));
+}
+
+void
+KuaClient::get(const ndn::Name& name, GetCallback callback)
+{
+  Impl* impl = m_impl.get();
+  impl->run<GetResult>([impl, name] { return impl->getObject(name); }, std::move(callback));
+}
+
+void
+KuaClient::remove(const ndn::Name& name, Callback callback)
+{
+  Impl* impl = m_impl.get();
+  impl->run<Result>([impl, name] { return impl->removeObject(name); }, std::move(callback));
+}
+
+void
+KuaClient::list(const ndn::Name& prefix, ListCallback callback)
+{
+  Impl* impl = m_impl.get();
+  impl->run<ListResult>([impl, prefix] { return impl->listObjects(prefix); }, std::move(callback));
+}
+
+std::future<KuaClient::Result>
+KuaClient::put(const ndn::Name& name, ndn::ConstBufferPtr content, ndn::time::milliseconds ttl)
+{
+  auto promise = std::make_shared<std::promise<Result>>();
+  auto future = promise->get_future();
+  put(name, std::move(content), ttl, [promise] (const Result& r) { promise->set_value(r); });
+  return future;
+}
+
+std::future<KuaClient::GetResult>
+KuaClient::get(const ndn::Name& name)
+{
+  auto promise = std::make_shared<std::promise<GetResult>>();
+  auto future = promise->get_future();
+  get(name, [promise] (const GetResult& r) { promise->set_value(r); });
+  return future;
+}
+
+std::future<KuaClient::Result>
+KuaClient::remove(const ndn::Name& name)
+{
+  auto promise = std::make_shared<std::promise<Result>>();
+  auto future = promise->get_future();
+  remove(name, [promise] (const Result& r) { promise->set_value(r); });
+  return future;
+}
+
+std::future<KuaClient::ListResult>
+KuaClient::list(const ndn::Name& prefix)
+{
+  auto promise = std::make_shared<std::promise<ListResult>>();
+  auto future = promise->get_future();
+  list(prefix, [promise] (const ListResult& r) { promise->set_value(r); });
+  return future;
+}
+
+} // namespace kua
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <ndn-cxx/encoding/buffer.hpp>
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/name.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kua {
+
+/**
+ * Asynchronous client of a kua cluster, to embed in other services.
+ *
+ * Any number of operations can run at once over one face. They share a
+ * congestion window that grows on Data and halves on timeouts like TCP's,
+ * so concurrent transfers back off together instead of each flooding the
+ * network. The signing key is looked up once, and objects being inserted
+ * are served from one table under a catch-all Interest filter, with a
+ * prefix registration only for names no earlier registration covers.
+ *
+ * Operations may be started from any thread. They run on the thread that
+ * processes events of the face, which also calls the callbacks; futures
+ * are for callers on other threads. The client must outlive the face's
+ * event loop or its operations.
+ */
+class KuaClient
+{
+public:
+  struct Options
+  {
+    /** Prefix of the cluster */
+    ndn::Name kuaPrefix = "/kua";
+    /** Congestion window bounds, in segments in flight over all operations */
+    size_t initialWindow = 32;
+    size_t maxWindow = 300;
+    /** Attempts per Interest before giving up */
+    size_t maxRetries = 8;
+    /** Payload bytes per segment of inserted objects */
+    size_t segmentSize = 8000;
+  };
+
+  /** Outcome of an operation; the error is empty on success */
+  struct Result
+  {
+    std::string error;
+
+    explicit
+    operator bool() const
+    {
+      return error.empty();
+    }
+  };
+
+  struct GetResult : Result
+  {
+    ndn::ConstBufferPtr content;
+  };
+
+  struct ListResult : Result
+  {
+    std::vector<ndn::Name> names;
+  };
+
+  using Callback = std::function<void(const Result&)>;
+  using GetCallback = std::function<void(const GetResult&)>;
+  using ListCallback = std::function<void(const ListResult&)>;
+
+  KuaClient(ndn::Face& face, ndn::KeyChain& keyChain);
+
+  KuaClient(ndn::Face& face, ndn::KeyChain& keyChain, const Options& options);
+
+  ~KuaClient();
+
+  /** Insert an object, to expire after a TTL unless it is zero */
+  void
+  put(const ndn::Name& name, ndn::ConstBufferPtr content, ndn::time::milliseconds ttl,
+      Callback callback);
+
+  /** Fetch an object */
+  void
+  get(const ndn::Name& name, GetCallback callback);
+
+  /** Delete an object from all replicas */
+  void
+  remove(const ndn::Name& name, Callback callback);
+
+  /** List the names of the segments under a prefix, in all buckets */
+  void
+  list(const ndn::Name& prefix, ListCallback callback);
+
+  std::future<Result>
+  put(const ndn::Name& name, ndn::ConstBufferPtr content,
+      ndn::time::milliseconds ttl = ndn::time::milliseconds(0));
+
+  std::future<GetResult>
+  get(const ndn::Name& name);
+
+  std::future<Result>
+  remove(const ndn::Name& name);
+
+  std::future<ListResult>
+  list(const ndn::Name& prefix);
+
+private:
+  class Impl;
+  std::unique_ptr<Impl> m_impl;
+};
+
+} // namespace kua
@@ -1,21 +1,38 @@
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <ndn-cxx/util/logger.hpp>
 
 #include "config-bundle.hpp"
+#include "sync-group.hpp"
 #include "node-watcher.hpp"
 #include "bidder.hpp"
 #include "master.hpp"
 #include "nlsr.hpp"
+#include "batch-transport.hpp"
+#include "ring-log.hpp"
+#include "workload-trace.hpp"
+#include "write-ahead-log.hpp"
+#include "chunk-store.hpp"
 
 NDN_LOG_INIT(kua.main);
 
 int
 main(int argc, char *argv[])
 {
+  const bool isMaster =
+#ifdef KUA_IS_MASTER
+    true;
+#else
+    false;
+#endif
+
   if (argc < 3)
   {
-    std::cerr << "Usage: kua <kua-prefix> <node-prefix>" << std::endl;
+    if (isMaster)
+      std::cerr << "Usage: kua-master <kua-prefix> <node-prefix> [shard]" << std::endl;
+    else
+      std::cerr << "Usage: kua <kua-prefix> <node-prefix> [state-dir]" << std::endl;
     exit(1);
   }
 
@@ -23,35 +40,72 @@ main(int argc, char *argv[])
   const ndn::Name kuaPrefix(argv[1]);
   const ndn::Name nodePrefix(argv[2]);
 
-  const bool isMaster =
-#ifdef KUA_IS_MASTER
-    true;
-#else
-    false;
-#endif
+  // Standby masters find each other under the master prefix
+  if (isMaster && !ndn::Name(MASTER_PREFIX).isPrefixOf(nodePrefix))
+  {
+    std::cerr << "Master prefix must be under " << MASTER_PREFIX << std::endl;
+    exit(1);
+  }
+
+  // Binary log for request paths, if asked for
+  kua::RingLog::startFromEnvironment();
+
+  // Capture of served requests for kua-replay, if asked for
+  kua::WorkloadTrace::startFromEnvironment();
 
   // Start face and keychain
-  ndn::Face face;
+  auto facePtr = kua::makeFace();
+  ndn::Face& face = *facePtr;
   ndn::KeyChain keyChain;
   kua::NLSR nlsr(keyChain, face);
 
   // Create common bundle
   kua::ConfigBundle configBundle { kuaPrefix, nodePrefix, face, keyChain, isMaster };
+  if (argc > 3 && isMaster)
+    configBundle.masterShard = std::stoul(argv[3]);
+  else if (argc > 3)
+    configBundle.stateDir = argv[3];
+
+  // Replicas of a bucket are spread over failure domains when labeled
+  if (const char* domain = std::getenv("KUA_FAILURE_DOMAIN"))
+    configBundle.failureDomain = domain;
+
+  if (configBundle.masterShard >= NUM_MASTER_SHARDS)
+  {
+    std::cerr << "Shard must be less than " << NUM_MASTER_SHARDS << std::endl;
+    exit(1);
+  }
+
+  // Identical contents are held once across all buckets of the node
+  configBundle.chunks = std::make_shared<kua::ChunkStore>();
+
+  // Inserts are acknowledged once logged, if there is a place to log them
+  if (WRITE_AHEAD_LOG && !isMaster && !configBundle.stateDir.empty())
+  {
+    try {
+      configBundle.wal = std::make_shared<kua::WriteAheadLog>(kua::WriteAheadLog::dirPath(configBundle.stateDir));
+    }
+    catch (const std::exception& e) {
+      NDN_LOG_ERROR("Cannot open write-ahead log, acknowledging inserts when stored: " << e.what());
+    }
+  }
 
   // Start components
-  kua::NodeWatcher nodeWatcher(configBundle);
-  kua::Bidder bidder(configBundle, nodeWatcher);
+  kua::SyncGroup syncGroup(configBundle);
+  kua::NodeWatcher nodeWatcher(configBundle, syncGroup);
+  kua::Bidder bidder(configBundle, syncGroup, nodeWatcher);
 
   // Advertise basic prefixes
   nlsr.advertise(nodePrefix);
-  nlsr.advertise(ndn::Name(kuaPrefix).append("sync").append("auction"));
-  nlsr.advertise(ndn::Name(kuaPrefix).append("sync").append("health"));
+  nlsr.advertise(ndn::Name(kuaPrefix).append("sync"));
 
   std::unique_ptr<kua::Master> master;
   if (isMaster) {
-    master = std::make_unique<kua::Master>(configBundle, nodeWatcher);
+    master = std::make_unique<kua::Master>(configBundle, syncGroup, nodeWatcher);
   }
 
   // Infinite loop
   face.processEvents();
+  kua::WorkloadTrace::stop();
+  kua::RingLog::stop();
 }
\ No newline at end of file
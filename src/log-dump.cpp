@@ -0,0 +1,242 @@
+#include "ring-log.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace kua {
+
+/** Formats the binary files written by RingLog */
+class LogDump
+{
+public:
+  explicit
+  LogDump(std::istream& is)
+    : m_is(is)
+  {
+  }
+
+  bool
+  run(std::ostream& os)
+  {
+    char header[8];
+    if (!m_is.read(header, sizeof(header)) || std::string(header, sizeof(header)) != "KUALOG1\n")
+    {
+      std::cerr << "Not a kua log file" << std::endl;
+      return false;
+    }
+
+    char tag;
+    while (m_is.get(tag))
+    {
+      if (tag == 'S')
+      {
+        const auto id = get<uint32_t>();
+        Site& site = m_sites[id];
+        site.level = get<uint8_t>();
+        site.module = getString();
+        site.format = getString();
+      }
+      else if (tag == 'E')
+      {
+        const auto threadId = get<uint32_t>();
+        std::vector<uint8_t> events(get<uint32_t>());
+        m_is.read(reinterpret_cast<char*>(events.data()), events.size());
+
+        for (size_t pos = 0; pos + 2 <= events.size();)
+        {
+          uint16_t size;
+          std::memcpy(&size, &events[pos], sizeof(size));
+          if (size < RING_LOG_RECORD_HEADER || pos + size > events.size())
+            break;
+          printRecord(os, threadId, &events[pos], size);
+          pos += size;
+        }
+      }
+      else if (tag == 'D')
+      {
+        const auto threadId = get<uint32_t>();
+        const auto count = get<uint64_t>();
+        os << "DROPPED " << count << " records on thread " << threadId << "\n";
+      }
+      else
+      {
+        std::cerr << "Corrupt log file" << std::endl;
+        return false;
+      }
+
+      if (!m_is)
+      {
+        std::cerr << "Truncated log file" << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  struct Site
+  {
+    int level;
+    std::string module;
+    std::string format;
+  };
+
+  template<typename T>
+  T
+  get()
+  {
+    T value{};
+    m_is.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return value;
+  }
+
+  std::string
+  getString()
+  {
+    std::string str(get<uint16_t>(), '\0');
+    m_is.read(str.data(), str.size());
+    return str;
+  }
+
+  static const char*
+  levelName(int level)
+  {
+    switch (level)
+    {
+      case RING_LOG_TRACE: return "TRACE";
+      case RING_LOG_DEBUG: return "DEBUG";
+      default: return "INFO";
+    }
+  }
+
+  /** Format one argument; returns false if the record ends early */
+  static bool
+  printArg(std::ostream& os, const uint8_t*& p, const uint8_t* end)
+  {
+    if (p >= end)
+      return false;
+
+    const uint8_t type = *p++;
+    if (type == RingLog::ARG_UINT || type == RingLog::ARG_INT || type == RingLog::ARG_DOUBLE)
+    {
+      if (end - p < 8)
+        return false;
+
+      if (type == RingLog::ARG_UINT)
+      {
+        uint64_t value;
+        std::memcpy(&value, p, 8);
+        os << value;
+      }
+      else if (type == RingLog::ARG_INT)
+      {
+        int64_t value;
+        std::memcpy(&value, p, 8);
+        os << value;
+      }
+      else
+      {
+        double value;
+        std::memcpy(&value, p, 8);
+        os << value;
+      }
+      p += 8;
+      return true;
+    }
+
+    uint16_t len;
+    if (end - p < 2)
+      return false;
+    std::memcpy(&len, p, 2);
+    p += 2;
+    if (end - p < len)
+      return false;
+
+    if (type == RingLog::ARG_NAME)
+    {
+      try {
+        os << ndn::Name(ndn::Block(p, len));
+      }
+      catch (const std::exception&) {
+        os << "(bad name)";
+      }
+    }
+    else
+    {
+      os.write(reinterpret_cast<const char*>(p), len);
+    }
+    p += len;
+    return true;
+  }
+
+  void
+  printRecord(std::ostream& os, uint32_t threadId, const uint8_t* record, uint16_t size)
+  {
+    uint32_t siteId;
+    uint64_t time;
+    std::memcpy(&siteId, record + 2, sizeof(siteId));
+    std::memcpy(&time, record + 6, sizeof(time));
+
+    auto it = m_sites.find(siteId);
+    if (it == m_sites.end())
+    {
+      os << "UNKNOWN_SITE " << siteId << "\n";
+      return;
+    }
+    const Site& site = it->second;
+
+    char stamp[32];
+    std::snprintf(stamp, sizeof(stamp), "%llu.%06llu",
+                  static_cast<unsigned long long>(time / 1000000000),
+                  static_cast<unsigned long long>(time % 1000000000 / 1000));
+    os << stamp << " " << levelName(site.level) << ": [" << site.module << ":" << threadId << "] ";
+
+    const uint8_t* p = record + RING_LOG_RECORD_HEADER;
+    const uint8_t* end = record + size;
+    const std::string& format = site.format;
+    for (size_t i = 0; i < format.size(); i++)
+    {
+      if (format.compare(i, 2, "{}") == 0)
+      {
+        if (!printArg(os, p, end))
+          os << "{}";
+        i++;
+      }
+      else
+      {
+        os << format[i];
+      }
+    }
+    os << "\n";
+  }
+
+private:
+  std::istream& m_is;
+  std::unordered_map<uint32_t, Site> m_sites;
+};
+
+} // namespace kua
+
+int
+main(int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: kua-logdump <log-file>" << std::endl;
+    return 1;
+  }
+
+  std::ifstream file(argv[1], std::ios::binary);
+  if (!file)
+  {
+    std::cerr << "Cannot open " << argv[1] << std::endl;
+    return 1;
+  }
+
+  return kua::LogDump(file).run(std::cout) ? 0 : 1;
+}
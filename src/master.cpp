@@ -2,43 +2,126 @@
 
 #include <ndn-cxx/util/logger.hpp>
 
+#include <algorithm>
+#include <set>
+#include <tuple>
+
 namespace kua {
 
 NDN_LOG_INIT(kua.master);
 
-Master::Master(ConfigBundle& configBundle, NodeWatcher& nodeWatcher)
+Master::Master(ConfigBundle& configBundle, SyncGroup& syncGroup, NodeWatcher& nodeWatcher)
   : m_configBundle(configBundle)
-  , m_syncPrefix(ndn::Name(configBundle.kuaPrefix).append("sync").append("auction"))
+  , m_stream(Bucket::auctionStream(configBundle.masterShard))
   , m_nodePrefix(configBundle.nodePrefix)
+  , m_shard(configBundle.masterShard)
+  , m_firstBucket(NUM_BUCKETS)
+  , m_endBucket(0)
   , m_face(configBundle.face)
   , m_scheduler(m_face.getIoService())
   , m_keyChain(configBundle.keyChain)
+  , m_syncGroup(syncGroup)
   , m_nodeWatcher(nodeWatcher)
   , m_rng(ndn::random::getRandomNumberEngine())
 {
   NDN_LOG_INFO("Constructing Master");
 
   // Initialize bucket list
+  m_load.resize(NUM_BUCKETS);
   for (unsigned int i = 0; i < NUM_BUCKETS; i++)
+  {
     m_buckets.push_back(Bucket(i));
+    if (Bucket::shardFromId(i) == m_shard)
+    {
+      m_firstBucket = std::min(m_firstBucket, i);
+      m_endBucket = i + 1;
+    }
+  }
+  NDN_LOG_INFO("Master for shard " << m_shard << " with buckets #" <<
+               m_firstBucket << " to #" << m_endBucket - 1);
+
+  // Standbys follow the stream too, to track the leader and assignments
+  m_syncGroup.subscribe(m_stream, nullptr, std::bind(&Master::processMessage, this, _1, _2));
+
+  // Listen for an active master before contending for the lease
+  m_lastLease = ndn::time::steady_clock::now();
+  m_leaseEvent = m_scheduler.schedule(ndn::time::milliseconds(MASTER_LEASE_INTERVAL_MS),
+                                      [this] { checkLease(); });
+}
+
+void
+Master::checkLease()
+{
+  if (m_active)
+  {
+    auto msg = newMsg(AuctionMessage::Type::Lease);
+    m_syncGroup.publish(m_stream, msg.wireEncode(),
+                        ndn::time::milliseconds(MASTER_LEASE_INTERVAL_MS));
+  }
+  else if (ndn::time::steady_clock::now() - m_lastLease >
+           ndn::time::milliseconds(MASTER_LEASE_TIMEOUT_MS))
+  {
+    takeOver();
+  }
+
+  m_leaseEvent = m_scheduler.schedule(ndn::time::milliseconds(MASTER_LEASE_INTERVAL_MS),
+                                      [this] { checkLease(); });
+}
+
+void
+Master::takeOver()
+{
+  m_epoch++;
+  m_leader = m_nodePrefix;
+  m_active = true;
+  NDN_LOG_INFO("Taking over as master with epoch " << m_epoch);
+
+  // Announce the new epoch right away so bidders fence the old master
+  auto msg = newMsg(AuctionMessage::Type::Lease);
+  m_syncGroup.publish(m_stream, msg.wireEncode(),
+                      ndn::time::milliseconds(MASTER_LEASE_INTERVAL_MS));
+
+  // Any auction in flight belonged to the previous master
+  m_currentAuctionId = 0;
+  for (auto& b : m_buckets)
+    b.pendingHosts.clear();
+
+  initialize();
+}
+
+void
+Master::stepDown()
+{
+  NDN_LOG_INFO("Stepping down for " << m_leader << " with epoch " << m_epoch);
 
-  // Initialize SVS
-  m_svs = std::make_unique<ndn::svs::SVSync>(
-    m_syncPrefix, MASTER_PREFIX, m_face, std::bind(&Master::updateCallback, this, _1));
+  m_active = false;
+  m_initialized = false;
+  m_currentAuctionId = 0;
+  m_auctionRecheckEvent.cancel();
+  m_initializeEvent.cancel();
+}
 
-  // Wait 3s before initialization
-  m_scheduler.schedule(ndn::time::milliseconds(3000), [this] { initialize(); });
+std::vector<ndn::Name>
+Master::getBidderList()
+{
+  // Standby masters also appear in the node list but never bid
+  std::vector<ndn::Name> bidders;
+  for (const auto& node : m_nodeWatcher.getNodeList())
+    if (!ndn::Name(MASTER_PREFIX).isPrefixOf(node) && Bucket::nodeInShard(node, m_shard))
+      bidders.push_back(node);
+  return bidders;
 }
 
 void
 Master::initialize()
 {
-  auto nodeList = m_nodeWatcher.getNodeList();
+  if (!m_active)
+    return;
 
-  if (nodeList.size() < NUM_REPLICA)
+  if (getBidderList().size() < NUM_REPLICA)
   {
     NDN_LOG_TRACE("Will not initialize Master without " << NUM_REPLICA << " nodes known");
-    m_scheduler.schedule(ndn::time::milliseconds(1000), [this] { initialize(); });
+    m_initializeEvent = m_scheduler.schedule(ndn::time::milliseconds(1000), [this] { initialize(); });
     return;
   }
 
@@ -54,15 +137,20 @@ Master::auction()
 {
   if (!m_currentAuctionId)
   {
-    for (unsigned int i = 0; i < m_buckets.size(); i++)
+    for (unsigned int i = m_firstBucket; i < m_endBucket; i++)
     {
       Bucket& b = m_buckets[i];
       if (b.confirmedHosts.size() == 0)
       {
+        m_currentAuctionForReader = false;
         auction(i);
         break;
       }
     }
+
+    // Hosts for every bucket come before extra replicas
+    if (!m_currentAuctionId)
+      checkLoad();
   }
   else
   {
@@ -86,23 +174,11 @@ Master::auction(unsigned int id)
   NDN_LOG_INFO("Starting auction for #" << m_currentAuctionBucketId << " AID " << m_currentAuctionId);
 
   m_currentAuctionBids.clear();
-  m_currentAuctionNumBidsExpected = m_nodeWatcher.getNodeList().size();
+  m_currentAuctionNumBidsExpected = getBidderList().size();
   m_buckets[m_currentAuctionBucketId].pendingHosts.clear();
 
   auto msg = newMsg(AuctionMessage::Type::Auction);
-  m_svs->publishData(msg.wireEncode(), ndn::time::milliseconds(1000));
-}
-
-void
-Master::updateCallback(const std::vector<ndn::svs::MissingDataInfo>& missingInfo)
-{
-  if (!m_initialized) return;
-
-  for (const auto m : missingInfo) {
-    for (ndn::svs::SeqNo i = m.low; i <= m.high; i++) {
-      m_svs->fetchData(m.nodeId, i, std::bind(&Master::processMessage, this, m.nodeId, _1), 10);
-    }
-  }
+  m_syncGroup.publish(m_stream, msg.wireEncode(), ndn::time::milliseconds(1000));
 }
 
 void
@@ -111,6 +187,23 @@ Master::processMessage(const ndn::Name& sender, const ndn::Data& data)
   AuctionMessage msg;
   msg.wireDecode(data.getContent().blockFromValue());
 
+  if (ndn::Name(MASTER_PREFIX).isPrefixOf(sender))
+  {
+    if (sender != m_nodePrefix)
+      processMasterMessage(sender, msg);
+    return;
+  }
+
+  // Standbys keep the topology too, for placement after a takeover
+  if (msg.messageType == AuctionMessage::Type::Topology)
+    return processTopology(sender, msg);
+
+  if (!m_active || !m_initialized)
+    return;
+
+  if (msg.messageType == AuctionMessage::Type::Load)
+    return processLoad(sender, msg);
+
   // Unknown auction
   if (msg.auctionId != m_currentAuctionId || msg.bucketId != m_currentAuctionBucketId)
     return;
@@ -147,7 +240,10 @@ Master::processMessage(const ndn::Name& sender, const ndn::Data& data)
       if (m.count(sender))
       {
         m.erase(sender);
-        m_buckets[m_currentAuctionBucketId].confirmedHosts[sender] = 1;
+        if (m_currentAuctionForReader)
+          m_buckets[m_currentAuctionBucketId].readHosts[sender] = 1;
+        else
+          m_buckets[m_currentAuctionBucketId].confirmedHosts[sender] = 1;
       }
 
       // Check if all pending are confirmed now
@@ -162,15 +258,71 @@ Master::processMessage(const ndn::Name& sender, const ndn::Data& data)
   }
 }
 
+void
+Master::processMasterMessage(const ndn::Name& sender, const AuctionMessage& msg)
+{
+  // Fence off masters from older epochs; ties go to the higher name
+  if (std::tie(msg.epoch, sender) < std::tie(m_epoch, m_leader))
+    return;
+
+  if (sender != m_leader)
+  {
+    m_epoch = msg.epoch;
+    m_leader = sender;
+    if (m_active)
+      stepDown();
+  }
+
+  m_lastLease = ndn::time::steady_clock::now();
+
+  // Keep the assignment table warm for a takeover; AuctionEnds may arrive out of order
+  if (msg.messageType == AuctionMessage::Type::AuctionEnd &&
+      msg.bucketId >= m_firstBucket && msg.bucketId < m_endBucket &&
+      std::tie(msg.epoch, msg.assignmentVersion) >
+        std::tie(m_buckets[msg.bucketId].epoch, m_buckets[msg.bucketId].version))
+  {
+    m_buckets[msg.bucketId].epoch = msg.epoch;
+    m_buckets[msg.bucketId].version = msg.assignmentVersion;
+
+    auto& hosts = m_buckets[msg.bucketId].confirmedHosts;
+    hosts.clear();
+    for (const auto& winner : msg.winnerList)
+      hosts[winner] = 1;
+
+    auto& readers = m_buckets[msg.bucketId].readHosts;
+    readers.clear();
+    for (const auto& reader : msg.readerList)
+      readers[reader] = 1;
+  }
+}
+
 void
 Master::declareAuctionWinners()
 {
   std::sort(m_currentAuctionBids.begin(), m_currentAuctionBids.end());
 
-  for (int i = m_currentAuctionBids.size() - 1; i >= 0; i--)
+  const Bucket& bucket = m_buckets[m_currentAuctionBucketId];
+  std::vector<Bid> winners;
+  if (m_currentAuctionForReader)
   {
-    const Bid& bid = m_currentAuctionBids[i];
+    // An extra replica goes to a node that does not serve the bucket yet
+    for (int i = m_currentAuctionBids.size() - 1; i >= 0; i--)
+    {
+      const Bid& bid = m_currentAuctionBids[i];
+      if (!bucket.confirmedHosts.count(bid.bidder) && !bucket.readHosts.count(bid.bidder))
+      {
+        winners.push_back(bid);
+        break;
+      }
+    }
+  }
+  else
+  {
+    winners = placeHosts(m_currentAuctionBids, Bucket::numHosts(m_currentAuctionBucketId));
+  }
 
+  for (const Bid& bid : winners)
+  {
     NDN_LOG_INFO(bid.bidder << " won #" << m_currentAuctionBucketId << " for " << bid.amount);
 
     m_buckets[m_currentAuctionBucketId].pendingHosts[bid.bidder] = 1;
@@ -178,28 +330,208 @@ Master::declareAuctionWinners()
     // Inform the winner
     auto msg = newMsg(AuctionMessage::Type::Win);
     msg.winner = bid.bidder;
-    m_svs->publishData(msg.wireEncode(), ndn::time::milliseconds(1000));
+    m_syncGroup.publish(m_stream, msg.wireEncode(), ndn::time::milliseconds(1000));
+  }
 
-    if (m_buckets[m_currentAuctionBucketId].pendingHosts.size() >= NUM_REPLICA)
+  if (m_buckets[m_currentAuctionBucketId].pendingHosts.size() == 0)
+    endAuction();
+}
+
+std::vector<Master::Bid>
+Master::placeHosts(const std::vector<Bid>& bids, size_t nHosts) const
+{
+  // Only the best bids are weighed, so the search stays small
+  const size_t n = std::min<size_t>(bids.size(), PLACEMENT_CANDIDATES);
+  const std::vector<Bid> candidates(bids.rbegin(), bids.rbegin() + n);
+  nHosts = std::min(nHosts, n);
+
+  std::vector<std::string> domains(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    auto it = m_topology.find(candidates[i].bidder);
+    if (it != m_topology.end())
+      domains[i] = it->second.failureDomain;
+  }
+
+  // Pairs never measured count as the slowest pair that was
+  std::vector<double> rtt(n * n, -1);
+  double slowest = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    for (size_t j = i + 1; j < n; j++)
     {
-      break;
+      rtt[i * n + j] = getRttMs(candidates[i].bidder, candidates[j].bidder);
+      slowest = std::max(slowest, rtt[i * n + j]);
     }
   }
+  for (auto& r : rtt)
+  {
+    if (r < 0)
+      r = slowest;
+  }
 
-  if (m_buckets[m_currentAuctionBucketId].pendingHosts.size() == 0)
-    endAuction();
+  // Score every set of hosts; ties go to the set with the better bids
+  uint32_t bestSet = 0;
+  double bestScore = 0;
+  for (uint32_t set = 0; set < (1u << n); set++)
+  {
+    if (static_cast<size_t>(__builtin_popcount(set)) != nHosts)
+      continue;
+
+    double amount = 0;
+    double worstRtt = 0;
+    std::set<std::string> seen;
+    size_t nShared = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+      if (!(set & (1u << i)))
+        continue;
+
+      amount += candidates[i].amount;
+      for (size_t j = i + 1; j < n; j++)
+      {
+        if (set & (1u << j))
+          worstRtt = std::max(worstRtt, rtt[i * n + j]);
+      }
+
+      // Unlabeled hosts share nothing as far as we know
+      if (!domains[i].empty() && !seen.insert(domains[i]).second)
+        nShared++;
+    }
+
+    const double score = amount - PLACEMENT_RTT_WEIGHT * worstRtt - PLACEMENT_DOMAIN_WEIGHT * nShared;
+    if (bestSet == 0 || score > bestScore)
+    {
+      bestSet = set;
+      bestScore = score;
+    }
+  }
+
+  std::vector<Bid> winners;
+  for (size_t i = 0; i < n; i++)
+  {
+    if (bestSet & (1u << i))
+      winners.push_back(candidates[i]);
+  }
+  return winners;
+}
+
+double
+Master::getRttMs(const ndn::Name& a, const ndn::Name& b) const
+{
+  // Both ends measure; average what was reported
+  double sum = 0;
+  int count = 0;
+  for (const auto& [from, to] : {std::make_pair(a, b), std::make_pair(b, a)})
+  {
+    auto it = m_topology.find(from);
+    if (it == m_topology.end())
+      continue;
+
+    auto rttIt = it->second.rtts.find(to);
+    if (rttIt != it->second.rtts.end())
+    {
+      sum += rttIt->second / 1000.0;
+      count++;
+    }
+  }
+  return count > 0 ? sum / count : -1;
 }
 
 void
 Master::endAuction()
 {
-  auto msg = newMsg(AuctionMessage::Type::AuctionEnd);
-  for (const auto& n : m_buckets[m_currentAuctionBucketId].confirmedHosts)
-    msg.winnerList.push_back(n.first);
-  m_svs->publishData(msg.wireEncode(), ndn::time::milliseconds(1000));
+  publishHosts(m_currentAuctionBucketId);
 
   m_currentAuctionId = 0;
   auction();
 }
 
-} // namespace kua
\ No newline at end of file
+void
+Master::publishHosts(bucket_id_t id)
+{
+  // Versions go on from the last master's, and the epoch orders them after its ones
+  Bucket& bucket = m_buckets[id];
+  bucket.epoch = m_epoch;
+  bucket.version++;
+
+  AuctionMessage msg(AuctionMessage::Type::AuctionEnd, m_currentAuctionId, id);
+  msg.epoch = m_epoch;
+  msg.assignmentVersion = bucket.version;
+  for (const auto& n : bucket.confirmedHosts)
+    msg.winnerList.push_back(n.first);
+  for (const auto& n : bucket.readHosts)
+    msg.readerList.push_back(n.first);
+  m_syncGroup.publish(m_stream, msg.wireEncode(), ndn::time::milliseconds(1000));
+}
+
+void
+Master::processLoad(const ndn::Name& sender, const AuctionMessage& msg)
+{
+  if (msg.bucketId < m_firstBucket || msg.bucketId >= m_endBucket)
+    return;
+
+  m_load[msg.bucketId].rates[sender] = msg.readRate;
+}
+
+void
+Master::checkLoad()
+{
+  for (bucket_id_t id = m_firstBucket; id < m_endBucket; id++)
+  {
+    Bucket& bucket = m_buckets[id];
+    Load& load = m_load[id];
+
+    // Fragments of erasure-coded buckets are not copied whole
+    if (bucket.confirmedHosts.empty() || Bucket::isErasureCoded(id))
+      continue;
+
+    // Reports of nodes that no longer serve the bucket do not count
+    uint64_t total = 0;
+    for (const auto& rate : load.rates)
+      if (bucket.confirmedHosts.count(rate.first) || bucket.readHosts.count(rate.first))
+        total += rate.second;
+
+    const size_t nHosts = bucket.confirmedHosts.size() + bucket.readHosts.size();
+    const bool isHot = total > HOT_BUCKET_READ_RATE * nHosts;
+    // Half the threshold after dropping one, so replicas do not flap
+    const bool isCool = !bucket.readHosts.empty() && total * 2 < HOT_BUCKET_READ_RATE * (nHosts - 1);
+
+    load.hotChecks = isHot ? load.hotChecks + 1 : 0;
+    load.coolChecks = isCool ? load.coolChecks + 1 : 0;
+
+    if (load.hotChecks >= HOT_BUCKET_CHECKS && bucket.readHosts.size() < MAX_READ_REPLICAS &&
+        getBidderList().size() > nHosts)
+    {
+      NDN_LOG_INFO("#" << id << " is hot at " << total << " reads/s, adding a read replica");
+      load.hotChecks = 0;
+      m_currentAuctionForReader = true;
+      auction(id);
+      return;
+    }
+
+    if (load.coolChecks >= COOL_BUCKET_CHECKS)
+    {
+      // Retire the least busy read replica
+      auto retired = bucket.readHosts.begin();
+      for (auto it = bucket.readHosts.begin(); it != bucket.readHosts.end(); it++)
+        if (load.rates[it->first] < load.rates[retired->first])
+          retired = it;
+
+      NDN_LOG_INFO("#" << id << " cooled down to " << total << " reads/s, retiring " << retired->first);
+      load.rates.erase(retired->first);
+      bucket.readHosts.erase(retired);
+      load.coolChecks = 0;
+      publishHosts(id);
+    }
+  }
+}
+
+void
+Master::processTopology(const ndn::Name& sender, const AuctionMessage& msg)
+{
+  NDN_LOG_TRACE("RECV_TOPOLOGY from " << sender << " in " << msg.failureDomain);
+  m_topology[sender] = Topology { msg.failureDomain, msg.rttList };
+}
+
+} // namespace kua
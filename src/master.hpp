@@ -1,9 +1,8 @@
 #pragma once
 
-#include <ndn-svs/svsync.hpp>
-
 #include "config-bundle.hpp"
 #include "node-watcher.hpp"
+#include "sync-group.hpp"
 #include "bucket.hpp"
 #include "auction.hpp"
 
@@ -13,7 +12,22 @@ class Master
 {
 public:
   /** Initialize the bidder with the sync prefix */
-  Master(ConfigBundle& configBundle, NodeWatcher& nodeWatcher);
+  Master(ConfigBundle& configBundle, SyncGroup& syncGroup, NodeWatcher& nodeWatcher);
+
+  /** Get the current bucket assignment table */
+  const std::vector<Bucket>&
+  getBuckets() const
+  {
+    return m_buckets;
+  }
+
+  /** Check if this master holds the lease and runs auctions */
+  bool
+  isActive() const
+  {
+    return m_active;
+  }
+
 private:
   struct Bid
   {
@@ -33,9 +47,25 @@ private:
   void
   initialize();
 
-  /** On SVS update */
+  /** Renew the lease if active, or take over if the active master is gone */
+  void
+  checkLease();
+
+  /** Become the active master with a new epoch */
+  void
+  takeOver();
+
+  /** Stop running auctions after seeing a newer master */
+  void
+  stepDown();
+
+  /** Follow a message from another master */
   void
-  updateCallback(const std::vector<ndn::svs::MissingDataInfo>& missingInfo);
+  processMasterMessage(const ndn::Name& sender, const AuctionMessage& msg);
+
+  /** Get the list of live nodes that bid in this shard */
+  std::vector<ndn::Name>
+  getBidderList();
 
   /** Start a new auction */
   void
@@ -53,30 +83,80 @@ private:
   void
   declareAuctionWinners();
 
+  /**
+   * Pick the hosts of a bucket among the best bids, trading bid amounts for
+   * a low round-trip time between the hosts and for distinct failure domains.
+   * Inserts wait for the slowest replica, so the worst pair counts.
+   * @param bids sorted with the best bid last
+   */
+  std::vector<Bid>
+  placeHosts(const std::vector<Bid>& bids, size_t nHosts) const;
+
+  /** Get the round-trip time between two nodes in ms, or -1 if never measured */
+  double
+  getRttMs(const ndn::Name& a, const ndn::Name& b) const;
+
   /** End the auction with the final message */
   void
   endAuction();
 
+  /** Record the read rate a host reported for a bucket */
+  void
+  processLoad(const ndn::Name& sender, const AuctionMessage& msg);
+
+  /** Record the failure domain and round-trip times a host reported */
+  void
+  processTopology(const ndn::Name& sender, const AuctionMessage& msg);
+
+  /**
+   * Add a read replica to a bucket that stays hot, or retire one from a bucket
+   * that cooled down. Called once a second while no auction runs.
+   */
+  void
+  checkLoad();
+
+  /** Publish the hosts of a bucket */
+  void
+  publishHosts(bucket_id_t id);
+
   /** Create a new auction message */
   inline AuctionMessage
   newMsg(AuctionMessage::Type type)
   {
-    return AuctionMessage(type, m_currentAuctionId, m_currentAuctionBucketId);
+    AuctionMessage msg(type, m_currentAuctionId, m_currentAuctionBucketId);
+    msg.epoch = m_epoch;
+    return msg;
   }
 
 private:
   ConfigBundle& m_configBundle;
-  ndn::Name m_syncPrefix;
+  ndn::Name m_stream;
   ndn::Name m_nodePrefix;
+  shard_id_t m_shard;
+  /** Range of buckets auctioned by this shard */
+  bucket_id_t m_firstBucket;
+  bucket_id_t m_endBucket;
   ndn::Face& m_face;
   ndn::Scheduler m_scheduler;
   ndn::KeyChain& m_keyChain;
+  SyncGroup& m_syncGroup;
   NodeWatcher& m_nodeWatcher;
 
   ndn::random::RandomNumberEngine& m_rng;
 
   bool m_initialized = false;
 
+  /** Whether this master holds the lease */
+  bool m_active = false;
+  /** Highest epoch seen, and the master that holds it */
+  uint64_t m_epoch = 0;
+  ndn::Name m_leader;
+  /** Last lease renewal seen from the leader */
+  ndn::time::steady_clock::time_point m_lastLease;
+
+  ndn::scheduler::ScopedEventId m_initializeEvent;
+  ndn::scheduler::ScopedEventId m_leaseEvent;
+
   /** List of buckets */
   std::vector<Bucket> m_buckets;
 
@@ -93,8 +173,28 @@ private:
   unsigned int m_currentAuctionTime = 0;
   /** Bids for this bucket */
   std::vector<Bid> m_currentAuctionBids;
+  /** Whether the current auction is for one extra read replica */
+  bool m_currentAuctionForReader = false;
 
-  std::unique_ptr<ndn::svs::SVSync> m_svs;
+  /** Read load of a bucket reported by its hosts */
+  struct Load
+  {
+    /** Reads per second by host */
+    std::map<ndn::Name, uint64_t> rates;
+    /** Consecutive checks that found the bucket hot, or cool enough to shrink */
+    unsigned int hotChecks = 0;
+    unsigned int coolChecks = 0;
+  };
+  std::vector<Load> m_load;
+
+  /** Where a host is, as last reported by it */
+  struct Topology
+  {
+    std::string failureDomain;
+    /** Round-trip times in microseconds by peer */
+    std::map<ndn::Name, uint64_t> rtts;
+  };
+  std::map<ndn::Name, Topology> m_topology;
 };
 
 } // namespace kua
\ No newline at end of file
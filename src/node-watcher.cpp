@@ -2,23 +2,36 @@
 
 #include <ndn-cxx/util/logger.hpp>
 
+#include <algorithm>
+
 namespace kua {
 
 NDN_LOG_INIT(kua.nodewatcher);
 
-NodeWatcher::NodeWatcher(ConfigBundle& configBundle)
-  : m_syncPrefix(ndn::Name(configBundle.kuaPrefix).append("sync").append("health"))
+NodeWatcher::NodeWatcher(ConfigBundle& configBundle, SyncGroup& syncGroup)
+  : m_syncGroup(syncGroup)
   , m_nodePrefix(configBundle.nodePrefix)
   , m_face(configBundle.face)
   , m_scheduler(m_face.getIoService())
   , m_keyChain(configBundle.keyChain)
   , m_rng(ndn::random::getRandomNumberEngine())
   , m_retxDist(3000 * 0.9, 3000 * 1.1)
+  , m_isProbing(!configBundle.isMaster)
 {
   NDN_LOG_INFO("Constructing NodeWatcher");
 
-  m_svs = std::make_unique<ndn::svs::SVSync>(
-    m_syncPrefix, m_nodePrefix, m_face, std::bind(&NodeWatcher::updateCallback, this, _1));
+  if (m_isProbing)
+  {
+    m_pingRegistration = m_face.setInterestFilter(
+      ndn::Name(m_nodePrefix).append("ping"),
+      [this] (const auto&, const auto& interest) { onPing(interest); },
+      [] (const ndn::Name& prefix, const std::string& reason) {
+        NDN_LOG_ERROR("Cannot register " << prefix << ": " << reason);
+      });
+  }
+
+  m_updateConnection = m_syncGroup.onNodeUpdate.connect(
+    std::bind(&NodeWatcher::onNodeUpdate, this, _1));
 
   retxHeartbeat();
 }
@@ -26,39 +39,88 @@ NodeWatcher::NodeWatcher(ConfigBundle& configBundle)
 void
 NodeWatcher::retxHeartbeat()
 {
-  NDN_LOG_TRACE("retxHeartbeat");
+  // Any publication of this node tells the others it is alive
+  unsigned int delay = m_retxDist(m_rng);
+  if (ndn::time::steady_clock::now() - m_syncGroup.getLastPublished() >=
+      ndn::time::milliseconds(m_retxDist.min()))
+  {
+    NDN_LOG_TRACE("retxHeartbeat");
 
-  // Send heartbeat
-  ndn::Name dataName(m_nodePrefix);
-  dataName.appendTimestamp();
-  m_svs->publishData(dataName.wireEncode(), ndn::time::milliseconds(1000));
+    ndn::Name dataName(m_nodePrefix);
+    dataName.appendTimestamp();
+    m_syncGroup.publish(ndn::Name(), dataName.wireEncode(), ndn::time::milliseconds(1000));
+  }
+
+  if (m_isProbing)
+    probePeers();
 
   // Schedule next heartbeat
-  unsigned int delay = m_retxDist(m_rng);
   m_scheduler.schedule(ndn::time::milliseconds(delay), [this] { retxHeartbeat(); });
 }
 
 void
-NodeWatcher::updateCallback(const std::vector<ndn::svs::MissingDataInfo>& missingInfo)
+NodeWatcher::onNodeUpdate(const ndn::Name& nodeId)
 {
-  auto now = std::chrono::system_clock::now();
-  for (auto m : missingInfo)
+  m_nodeMap[nodeId] = ndn::time::steady_clock::now();
+}
+
+void
+NodeWatcher::probePeers()
+{
+  std::vector<ndn::Name> peers;
+  for (const auto& node : getNodeList())
+  {
+    if (node != m_nodePrefix && !ndn::Name(MASTER_PREFIX).isPrefixOf(node))
+      peers.push_back(node);
+  }
+
+  for (size_t i = 0; i < std::min<size_t>(RTT_PROBES_PER_HEARTBEAT, peers.size()); i++)
   {
-    NDN_LOG_TRACE("update " << m.nodeId);
-    m_nodeMap[m.nodeId] = now;
+    const ndn::Name peer = peers[m_probeCursor++ % peers.size()];
+
+    ndn::Interest interest(ndn::Name(peer).append("ping").appendTimestamp());
+    interest.setMustBeFresh(true);
+    interest.setInterestLifetime(ndn::time::milliseconds(1000));
+
+    const auto sent = ndn::time::steady_clock::now();
+    m_face.expressInterest(interest,
+      [this, peer, sent] (const auto&, const auto&) {
+        // Smoothed like TCP, so one slow reply does not move replicas around
+        const auto sample = ndn::time::steady_clock::now() - sent;
+        auto it = m_rtts.find(peer);
+        if (it == m_rtts.end())
+          m_rtts[peer] = sample;
+        else
+          it->second = (it->second * 7 + sample) / 8;
+        NDN_LOG_TRACE("RTT to " << peer << " " <<
+                      ndn::time::duration_cast<ndn::time::microseconds>(m_rtts[peer]).count() << "us");
+      },
+      [] (const auto&, const auto&) {},
+      [] (const auto&) {});
   }
 }
 
+void
+NodeWatcher::onPing(const ndn::Interest& interest)
+{
+  ndn::Data data(interest.getName());
+  data.setFreshnessPeriod(ndn::time::milliseconds(0));
+
+  ndn::security::SigningInfo info;
+  info.setSha256Signing();
+  m_keyChain.sign(data, info);
+  m_face.put(data);
+}
+
 std::vector<ndn::Name>
 NodeWatcher::getNodeList()
 {
   std::vector<ndn::Name> list;
-  auto now = std::chrono::system_clock::now();
+  auto now = ndn::time::steady_clock::now();
 
   for (auto const& [name, time] : m_nodeMap)
   {
-    double duration = std::chrono::duration<double, std::milli>(now - time).count();
-    if (duration < EXCLUDE_TIME_MS)
+    if (now - time < ndn::time::milliseconds(EXCLUDE_TIME_MS))
     {
       list.push_back(name);
     }
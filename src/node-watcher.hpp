@@ -1,11 +1,9 @@
 #pragma once
 
 #include <map>
-#include <chrono>
-
-#include <ndn-svs/svsync.hpp>
 
 #include "config-bundle.hpp"
+#include "sync-group.hpp"
 
 #define EXCLUDE_TIME_MS 10000
 
@@ -14,21 +12,34 @@ namespace kua {
 class NodeWatcher
 {
 public:
-  /** Initialize the node watcher with the sync prefix */
-  NodeWatcher(ConfigBundle& configBundle);
+  /** Initialize the node watcher on the sync group */
+  NodeWatcher(ConfigBundle& configBundle, SyncGroup& syncGroup);
 
   /** Get list of nodes with their base prefixes */
   std::vector<ndn::Name> getNodeList();
 
+  /** Get the smoothed round-trip times to the nodes probed so far */
+  const std::map<ndn::Name, ndn::time::nanoseconds>&
+  getRtts() const
+  {
+    return m_rtts;
+  }
+
 private:
-  /** On SVS update */
-  void updateCallback(const std::vector<ndn::svs::MissingDataInfo>& missingInfo);
+  /** On any publication by a node */
+  void onNodeUpdate(const ndn::Name& nodeId);
 
-  /** Transmit and schedule the next heartbeat message */
+  /** Transmit a heartbeat unless something else was published, and schedule the next */
   void retxHeartbeat();
 
+  /** Ping the next few storage nodes in turn to measure round-trip times */
+  void probePeers();
+
+  /** Answer a ping from another node */
+  void onPing(const ndn::Interest& interest);
+
 private:
-  ndn::Name m_syncPrefix;
+  SyncGroup& m_syncGroup;
   ndn::Name m_nodePrefix;
   ndn::Face& m_face;
   ndn::Scheduler m_scheduler;
@@ -37,9 +48,15 @@ private:
   ndn::random::RandomNumberEngine& m_rng;
   std::uniform_int_distribution<> m_retxDist;
 
-  std::map<ndn::Name, std::chrono::_V2::system_clock::time_point> m_nodeMap;
+  std::map<ndn::Name, ndn::time::steady_clock::time_point> m_nodeMap;
+
+  /** Only storage nodes ping each other; they are the ones replicating */
+  bool m_isProbing;
+  ndn::ScopedRegisteredPrefixHandle m_pingRegistration;
+  std::map<ndn::Name, ndn::time::nanoseconds> m_rtts;
+  size_t m_probeCursor = 0;
 
-  std::unique_ptr<ndn::svs::SVSync> m_svs;
+  ndn::util::signal::ScopedConnection m_updateConnection;
 };
 
 } // namespace kua
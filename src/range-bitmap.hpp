@@ -0,0 +1,55 @@
+#pragma once
+
+#include "tlv.hpp"
+
+#include <ndn-cxx/encoding/block-helpers.hpp>
+
+#include <vector>
+
+namespace kua {
+
+/**
+ * Segments of a range INSERT that were stored.
+ *
+ * Replies to range inserts carry one bit per segment of the range, first
+ * segment in the lowest bit of the first byte, so that the inserter can
+ * send again only the segments that are missing. A reply without a bitmap
+ * acknowledges the whole range.
+ */
+class RangeBitmap
+{
+public:
+  /** Make reply content with the bitmap */
+  static inline ndn::Block
+  encode(const std::vector<bool>& stored)
+  {
+    std::vector<uint8_t> bytes((stored.size() + 7) / 8, 0);
+    for (size_t i = 0; i < stored.size(); i++)
+    {
+      if (stored[i])
+        bytes[i / 8] |= 1 << (i % 8);
+    }
+
+    ndn::Block content(ndn::tlv::Content);
+    content.push_back(ndn::encoding::makeBinaryBlock(tlv::RangeBitmap, bytes.data(), bytes.size()));
+    content.encode();
+    return content;
+  }
+
+  /** Read the bitmap of a range of n segments from reply content */
+  static inline std::vector<bool>
+  decode(const ndn::Block& content, size_t n)
+  {
+    content.parse();
+    auto element = content.find(tlv::RangeBitmap);
+    if (element == content.elements_end())
+      return std::vector<bool>(n, true);
+
+    std::vector<bool> stored(n, false);
+    for (size_t i = 0; i < n && i / 8 < element->value_size(); i++)
+      stored[i] = element->value()[i / 8] & (1 << (i % 8));
+    return stored;
+  }
+};
+
+} // namespace kua
@@ -0,0 +1,484 @@
+#include "command-codes.hpp"
+#include "coro.hpp"
+#include "workload-trace.hpp"
+
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+#include <ndn-cxx/util/scheduler.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace kua {
+
+/**
+ * Plays the client requests of workload traces against a cluster.
+ *
+ * Requests are sent at the offsets they were captured at, divided by the
+ * speed, each once and without waiting for earlier ones; retries of the
+ * original clients are requests of their own in the trace. Requests keep
+ * their parameters, such as the put a range insert belongs to. Requests
+ * from other nodes are left out, since the cluster makes its own. Objects
+ * the trace inserts are served from here with filler content, so later
+ * reads of them find data; reads of objects it does not insert before
+ * them are counted apart, as they were likely stored before the capture.
+ *
+ * Both sides are compared by node service time, from the node receiving a
+ * request to its reply: the captured traces give it for the original
+ * run, and traces the nodes capture during the replay give it for the
+ * replay.
+ */
+class Replay
+{
+public:
+  struct Options
+  {
+    /** Prefix the trace was captured under, also used for replay */
+    ndn::Name kuaPrefix = "/kua";
+    /** Multiple of the captured rate to send at */
+    double speed = 1;
+    /** Payload bytes of served segments */
+    size_t segmentSize = 8000;
+  };
+
+  Replay(ndn::Face& face, ndn::KeyChain& keyChain, const Options& options)
+    : m_face(face)
+    , m_keyChain(keyChain)
+    , m_scheduler(face.getIoService())
+    , m_options(options)
+    , m_filler(options.segmentSize, 'k')
+  {
+    m_dataSigning.setSha256Signing();
+    m_interestSigning.setSignedInterestFormat(ndn::security::SignedInterestFormat::V03);
+  }
+
+  /** Add the requests of a trace file, and the service times captured for them */
+  void
+  load(std::istream& is)
+  {
+    const auto records = readTrace(is, m_nDropped);
+    for (const auto& record : records)
+    {
+      if (record.kind == WorkloadTrace::REQUEST && isReplayed(record))
+      {
+        m_stats[opName(record.command)].nRequests++;
+        m_requests.push_back({record.time, record.command, record.bucket, record.flags, record.name,
+                              record.parameters});
+      }
+    }
+    addServiceTimes(records, &Stats::capturedTimes);
+  }
+
+  /** Add the service times of a trace the nodes captured during the replay */
+  void
+  loadReplayed(std::istream& is)
+  {
+    addServiceTimes(readTrace(is, m_nReplayDropped), &Stats::replayedTimes);
+  }
+
+  /** Play all loaded requests and wait for their responses */
+  void
+  run()
+  {
+    // Traces of several nodes interleave
+    std::stable_sort(m_requests.begin(), m_requests.end(),
+                     [] (const Request& a, const Request& b) { return a.time < b.time; });
+
+    m_filter = m_face.setInterestFilter("/", [this] (const auto&, const auto& interest) {
+      onInterest(interest);
+    });
+    registerObjects();
+    m_face.processEvents();
+  }
+
+  void
+  print(std::ostream& os) const
+  {
+    const double traceS = m_requests.empty() ? 0 : (m_requests.back().time - m_requests.front().time) / 1e9;
+    os << "requests=" << m_requests.size()
+       << " trace_s=" << traceS
+       << " speed=" << m_options.speed
+       << " wall_s=" << ndn::time::duration_cast<ndn::time::milliseconds>(m_finished - m_started).count() / 1000.0
+       << " dropped=" << m_nDropped
+       << " replay_dropped=" << m_nReplayDropped
+       << std::endl;
+
+    for (const auto& [op, stats] : m_stats)
+    {
+      os << "op=" << op
+         << " requests=" << stats.nRequests
+         << " failed=" << stats.nFailed
+         << " failed_inserted_before_trace=" << stats.nFailedBeforeTrace;
+      printPercentiles(os, "captured_service_", stats.capturedTimes);
+      printPercentiles(os, "replayed_service_", stats.replayedTimes);
+      os << std::endl;
+    }
+  }
+
+private:
+  struct Request
+  {
+    uint64_t time;
+    uint16_t command;
+    uint32_t bucket;
+    uint8_t flags;
+    ndn::Name name;
+    ndn::Block parameters;
+  };
+
+  struct Stats
+  {
+    size_t nRequests = 0;
+    size_t nFailed = 0;
+    /** Reads of objects the trace does not insert before them */
+    size_t nFailedBeforeTrace = 0;
+    /** From request to reply at the node, in milliseconds, in the capture and in the replay */
+    std::vector<double> capturedTimes;
+    std::vector<double> replayedTimes;
+  };
+
+  /** Read the records of a trace in time order, as threads write them in batches */
+  static std::vector<WorkloadTrace::Record>
+  readTrace(std::istream& is, uint64_t& nDropped)
+  {
+    WorkloadTrace::Reader reader(is);
+    std::vector<WorkloadTrace::Record> records;
+
+    WorkloadTrace::Record record;
+    while (reader.read(record))
+    {
+      if (record.kind == WorkloadTrace::DROPPED)
+        nDropped += record.size;
+      else
+        records.push_back(record);
+    }
+
+    std::stable_sort(records.begin(), records.end(),
+                     [] (const auto& a, const auto& b) { return a.time < b.time; });
+    return records;
+  }
+
+  /** Match replies to the client requests of a trace by name */
+  void
+  addServiceTimes(const std::vector<WorkloadTrace::Record>& records, std::vector<double> Stats::* times)
+  {
+    std::unordered_map<ndn::Name, std::pair<uint64_t, const char*>> pending;
+    for (const auto& record : records)
+    {
+      if (record.kind == WorkloadTrace::REQUEST && isReplayed(record))
+      {
+        // Retries carry the same name; service starts at the first
+        pending.try_emplace(record.name, record.time, opName(record.command));
+      }
+      else if (record.kind == WorkloadTrace::REPLY)
+      {
+        auto it = pending.find(record.name);
+        if (it != pending.end())
+        {
+          (m_stats[it->second.second].*times).push_back((record.time - it->second.first) / 1e6);
+          pending.erase(it);
+        }
+      }
+    }
+  }
+
+  static bool
+  isReplayed(const WorkloadTrace::Record& record)
+  {
+    return (record.flags & WorkloadTrace::FROM_CLIENT) &&
+           (record.command & (CommandCodes::INSERT | CommandCodes::DELETE |
+                              CommandCodes::LIST | CommandCodes::FETCH)) &&
+           !(record.command & (CommandCodes::NO_REPLICATE | CommandCodes::HAS_SOURCE));
+  }
+
+  static const char*
+  opName(uint16_t command)
+  {
+    if (command == CommandCodes::FETCH)
+      return "fetch";
+    if (command & CommandCodes::INSERT)
+      return "insert";
+    if (command & CommandCodes::DELETE)
+      return "delete";
+    return "list";
+  }
+
+  static void
+  printPercentiles(std::ostream& os, const std::string& prefix, std::vector<double> ms)
+  {
+    if (ms.empty())
+      return;
+
+    std::sort(ms.begin(), ms.end());
+    auto at = [&ms] (double p) { return ms[static_cast<size_t>(p * (ms.size() - 1))]; };
+    os << " " << prefix << "p50_ms=" << at(0.5)
+       << " " << prefix << "p90_ms=" << at(0.9)
+       << " " << prefix << "p99_ms=" << at(0.99)
+       << " " << prefix << "max_ms=" << ms.back();
+  }
+
+  /** Register the prefixes of inserted objects, then start playing */
+  void
+  registerObjects()
+  {
+    for (const auto& request : m_requests)
+    {
+      if (request.command == CommandCodes::FETCH || !(request.command & CommandCodes::INSERT))
+        continue;
+
+      const ndn::Name name = commandName(request);
+      if (name.size() <= m_options.kuaPrefix.size() + 1)
+        continue;
+      const ndn::Name dataName(name[m_options.kuaPrefix.size() + 1].blockFromValue());
+      // Requests are in time order, so this keeps the first insert
+      m_objects.try_emplace(dataName.getPrefix((request.command & CommandCodes::IS_RANGE) ? -2 : -1),
+                            request.time);
+    }
+
+    // Descendants sort right after their prefix, so one registration covers them
+    std::vector<ndn::Name> prefixes;
+    for (const auto& object : m_objects)
+    {
+      if (prefixes.empty() || !prefixes.back().isPrefixOf(object.first))
+        prefixes.push_back(object.first);
+    }
+
+    m_nRegistering = prefixes.size();
+    if (m_nRegistering == 0)
+      coro::spawn(play());
+
+    for (const auto& prefix : prefixes)
+    {
+      m_registrations.push_back(m_face.registerPrefix(prefix,
+        [this] (const auto&) {
+          if (--m_nRegistering == 0)
+            coro::spawn(play());
+        },
+        [this] (const auto& failed, const auto& reason) {
+          std::cerr << "Cannot register " << failed << ": " << reason << std::endl;
+          if (--m_nRegistering == 0)
+            coro::spawn(play());
+        }));
+    }
+  }
+
+  /** The command without the digest of the parameters or signature of the captured Interest */
+  static ndn::Name
+  commandName(const Request& request)
+  {
+    const bool hasDigest = !request.name.empty() && request.name[-1].isParametersSha256Digest();
+    return (hasDigest || (request.flags & WorkloadTrace::SIGNED)) ? request.name.getPrefix(-1) : request.name;
+  }
+
+  /** Whether a failed read was of an object not inserted by the trace before it */
+  bool
+  isBeforeTrace(const Request& request) const
+  {
+    if (request.command != CommandCodes::FETCH || request.name.empty())
+      return false;
+
+    auto it = m_objects.find(request.name.getPrefix(-1));
+    return it == m_objects.end() || it->second > request.time;
+  }
+
+  void
+  onInterest(const ndn::Interest& interest)
+  {
+    const ndn::Name& name = interest.getName();
+    if (name.empty() || !m_objects.count(name.getPrefix(-1)))
+      return;
+
+    ndn::Data data(name);
+    data.setContent(m_filler.data(), m_filler.size());
+    m_keyChain.sign(data, m_dataSigning);
+    m_face.put(data);
+  }
+
+  coro::Task<>
+  play()
+  {
+    m_started = ndn::time::steady_clock::now();
+    if (!m_requests.empty())
+    {
+      const uint64_t firstTime = m_requests.front().time;
+      for (const auto& request : m_requests)
+      {
+        const auto due = m_started + ndn::time::nanoseconds(
+          static_cast<int64_t>((request.time - firstTime) / m_options.speed));
+        const auto now = ndn::time::steady_clock::now();
+        if (due > now)
+          co_await coro::sleep(m_scheduler, due - now);
+
+        m_nInFlight++;
+        coro::spawn(send(request));
+      }
+    }
+
+    m_isPlayed = true;
+    finishIfDone();
+  }
+
+  coro::Task<>
+  send(Request request)
+  {
+    ndn::Interest interest(commandName(request));
+    interest.setCanBePrefix(false);
+    if (request.command == CommandCodes::FETCH)
+    {
+      ndn::Name hint(m_options.kuaPrefix);
+      hint.appendNumber(request.bucket);
+      hint.appendNumber(CommandCodes::FETCH);
+      interest.setMustBeFresh(false);
+      interest.setForwardingHint(ndn::DelegationList({{15893, hint }}));
+    }
+    else
+    {
+      interest.setMustBeFresh(true);
+      interest.setInterestLifetime(ndn::time::milliseconds(3000));
+      if (request.parameters.isValid())
+        interest.setApplicationParameters(request.parameters);
+      if (request.flags & WorkloadTrace::SIGNED)
+        m_keyChain.sign(interest, m_interestSigning);
+    }
+
+    auto response = co_await coro::expressInterest(m_face, interest);
+    if (!response)
+    {
+      Stats& stats = m_stats[opName(request.command)];
+      if (isBeforeTrace(request))
+        stats.nFailedBeforeTrace++;
+      else
+        stats.nFailed++;
+    }
+
+    m_nInFlight--;
+    finishIfDone();
+  }
+
+  void
+  finishIfDone()
+  {
+    if (m_isPlayed && m_nInFlight == 0)
+    {
+      m_finished = ndn::time::steady_clock::now();
+      m_face.shutdown();
+    }
+  }
+
+private:
+  ndn::Face& m_face;
+  ndn::KeyChain& m_keyChain;
+  ndn::Scheduler m_scheduler;
+  const Options m_options;
+
+  ndn::security::SigningInfo m_dataSigning;
+  ndn::security::SigningInfo m_interestSigning;
+  const std::vector<uint8_t> m_filler;
+
+  std::vector<Request> m_requests;
+  std::map<std::string, Stats> m_stats;
+  uint64_t m_nDropped = 0;
+  uint64_t m_nReplayDropped = 0;
+
+  /** Objects inserted by the trace, served from here, with the time of their first insert */
+  std::map<ndn::Name, uint64_t> m_objects;
+  ndn::ScopedInterestFilterHandle m_filter;
+  std::vector<ndn::ScopedRegisteredPrefixHandle> m_registrations;
+  size_t m_nRegistering = 0;
+
+  size_t m_nInFlight = 0;
+  bool m_isPlayed = false;
+  ndn::time::steady_clock::time_point m_started;
+  ndn::time::steady_clock::time_point m_finished;
+};
+
+} // namespace kua
+
+static void
+usage()
+{
+  std::cerr << "Usage: kua-replay [-x speed] [-s segment-bytes] [-p kua-prefix] [-c replay-trace]... "
+            << "<trace-file>..." << std::endl;
+  exit(1);
+}
+
+int
+main(int argc, char** argv)
+{
+  kua::Replay::Options options;
+  std::vector<std::string> paths;
+  // Traces the nodes write while the replay runs, read once it is done
+  std::vector<std::string> replayPaths;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string arg(argv[i]);
+    if (arg.size() == 2 && arg[0] == '-' && i + 1 < argc)
+    {
+      const std::string val(argv[++i]);
+      switch (arg[1])
+      {
+        case 'x': options.speed = std::stod(val); break;
+        case 's': options.segmentSize = std::stoul(val); break;
+        case 'p': options.kuaPrefix = ndn::Name(val); break;
+        case 'c': replayPaths.push_back(val); break;
+        default: usage();
+      }
+    }
+    else
+    {
+      paths.push_back(arg);
+    }
+  }
+
+  if (paths.empty() || options.speed <= 0)
+    usage();
+
+  try {
+    ndn::Face face;
+    ndn::KeyChain keyChain;
+    kua::Replay replay(face, keyChain, options);
+
+    for (const auto& path : paths)
+    {
+      std::ifstream file(path, std::ios::binary);
+      if (!file)
+      {
+        std::cerr << "Cannot open " << path << std::endl;
+        return 1;
+      }
+      replay.load(file);
+    }
+
+    replay.run();
+
+    // Let the nodes write out the last replies
+    if (!replayPaths.empty())
+      std::this_thread::sleep_for(std::chrono::milliseconds(2 * WORKLOAD_TRACE_FLUSH_MS));
+
+    for (const auto& path : replayPaths)
+    {
+      std::ifstream file(path, std::ios::binary);
+      if (!file)
+      {
+        std::cerr << "Cannot open " << path << std::endl;
+        return 1;
+      }
+      replay.loadReplayed(file);
+    }
+
+    replay.print(std::cout);
+  }
+  catch (const std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
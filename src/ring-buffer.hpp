@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace kua {
+
+/**
+ * Single producer, single consumer byte ring owned by one thread.
+ * The capacity must be a power of two.
+ */
+template<size_t CAPACITY>
+class RingBuffer
+{
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Capacity must be a power of two");
+
+public:
+  explicit
+  RingBuffer(uint32_t threadId)
+    : threadId(threadId)
+    , m_data(new uint8_t[CAPACITY])
+  {
+  }
+
+  bool
+  push(const uint8_t* data, size_t size)
+  {
+    const uint64_t head = m_head.load(std::memory_order_relaxed);
+    const uint64_t tail = m_tail.load(std::memory_order_acquire);
+    if (head - tail + size > CAPACITY)
+    {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    const size_t offset = head & (CAPACITY - 1);
+    const size_t first = std::min<size_t>(size, CAPACITY - offset);
+    std::memcpy(m_data.get() + offset, data, first);
+    std::memcpy(m_data.get(), data + first, size - first);
+    m_head.store(head + size, std::memory_order_release);
+    return true;
+  }
+
+  /** Move everything written so far to the end of a vector */
+  void
+  drain(std::vector<uint8_t>& out)
+  {
+    const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    const uint64_t head = m_head.load(std::memory_order_acquire);
+    const size_t size = head - tail;
+
+    const size_t offset = tail & (CAPACITY - 1);
+    const size_t first = std::min<size_t>(size, CAPACITY - offset);
+    out.insert(out.end(), m_data.get() + offset, m_data.get() + offset + first);
+    out.insert(out.end(), m_data.get(), m_data.get() + size - first);
+    m_tail.store(head, std::memory_order_release);
+  }
+
+public:
+  const uint32_t threadId;
+  std::atomic<uint64_t> dropped{0};
+  /** Set when the owning thread exits; the writer drains and removes the buffer */
+  std::atomic<bool> isReleased{false};
+  /** Drops already reported, touched by the writer only */
+  uint64_t droppedReported = 0;
+
+private:
+  std::unique_ptr<uint8_t[]> m_data;
+  alignas(64) std::atomic<uint64_t> m_head{0};
+  alignas(64) std::atomic<uint64_t> m_tail{0};
+};
+
+/** Releases the buffer of a thread when it exits; hold it in a thread_local */
+template<typename Buffer>
+struct ThreadBuffer
+{
+  ~ThreadBuffer()
+  {
+    if (buffer)
+      buffer->isReleased.store(true, std::memory_order_release);
+  }
+
+  std::shared_ptr<Buffer> buffer;
+};
+
+} // namespace kua
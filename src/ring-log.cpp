@@ -0,0 +1,285 @@
+#include "ring-log.hpp"
+#include "ring-buffer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#define RING_LOG_HEADER "KUALOG1\n"
+
+namespace kua {
+
+namespace {
+
+using LogBuffer = RingBuffer<RING_LOG_BUFFER_BYTES>;
+
+struct Site
+{
+  int level;
+  const char* module;
+  const char* format;
+};
+
+struct State
+{
+  std::mutex mutex;
+  std::vector<Site> sites;
+  std::vector<std::shared_ptr<LogBuffer>> buffers;
+  uint32_t nThreads = 0;
+
+  /** Writer state, guarded by the mutex */
+  FILE* file = nullptr;
+  size_t nSitesWritten = 0;
+  bool isRunning = false;
+  std::condition_variable wake;
+  std::thread writer;
+};
+
+State&
+state()
+{
+  // Leaked so threads logging during exit never see it destroyed
+  static State* s = new State;
+  return *s;
+}
+
+thread_local ThreadBuffer<LogBuffer> t_buffer;
+
+LogBuffer&
+threadBuffer()
+{
+  if (!t_buffer.buffer)
+  {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    t_buffer.buffer = std::make_shared<LogBuffer>(s.nThreads++);
+    s.buffers.push_back(t_buffer.buffer);
+  }
+  return *t_buffer.buffer;
+}
+
+template<typename T>
+void
+put(std::vector<uint8_t>& out, T value)
+{
+  const auto* p = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), p, p + sizeof(T));
+}
+
+void
+putString(std::vector<uint8_t>& out, const char* str)
+{
+  const uint16_t len = std::strlen(str);
+  put(out, len);
+  out.insert(out.end(), str, str + len);
+}
+
+/**
+ * Write new sites, then the events of each thread. Buffers are drained
+ * before sites are collected, so every event refers to a site written
+ * earlier in the file. Buffers of exited threads are removed once drained.
+ */
+void
+flush(State& s)
+{
+  std::vector<std::shared_ptr<LogBuffer>> buffers;
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    buffers = s.buffers;
+  }
+
+  std::vector<LogBuffer*> released;
+  std::vector<uint8_t> events;
+  std::vector<uint8_t> out;
+  for (const auto& buffer : buffers)
+  {
+    // Checked first, so the drain below sees the last events of the thread
+    if (buffer->isReleased.load(std::memory_order_acquire))
+      released.push_back(buffer.get());
+
+    events.clear();
+    buffer->drain(events);
+    if (!events.empty())
+    {
+      out.push_back('E');
+      put<uint32_t>(out, buffer->threadId);
+      put<uint32_t>(out, events.size());
+      out.insert(out.end(), events.begin(), events.end());
+    }
+
+    const uint64_t dropped = buffer->dropped.load(std::memory_order_relaxed);
+    if (dropped != buffer->droppedReported)
+    {
+      out.push_back('D');
+      put<uint32_t>(out, buffer->threadId);
+      put<uint64_t>(out, dropped - buffer->droppedReported);
+      buffer->droppedReported = dropped;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(s.mutex);
+  s.buffers.erase(std::remove_if(s.buffers.begin(), s.buffers.end(), [&released] (const auto& buffer) {
+                    return std::find(released.begin(), released.end(), buffer.get()) != released.end();
+                  }),
+                  s.buffers.end());
+
+  if (s.file == nullptr)
+    return;
+
+  std::vector<uint8_t> sites;
+  for (; s.nSitesWritten < s.sites.size(); s.nSitesWritten++)
+  {
+    const Site& site = s.sites[s.nSitesWritten];
+    sites.push_back('S');
+    put<uint32_t>(sites, s.nSitesWritten);
+    put<uint8_t>(sites, site.level);
+    putString(sites, site.module);
+    putString(sites, site.format);
+  }
+
+  std::fwrite(sites.data(), 1, sites.size(), s.file);
+  std::fwrite(out.data(), 1, out.size(), s.file);
+  std::fflush(s.file);
+}
+
+} // namespace
+
+std::atomic<int> RingLog::s_level{INT_MAX};
+
+uint32_t
+RingLog::registerSite(int level, const char* module, const char* format)
+{
+  auto& s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  s.sites.push_back({level, module, format});
+  return s.sites.size() - 1;
+}
+
+void
+RingLog::start(const std::string& path, int level)
+{
+  std::string realPath = path;
+  const size_t pid = realPath.find("%p");
+  if (pid != std::string::npos)
+    realPath.replace(pid, 2, std::to_string(::getpid()));
+
+  auto& s = state();
+  std::unique_lock<std::mutex> lock(s.mutex);
+  if (s.isRunning)
+    return;
+
+  s.file = std::fopen(realPath.c_str(), "wb");
+  if (s.file == nullptr)
+    throw std::runtime_error("Cannot open log file " + realPath);
+  std::fputs(RING_LOG_HEADER, s.file);
+
+  s.isRunning = true;
+  s.writer = std::thread([&s] {
+    std::unique_lock<std::mutex> lock(s.mutex);
+    while (s.isRunning)
+    {
+      s.wake.wait_for(lock, std::chrono::milliseconds(RING_LOG_FLUSH_MS));
+      lock.unlock();
+      flush(s);
+      lock.lock();
+    }
+  });
+
+  s_level.store(level, std::memory_order_relaxed);
+}
+
+void
+RingLog::startFromEnvironment()
+{
+  const char* path = std::getenv("KUA_LOG_FILE");
+  if (path == nullptr || *path == '\0')
+    return;
+
+  int level = RING_LOG_DEBUG;
+  if (const char* levelStr = std::getenv("KUA_LOG_LEVEL"))
+  {
+    const std::string str(levelStr);
+    if (str == "TRACE")
+      level = RING_LOG_TRACE;
+    else if (str == "INFO")
+      level = RING_LOG_INFO;
+  }
+
+  start(path, level);
+}
+
+void
+RingLog::stop()
+{
+  auto& s = state();
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.isRunning)
+      return;
+    s.isRunning = false;
+  }
+
+  s_level.store(INT_MAX, std::memory_order_relaxed);
+  s.wake.notify_all();
+  s.writer.join();
+  flush(s);
+
+  std::lock_guard<std::mutex> lock(s.mutex);
+  std::fclose(s.file);
+  s.file = nullptr;
+}
+
+RingLog::Record::Record(uint32_t site)
+  : m_size(sizeof(uint16_t))
+{
+  const uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+
+  std::memcpy(m_buffer + m_size, &site, sizeof(site));
+  m_size += sizeof(site);
+  std::memcpy(m_buffer + m_size, &time, sizeof(time));
+  m_size += sizeof(time);
+}
+
+void
+RingLog::Record::addBytes(ArgType type, const void* data, size_t size)
+{
+  // Strings are cut to fit; a name that does not fit is dropped
+  const size_t room = sizeof(m_buffer) - m_size - 1 - sizeof(uint16_t);
+  if (m_size + 1 + sizeof(uint16_t) > sizeof(m_buffer) || (type == ARG_NAME && size > room))
+    return;
+
+  const uint16_t len = std::min(size, room);
+  m_buffer[m_size++] = type;
+  std::memcpy(m_buffer + m_size, &len, sizeof(len));
+  m_size += sizeof(len);
+  std::memcpy(m_buffer + m_size, data, len);
+  m_size += len;
+}
+
+void
+RingLog::Record::add(const ndn::Name& name)
+{
+  const ndn::Block& block = name.wireEncode();
+  addBytes(ARG_NAME, block.wire(), block.size());
+}
+
+void
+RingLog::Record::commit()
+{
+  const uint16_t size = m_size;
+  std::memcpy(m_buffer, &size, sizeof(size));
+  threadBuffer().push(m_buffer, m_size);
+}
+
+} // namespace kua
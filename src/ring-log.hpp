@@ -0,0 +1,191 @@
+#pragma once
+
+#include <ndn-cxx/name.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#define RING_LOG_TRACE 0
+#define RING_LOG_DEBUG 1
+#define RING_LOG_INFO 2
+
+/** Calls below this level are removed at compile time */
+#ifndef RING_LOG_MIN_LEVEL
+#define RING_LOG_MIN_LEVEL RING_LOG_TRACE
+#endif
+
+#define RING_LOG_RECORD_MAX 1024
+/** Length, site id and timestamp */
+#define RING_LOG_RECORD_HEADER 14
+#define RING_LOG_BUFFER_BYTES (1 << 20)
+#define RING_LOG_FLUSH_MS 100
+
+namespace kua {
+
+/**
+ * Binary logger for request paths.
+ *
+ * A call site registers its level, module and format string once, after
+ * which each call only copies the site id, a timestamp and the raw
+ * arguments into a ring buffer owned by the calling thread. A background
+ * thread drains the buffers into a file, and kua-logdump formats them
+ * offline. A full buffer drops records instead of blocking, and the
+ * drops are counted in the file.
+ *
+ * Logging is off unless KUA_LOG_FILE is set; KUA_LOG_LEVEL picks the
+ * lowest level recorded (TRACE, DEBUG or INFO, default DEBUG).
+ */
+class RingLog
+{
+public:
+  /** Argument types in a record */
+  enum ArgType : uint8_t
+  {
+    ARG_UINT = 1,
+    ARG_INT = 2,
+    ARG_DOUBLE = 3,
+    ARG_STRING = 4,
+    ARG_NAME = 5,
+  };
+
+  static uint32_t
+  registerSite(int level, const char* module, const char* format);
+
+  static inline bool
+  isEnabled(int level)
+  {
+    return level >= s_level.load(std::memory_order_relaxed);
+  }
+
+  /** Start writing to a file; "%p" in the path is replaced by the process id */
+  static void
+  start(const std::string& path, int level);
+
+  static void
+  startFromEnvironment();
+
+  /** Flush everything and stop the writer */
+  static void
+  stop();
+
+  /** Encodes one record on the stack */
+  class Record
+  {
+  public:
+    explicit
+    Record(uint32_t site);
+
+    template<typename T>
+    std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>>
+    add(T value)
+    {
+      if constexpr (std::is_enum_v<T>)
+        add(static_cast<std::underlying_type_t<T>>(value));
+      else if constexpr (std::is_signed_v<T>)
+        addFixed(ARG_INT, static_cast<int64_t>(value));
+      else
+        addFixed(ARG_UINT, static_cast<uint64_t>(value));
+    }
+
+    void
+    add(double value)
+    {
+      addFixed(ARG_DOUBLE, value);
+    }
+
+    void
+    add(std::string_view value)
+    {
+      addBytes(ARG_STRING, value.data(), value.size());
+    }
+
+    void
+    add(const char* value)
+    {
+      add(std::string_view(value));
+    }
+
+    void
+    add(const std::string& value)
+    {
+      add(std::string_view(value));
+    }
+
+    void
+    add(const ndn::Name& name);
+
+    /** Hand the record to the buffer of this thread */
+    void
+    commit();
+
+  private:
+    template<typename T>
+    void
+    addFixed(ArgType type, T value)
+    {
+      if (m_size + 1 + sizeof(T) > sizeof(m_buffer))
+        return;
+      m_buffer[m_size++] = type;
+      std::memcpy(m_buffer + m_size, &value, sizeof(T));
+      m_size += sizeof(T);
+    }
+
+    void
+    addBytes(ArgType type, const void* data, size_t size);
+
+  private:
+    uint8_t m_buffer[RING_LOG_RECORD_MAX];
+    size_t m_size;
+  };
+
+  template<typename... Args>
+  static void
+  write(uint32_t site, const Args&... args)
+  {
+    Record record(site);
+    (record.add(args), ...);
+    record.commit();
+  }
+
+private:
+  /** Lowest level recorded; above all levels while stopped */
+  static std::atomic<int> s_level;
+};
+
+} // namespace kua
+
+/** Name the module of the ring log calls in a file */
+#define RLOG_INIT(name) \
+  namespace { \
+  constexpr const char* ringLogModule = #name; \
+  }
+
+#define RLOG_AT(level, format, ...) \
+  do { \
+    static const uint32_t rlogSite = ::kua::RingLog::registerSite(level, ringLogModule, format); \
+    if (::kua::RingLog::isEnabled(level)) \
+      ::kua::RingLog::write(rlogSite __VA_OPT__(,) __VA_ARGS__); \
+  } while (false)
+
+/** Format strings take {} for each argument */
+#if RING_LOG_MIN_LEVEL <= RING_LOG_TRACE
+#define RLOG_TRACE(format, ...) RLOG_AT(RING_LOG_TRACE, format __VA_OPT__(,) __VA_ARGS__)
+#else
+#define RLOG_TRACE(format, ...) do { } while (false)
+#endif
+
+#if RING_LOG_MIN_LEVEL <= RING_LOG_DEBUG
+#define RLOG_DEBUG(format, ...) RLOG_AT(RING_LOG_DEBUG, format __VA_OPT__(,) __VA_ARGS__)
+#else
+#define RLOG_DEBUG(format, ...) do { } while (false)
+#endif
+
+#if RING_LOG_MIN_LEVEL <= RING_LOG_INFO
+#define RLOG_INFO(format, ...) RLOG_AT(RING_LOG_INFO, format __VA_OPT__(,) __VA_ARGS__)
+#else
+#define RLOG_INFO(format, ...) do { } while (false)
+#endif
@@ -0,0 +1,774 @@
+#include <ndn-cxx/util/dummy-client-face.hpp>
+#include <ndn-cxx/util/time-unit-test-clock.hpp>
+#include <ndn-cxx/util/scheduler.hpp>
+#include <ndn-cxx/util/random.hpp>
+#include <ndn-cxx/mgmt/nfd/control-parameters.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <chrono>
+#include <map>
+#include <set>
+
+#include "config-bundle.hpp"
+#include "sync-group.hpp"
+#include "node-watcher.hpp"
+#include "bidder.hpp"
+#include "master.hpp"
+#include "worker.hpp"
+#include "bucket.hpp"
+#include "command-codes.hpp"
+#include "erasure-code.hpp"
+#include "range-bitmap.hpp"
+#include "chunk-store.hpp"
+
+#define SIM_SEGMENT_SIZE 8000
+#define SIM_INSERT_RANGE_MAX_PACK 50
+
+namespace kua {
+namespace sim {
+
+using ndn::util::DummyClientFace;
+
+/**
+ * Simulated forwarding plane connecting DummyClientFaces.
+ *
+ * Each node has a local forwarder with a FIB built from the prefix
+ * registrations of its faces. Nodes share a single LAN with configurable
+ * latency and loss. Sync prefixes use the multicast strategy, everything
+ * else goes to one random nexthop among the longest prefix match.
+ */
+class SimLink
+{
+public:
+  struct Options
+  {
+    ndn::time::milliseconds latency = ndn::time::milliseconds(5);
+    ndn::time::milliseconds jitter = ndn::time::milliseconds(1);
+    double lossRate = 0;
+  };
+
+  struct Counters
+  {
+    uint64_t nInterests = 0;
+    uint64_t nData = 0;
+    uint64_t nSyncInterests = 0;
+  };
+
+  SimLink(boost::asio::io_service& io, ndn::KeyChain& keyChain,
+          const ndn::Name& syncPrefix, const Options& options)
+    : m_io(io)
+    , m_keyChain(keyChain)
+    , m_syncPrefix(syncPrefix)
+    , m_options(options)
+    , m_scheduler(io)
+    , m_rng(ndn::random::getRandomNumberEngine())
+  {
+    sweepPit();
+  }
+
+  /** Create a face attached to the forwarder of a node */
+  std::shared_ptr<DummyClientFace>
+  addFace(size_t nodeIdx)
+  {
+    auto face = std::make_shared<DummyClientFace>(m_io, m_keyChain, DummyClientFace::Options{false, true});
+    const size_t faceIdx = m_faces.size();
+    m_faces.push_back({ face, nodeIdx });
+
+    if (m_counters.size() <= nodeIdx)
+      m_counters.resize(nodeIdx + 1);
+
+    face->onSendInterest.connect([this, faceIdx] (const ndn::Interest& interest) {
+      onSendInterest(faceIdx, interest);
+    });
+    face->onSendData.connect([this, faceIdx] (const ndn::Data& data) {
+      onSendData(faceIdx, data);
+    });
+
+    return face;
+  }
+
+  const Counters&
+  getCounters(size_t nodeIdx) const
+  {
+    return m_counters.at(nodeIdx);
+  }
+
+private:
+  struct FaceEntry
+  {
+    std::shared_ptr<DummyClientFace> face;
+    size_t nodeIdx;
+  };
+
+  struct PitEntry
+  {
+    size_t downstream;
+    bool canBePrefix;
+    ndn::time::steady_clock::time_point expiry;
+  };
+
+  void
+  onSendInterest(size_t faceIdx, const ndn::Interest& interest)
+  {
+    const ndn::Name& name = interest.getName();
+
+    // Prefix registration builds the FIB; other local traffic is dropped
+    if (ndn::Name("/localhost").isPrefixOf(name))
+    {
+      static const ndn::Name REGISTER_PREFIX("/localhost/nfd/rib/register");
+      if (REGISTER_PREFIX.isPrefixOf(name) && name.size() > REGISTER_PREFIX.size())
+      {
+        ndn::nfd::ControlParameters params(name[REGISTER_PREFIX.size()].blockFromValue());
+        m_fib[params.getName()].push_back(faceIdx);
+      }
+      return;
+    }
+
+    auto& counters = m_counters[m_faces[faceIdx].nodeIdx];
+    counters.nInterests++;
+
+    // Forwarding hint is used for the FIB lookup if present
+    const ndn::Name& lookupName = interest.getForwardingHint().empty()
+                                  ? name : interest.getForwardingHint()[0].name;
+
+    std::vector<size_t> nexthops;
+    for (ssize_t i = lookupName.size(); i >= 0 && nexthops.empty(); i--)
+    {
+      auto it = m_fib.find(lookupName.getPrefix(i));
+      if (it == m_fib.end())
+        continue;
+
+      for (size_t nh : it->second)
+        if (nh != faceIdx)
+          nexthops.push_back(nh);
+    }
+
+    if (nexthops.empty())
+      return;
+
+    if (m_syncPrefix.isPrefixOf(name))
+    {
+      counters.nSyncInterests++;
+    }
+    else
+    {
+      // Best route, ties broken at random
+      std::uniform_int_distribution<size_t> dist(0, nexthops.size() - 1);
+      nexthops = { nexthops[dist(m_rng)] };
+    }
+
+    m_pit[name].push_back({ faceIdx, interest.getCanBePrefix(),
+                            ndn::time::steady_clock::now() + interest.getInterestLifetime() });
+
+    for (size_t nh : nexthops)
+    {
+      auto face = m_faces[nh].face;
+      transmit(faceIdx, nh, [face, interest] { face->receive(interest); });
+    }
+  }
+
+  void
+  onSendData(size_t faceIdx, const ndn::Data& data)
+  {
+    m_counters[m_faces[faceIdx].nodeIdx].nData++;
+
+    const ndn::Name& name = data.getName();
+    const auto now = ndn::time::steady_clock::now();
+
+    for (ssize_t i = name.size(); i > 0; i--)
+    {
+      auto it = m_pit.find(name.getPrefix(i));
+      if (it == m_pit.end())
+        continue;
+
+      auto& entries = it->second;
+      for (auto eIt = entries.begin(); eIt != entries.end();)
+      {
+        if (eIt->expiry < now || eIt->downstream == faceIdx ||
+            (i != static_cast<ssize_t>(name.size()) && !eIt->canBePrefix))
+        {
+          eIt = eIt->expiry < now ? entries.erase(eIt) : eIt + 1;
+          continue;
+        }
+
+        auto face = m_faces[eIt->downstream].face;
+        transmit(faceIdx, eIt->downstream, [face, data] { face->receive(data); });
+        eIt = entries.erase(eIt);
+      }
+
+      if (entries.empty())
+        m_pit.erase(it);
+    }
+  }
+
+  /** Schedule delivery between two faces, applying link delay and loss across nodes */
+  void
+  transmit(size_t from, size_t to, std::function<void()> deliver)
+  {
+    if (m_faces[from].nodeIdx == m_faces[to].nodeIdx)
+    {
+      m_scheduler.schedule(ndn::time::milliseconds(0), std::move(deliver));
+      return;
+    }
+
+    if (m_options.lossRate > 0 && std::bernoulli_distribution(m_options.lossRate)(m_rng))
+      return;
+
+    auto delay = m_options.latency;
+    if (m_options.jitter > ndn::time::milliseconds(0))
+    {
+      std::uniform_int_distribution<int64_t> dist(0, m_options.jitter.count());
+      delay += ndn::time::milliseconds(dist(m_rng));
+    }
+
+    m_scheduler.schedule(delay, std::move(deliver));
+  }
+
+  /** Periodically drop PIT entries that were never satisfied */
+  void
+  sweepPit()
+  {
+    const auto now = ndn::time::steady_clock::now();
+    for (auto it = m_pit.begin(); it != m_pit.end();)
+    {
+      auto& entries = it->second;
+      entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                   [now] (const PitEntry& e) { return e.expiry < now; }),
+                    entries.end());
+      it = entries.empty() ? m_pit.erase(it) : std::next(it);
+    }
+
+    m_scheduler.schedule(ndn::time::milliseconds(1000), [this] { sweepPit(); });
+  }
+
+private:
+  boost::asio::io_service& m_io;
+  ndn::KeyChain& m_keyChain;
+  const ndn::Name m_syncPrefix;
+  const Options m_options;
+  ndn::Scheduler m_scheduler;
+  ndn::random::RandomNumberEngine& m_rng;
+
+  std::vector<FaceEntry> m_faces;
+  std::vector<Counters> m_counters;
+  std::map<ndn::Name, std::vector<size_t>> m_fib;
+  std::map<ndn::Name, std::vector<PitEntry>> m_pit;
+};
+
+/**
+ * A cluster of kua nodes and a master running in one process on virtual time.
+ */
+class Cluster
+{
+public:
+  struct Options
+  {
+    size_t nNodes = 3;
+    SimLink::Options link;
+    ndn::time::seconds timeLimit = ndn::time::seconds(600);
+    size_t nObjects = 10;
+    size_t nSegments = 100;
+    /** Segment payload: text, random or zero */
+    std::string payload = "text";
+    /** Failure domains nodes are spread over in turn; 0 leaves them unlabeled */
+    size_t nDomains = 0;
+  };
+
+  Cluster(const Options& options,
+          std::shared_ptr<ndn::time::UnitTestSteadyClock> steadyClock,
+          std::shared_ptr<ndn::time::UnitTestSystemClock> systemClock,
+          ndn::KeyChain& keyChain)
+    : m_options(options)
+    , m_steadyClock(steadyClock)
+    , m_systemClock(systemClock)
+    , m_keyChain(keyChain)
+    , m_kuaPrefix("/kua")
+    , m_link(m_io, keyChain, ndn::Name(m_kuaPrefix).append("sync"), options.link)
+  {
+    // The first nodes are the masters, one per shard
+    for (size_t i = 0; i < NUM_MASTER_SHARDS + m_options.nNodes; i++)
+    {
+      const bool isMaster = i < NUM_MASTER_SHARDS;
+      ndn::Name prefix = isMaster ? ndn::Name(MASTER_PREFIX).appendNumber(i)
+                                  : ndn::Name("/node").appendNumber(i);
+      addNode(i, prefix, isMaster);
+    }
+
+    m_clientFace = m_link.addFace(m_nodes.size());
+  }
+
+  ~Cluster()
+  {
+    // Components must go before the faces they use, the sync group first
+    // so it cannot call into the others
+    for (auto& node : m_nodes)
+    {
+      node.syncGroup.reset();
+      node.master.reset();
+      node.bidder.reset();
+      node.nodeWatcher.reset();
+    }
+  }
+
+  void
+  run()
+  {
+    const auto wallStart = std::chrono::steady_clock::now();
+    const auto start = ndn::time::steady_clock::now();
+
+    // Phase 1: auctions
+    while (!isConverged() && ndn::time::steady_clock::now() - start < m_options.timeLimit)
+      advanceClocks(ndn::time::milliseconds(10));
+
+    const auto convergence = ndn::time::steady_clock::now() - start;
+    const bool converged = isConverged();
+
+    uint64_t nInterests = 0, nData = 0, nSync = 0, maxPackets = 0;
+    for (size_t i = 0; i < m_nodes.size(); i++)
+    {
+      const auto& c = m_link.getCounters(i);
+      nInterests += c.nInterests;
+      nData += c.nData;
+      nSync += c.nSyncInterests;
+      maxPackets = std::max(maxPackets, c.nInterests + c.nData);
+    }
+
+    std::cout << "nodes=" << m_options.nNodes
+              << " converged=" << (converged ? "yes" : "no")
+              << " convergence_s=" << ndn::time::duration_cast<ndn::time::milliseconds>(convergence).count() / 1000.0
+              << " interests_per_node=" << nInterests / m_nodes.size()
+              << " data_per_node=" << nData / m_nodes.size()
+              << " sync_per_node=" << nSync / m_nodes.size()
+              << " max_packets_node=" << maxPackets;
+    if (m_options.nDomains > 0)
+      std::cout << " spread_buckets=" << countSpreadBuckets() << "/" << NUM_BUCKETS;
+
+    // Phase 2: replication throughput
+    if (converged && m_options.nObjects > 0)
+    {
+      // Let workers register their prefixes
+      for (int i = 0; i < 100; i++)
+        advanceClocks(ndn::time::milliseconds(10));
+
+      measureReplication();
+    }
+
+    const auto wall = std::chrono::steady_clock::now() - wallStart;
+    std::cout << " wall_s=" << std::chrono::duration<double>(wall).count() << std::endl;
+  }
+
+private:
+  struct Node
+  {
+    std::shared_ptr<DummyClientFace> face;
+    std::unique_ptr<ConfigBundle> configBundle;
+    std::unique_ptr<SyncGroup> syncGroup;
+    std::unique_ptr<NodeWatcher> nodeWatcher;
+    std::unique_ptr<Bidder> bidder;
+    std::unique_ptr<Master> master;
+  };
+
+  void
+  addNode(size_t idx, const ndn::Name& prefix, bool isMaster)
+  {
+    Node node;
+    node.face = m_link.addFace(idx);
+    node.configBundle.reset(new ConfigBundle {
+      m_kuaPrefix, prefix, *node.face, m_keyChain, isMaster,
+      [this, idx] { return m_link.addFace(idx); }
+    });
+    node.configBundle->chunks = std::make_shared<ChunkStore>();
+    if (isMaster)
+      node.configBundle->masterShard = idx;
+    else if (m_options.nDomains > 0)
+      node.configBundle->failureDomain = "d" + std::to_string(idx % m_options.nDomains);
+
+    node.syncGroup = std::make_unique<SyncGroup>(*node.configBundle);
+    node.nodeWatcher = std::make_unique<NodeWatcher>(*node.configBundle, *node.syncGroup);
+    node.bidder = std::make_unique<Bidder>(*node.configBundle, *node.syncGroup, *node.nodeWatcher);
+    if (isMaster)
+      node.master = std::make_unique<Master>(*node.configBundle, *node.syncGroup, *node.nodeWatcher);
+
+    m_nodes.push_back(std::move(node));
+  }
+
+  bool
+  isConverged() const
+  {
+    for (shard_id_t s = 0; s < NUM_MASTER_SHARDS; s++)
+      for (const auto& bucket : m_nodes[s].master->getBuckets())
+        if (Bucket::shardFromId(bucket.id) == s &&
+            bucket.confirmedHosts.size() < std::min(Bucket::numHosts(bucket.id), m_options.nNodes))
+          return false;
+    return true;
+  }
+
+  /** Count the buckets whose hosts are all in different failure domains */
+  size_t
+  countSpreadBuckets() const
+  {
+    std::map<ndn::Name, std::string> domains;
+    for (const auto& node : m_nodes)
+      domains[node.configBundle->nodePrefix] = node.configBundle->failureDomain;
+
+    size_t nSpread = 0;
+    for (shard_id_t s = 0; s < NUM_MASTER_SHARDS; s++)
+    {
+      for (const auto& bucket : m_nodes[s].master->getBuckets())
+      {
+        if (Bucket::shardFromId(bucket.id) != s)
+          continue;
+
+        std::set<std::string> seen;
+        for (const auto& host : bucket.confirmedHosts)
+          seen.insert(domains[host.first]);
+        nSpread += seen.size() == bucket.confirmedHosts.size();
+      }
+    }
+    return nSpread;
+  }
+
+  void
+  advanceClocks(ndn::time::nanoseconds tick)
+  {
+    m_steadyClock->advance(tick);
+    m_systemClock->advance(tick);
+    if (m_io.stopped())
+      m_io.restart();
+    m_io.poll();
+  }
+
+  /** Insert objects from a client and time until all replicas acknowledge */
+  void
+  measureReplication()
+  {
+    const ndn::Name objPrefix("/sim/objects");
+    const std::vector<uint8_t> payload = makePayload();
+
+    m_clientFace->setInterestFilter(objPrefix, [this, payload] (const auto&, const auto& interest) {
+      ndn::Data data(interest.getName());
+      data.setFreshnessPeriod(ndn::time::seconds(10));
+      data.setContent(payload.data(), payload.size());
+      ndn::security::SigningInfo info;
+      info.setSha256Signing();
+      m_keyChain.sign(data, info);
+      m_clientFace->put(data);
+    }, nullptr);
+
+    size_t nPending = 0;
+    uint64_t nAcked = 0;
+    const auto start = ndn::time::steady_clock::now();
+
+    for (size_t obj = 0; obj < m_options.nObjects; obj++)
+    {
+      const ndn::Name objName = ndn::Name(objPrefix).appendNumber(obj);
+      for (size_t first = 0, last = 0; first < m_options.nSegments; first = last + 1)
+      {
+        const ndn::Name firstName = ndn::Name(objName).appendSegment(first);
+
+        // Ranges stay within a run, and erasure-coded stripes within a range
+        const size_t pack = Bucket::rangePackSize(Bucket::idFromName(firstName), SIM_INSERT_RANGE_MAX_PACK);
+        const size_t runEnd = (first / SEGMENT_RUN_SIZE + 1) * SEGMENT_RUN_SIZE;
+        last = std::min({first + pack, runEnd, m_options.nSegments}) - 1;
+
+        ndn::Name interestName(m_kuaPrefix);
+        interestName.appendNumber(Bucket::idFromName(firstName));
+        interestName.append(ndn::Name(firstName).appendSegment(last).wireEncode());
+        interestName.appendNumber(CommandCodes::INSERT | CommandCodes::IS_RANGE);
+
+        nPending++;
+        sendInsert(interestName, last - first + 1, nPending, nAcked, 3);
+      }
+    }
+
+    while (nPending > 0 && ndn::time::steady_clock::now() - start < m_options.timeLimit)
+      advanceClocks(ndn::time::milliseconds(1));
+
+    const double secs =
+      ndn::time::duration_cast<ndn::time::microseconds>(ndn::time::steady_clock::now() - start).count() / 1e6;
+
+    std::cout << " replicated_segments=" << nAcked
+              << " replication_s=" << secs
+              << " replication_MBps=" << (secs > 0 ? nAcked * SIM_SEGMENT_SIZE / secs / 1e6 : 0);
+
+    reportStoreStats();
+  }
+
+  std::vector<uint8_t>
+  makePayload()
+  {
+    std::vector<uint8_t> payload(SIM_SEGMENT_SIZE, 0);
+
+    if (m_options.payload == "random")
+    {
+      ndn::random::generateSecureBytes(payload.data(), payload.size());
+    }
+    else if (m_options.payload == "text")
+    {
+      // Log-like JSON lines
+      std::string text;
+      for (size_t i = 0; text.size() < payload.size(); i++)
+        text += "{\"ts\":" + std::to_string(1600000000 + i * 7) + ",\"level\":\"info\",\"seq\":" +
+                std::to_string(i) + ",\"msg\":\"request served\",\"bytes\":" +
+                std::to_string((i * 7919) % 65536) + "}\n";
+      std::copy_n(text.begin(), payload.size(), payload.begin());
+    }
+
+    return payload;
+  }
+
+  /** Aggregate store statistics over all workers */
+  void
+  reportStoreStats()
+  {
+    Store::Stats total;
+    ChunkStore::Stats chunks;
+    for (const auto& node : m_nodes)
+    {
+      for (const auto& bucket : node.bidder->getBuckets())
+      {
+        if (!bucket.second->worker)
+          continue;
+
+        const auto& stats = bucket.second->worker->store->getStats();
+        total.nEntries += stats.nEntries;
+        total.logicalBytes += stats.logicalBytes;
+        total.storedBytes += stats.storedBytes;
+        total.nFilterNegatives += stats.nFilterNegatives;
+        total.nFilterFalsePositives += stats.nFilterFalsePositives;
+      }
+
+      // Chunks are counted once per node, however many buckets share them
+      const auto stats = node.configBundle->chunks->getStats();
+      chunks.nChunks += stats.nChunks;
+      chunks.storedBytes += stats.storedBytes;
+      chunks.nCompressed += stats.nCompressed;
+      chunks.nUncompressed += stats.nUncompressed;
+      chunks.compressNs += stats.compressNs;
+      chunks.decompressNs += stats.decompressNs;
+    }
+
+    const double mb = total.logicalBytes / 1e6;
+    const uint64_t storedBytes = total.storedBytes + chunks.storedBytes;
+    std::cout << " store_entries=" << total.nEntries
+              << " logical_physical_ratio=" << (storedBytes ? double(total.logicalBytes) / storedBytes : 0)
+              << " unique_chunks=" << chunks.nChunks
+              << " compressed_records=" << chunks.nCompressed
+              << " raw_records=" << chunks.nUncompressed
+              << " compress_ms_per_MB=" << (mb > 0 ? chunks.compressNs / 1e6 / mb : 0)
+              << " decompress_ms=" << chunks.decompressNs / 1e6
+              << " filter_negatives=" << total.nFilterNegatives
+              << " filter_false_positives=" << total.nFilterFalsePositives;
+  }
+
+  void
+  sendInsert(const ndn::Name& interestName, uint64_t count,
+             size_t& nPending, uint64_t& nAcked, int retries)
+  {
+    ndn::Interest interest(interestName);
+    interest.setCanBePrefix(false);
+    interest.setMustBeFresh(true);
+    interest.setInterestLifetime(ndn::time::milliseconds(3000));
+
+    ndn::security::SigningInfo info;
+    info.setSha256Signing();
+    info.setSignedInterestFormat(ndn::security::SignedInterestFormat::V03);
+    m_keyChain.sign(interest, info);
+
+    m_clientFace->expressInterest(interest,
+      [count, &nPending, &nAcked] (const auto&, const ndn::Data& data) {
+        nPending--;
+        // Only segments stored at enough replicas count
+        const auto stored = RangeBitmap::decode(data.getContent(), count);
+        nAcked += std::count(stored.begin(), stored.end(), true);
+      },
+      [&nPending] (const auto&, const auto&) {
+        nPending--;
+      },
+      [=, &nPending, &nAcked] (const auto&) {
+        if (retries > 0)
+          sendInsert(interestName, count, nPending, nAcked, retries - 1);
+        else
+          nPending--;
+      });
+  }
+
+private:
+  const Options m_options;
+  std::shared_ptr<ndn::time::UnitTestSteadyClock> m_steadyClock;
+  std::shared_ptr<ndn::time::UnitTestSystemClock> m_systemClock;
+  ndn::KeyChain& m_keyChain;
+  const ndn::Name m_kuaPrefix;
+
+  boost::asio::io_service m_io;
+  SimLink m_link;
+  std::vector<Node> m_nodes;
+  std::shared_ptr<DummyClientFace> m_clientFace;
+};
+
+/**
+ * Throughput of erasure coding against replication, on stripes of segments.
+ * Decoding recovers two lost data fragments of every stripe; replication
+ * copies every segment to NUM_REPLICA stores. Rates are of user data.
+ */
+void
+benchmarkErasureCode(size_t megabytes)
+{
+  const size_t k = EC_DATA_FRAGMENTS;
+  const size_t m = EC_PARITY_FRAGMENTS;
+  const size_t nStripes = std::max<size_t>(1, megabytes * 1000000 / (k * SIM_SEGMENT_SIZE));
+  const double userMB = double(nStripes) * k * SIM_SEGMENT_SIZE / 1e6;
+
+  std::vector<uint8_t> data(nStripes * k * SIM_SEGMENT_SIZE);
+  ndn::random::generateSecureBytes(data.data(), data.size());
+  std::vector<uint8_t> parity(nStripes * m * SIM_SEGMENT_SIZE);
+  std::vector<uint8_t> output(k * SIM_SEGMENT_SIZE);
+
+  auto rate = [userMB] (const auto& start) {
+    const std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+    return userMB / secs.count();
+  };
+
+  std::cout << "ec=" << k << "+" << m
+            << " segment_bytes=" << SIM_SEGMENT_SIZE
+            << " data_MB=" << userMB;
+
+  // Vector kernel against the plain table lookups
+  const auto best = ErasureCode::bestKernel();
+  std::vector<ErasureCode::Kernel> kernels{best};
+  if (best != ErasureCode::Kernel::SCALAR)
+    kernels.push_back(ErasureCode::Kernel::SCALAR);
+
+  for (auto kernel : kernels)
+  {
+    const ErasureCode ec(k, m, kernel);
+    const std::string prefix = kernel == best ? "" : "scalar_";
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t s = 0; s < nStripes; s++)
+    {
+      const uint8_t* members[EC_DATA_FRAGMENTS];
+      uint8_t* parities[EC_PARITY_FRAGMENTS];
+      for (size_t i = 0; i < k; i++)
+        members[i] = &data[(s * k + i) * SIM_SEGMENT_SIZE];
+      for (size_t j = 0; j < m; j++)
+        parities[j] = &parity[(s * m + j) * SIM_SEGMENT_SIZE];
+      ec.encode(members, k, parities, SIM_SEGMENT_SIZE);
+    }
+    std::cout << " " << prefix << "encode_MBps=" << rate(start);
+
+    // Lose the first two data fragments of every stripe
+    bool isCorrect = true;
+    start = std::chrono::steady_clock::now();
+    for (size_t s = 0; s < nStripes; s++)
+    {
+      std::vector<const uint8_t*> fragments(k + m);
+      std::vector<uint8_t*> outputs(k, nullptr);
+      for (size_t i = 0; i < k; i++)
+        fragments[i] = i < m ? nullptr : &data[(s * k + i) * SIM_SEGMENT_SIZE];
+      for (size_t j = 0; j < m; j++)
+        fragments[k + j] = &parity[(s * m + j) * SIM_SEGMENT_SIZE];
+      for (size_t i = 0; i < m && i < k; i++)
+        outputs[i] = &output[i * SIM_SEGMENT_SIZE];
+      isCorrect &= ec.reconstruct(fragments, k, outputs, SIM_SEGMENT_SIZE);
+    }
+    std::cout << " " << prefix << "decode_MBps=" << rate(start);
+
+    // Spot check the last stripe
+    isCorrect &= std::equal(output.begin(), output.begin() + std::min(k, m) * SIM_SEGMENT_SIZE,
+                            data.end() - k * SIM_SEGMENT_SIZE);
+    if (!isCorrect)
+      std::cout << " " << prefix << "decode=FAILED";
+  }
+
+  // Replication copies every segment to each replica
+  std::vector<uint8_t> replicas(NUM_REPLICA * SIM_SEGMENT_SIZE);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t seg = 0; seg < nStripes * k; seg++)
+    for (size_t r = 0; r < NUM_REPLICA; r++)
+      std::memcpy(&replicas[r * SIM_SEGMENT_SIZE], &data[seg * SIM_SEGMENT_SIZE], SIM_SEGMENT_SIZE);
+
+  std::cout << " replicate_MBps=" << rate(start)
+            << " kernel=" << ErasureCode::kernelName(best)
+            << " ec_storage_ratio=" << double(k + m) / k
+            << " replica_storage_ratio=" << NUM_REPLICA
+            << std::endl;
+}
+
+} // namespace sim
+} // namespace kua
+
+static void
+usage()
+{
+  std::cerr << "Usage: kua-sim [-l latency-ms] [-j jitter-ms] [-p loss-rate] [-t time-limit-s]\n"
+            << "               [-o objects] [-s segments] [-c text|random|zero] [-d domains]\n"
+            << "               [-e benchmark-MB]\n"
+            << "               <num-nodes>..." << std::endl;
+  exit(1);
+}
+
+int
+main(int argc, char** argv)
+{
+  kua::sim::Cluster::Options options;
+  std::vector<size_t> clusterSizes;
+  size_t benchmarkMB = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string arg(argv[i]);
+    if (arg.size() == 2 && arg[0] == '-' && i + 1 < argc)
+    {
+      const std::string val(argv[++i]);
+      switch (arg[1])
+      {
+        case 'l': options.link.latency = ndn::time::milliseconds(std::stoi(val)); break;
+        case 'j': options.link.jitter = ndn::time::milliseconds(std::stoi(val)); break;
+        case 'p': options.link.lossRate = std::stod(val); break;
+        case 't': options.timeLimit = ndn::time::seconds(std::stoi(val)); break;
+        case 'o': options.nObjects = std::stoul(val); break;
+        case 's': options.nSegments = std::stoul(val); break;
+        case 'c': options.payload = val; break;
+        case 'd': options.nDomains = std::stoul(val); break;
+        case 'e': benchmarkMB = std::stoul(val); break;
+        default: usage();
+      }
+    }
+    else
+    {
+      clusterSizes.push_back(std::stoul(arg));
+    }
+  }
+
+  if (clusterSizes.empty() && benchmarkMB == 0)
+    usage();
+
+  if (benchmarkMB > 0)
+    kua::sim::benchmarkErasureCode(benchmarkMB);
+
+  // Virtual time for everything in this process
+  auto steadyClock = std::make_shared<ndn::time::UnitTestSteadyClock>();
+  auto systemClock = std::make_shared<ndn::time::UnitTestSystemClock>();
+  ndn::time::setCustomClocks(steadyClock, systemClock);
+
+  ndn::KeyChain keyChain("pib-memory:", "tpm-memory:");
+  keyChain.setDefaultIdentity(keyChain.createIdentity("/kua-sim"));
+
+  try {
+    for (size_t n : clusterSizes)
+    {
+      options.nNodes = n;
+      kua::sim::Cluster cluster(options, steadyClock, systemClock, keyChain);
+      cluster.run();
+    }
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -1,38 +1,327 @@
 #pragma once
 
 #include "store.hpp"
+#include "chunk-store.hpp"
+
+#include <algorithm>
+#include <list>
 #include <map>
 
+#define STORE_MEMORY_CACHE_SIZE 256
+
 namespace kua {
 
+/**
+ * In-memory store.
+ *
+ * Segments are grouped into runs of SEGMENT_RUN_SIZE, matching bucket
+ * placement. Each run keeps an offset table indexed by segment number, so
+ * a lookup is one run lookup plus indexing. Contents go to the
+ * deduplicating chunk store; records keep only the packet bytes around them.
+ */
 class StoreMemory : public Store
 {
 public:
-  StoreMemory(bucket_id_t bucketId) : Store(bucketId) { }
+  StoreMemory(bucket_id_t bucketId, std::shared_ptr<ChunkStore> chunks, Codec codec = Codec::NONE)
+    : Store(bucketId)
+    , m_chunks(std::move(chunks))
+    , m_compressor(codec)
+  { }
 
   inline bool
   put(const ndn::Data& data)
   {
-    std::shared_ptr<const ndn::Data> ptr = std::make_shared<const ndn::Data>(data);
-    m_map[data.getName()] = ptr;
+    const ndn::Name& name = data.getName();
+
+    Run* run = nullptr;
+    if (name.size() >= 1 && name[-1].isSegment())
+    {
+      run = &m_runs[Bucket::runName(name)];
+      if (run->slots.empty())
+        run->slots.resize(SEGMENT_RUN_SIZE);
+    }
+
+    Record record = makeRecord(data);
+    Record& slot = run ? run->slots[name[-1].toSegment() % SEGMENT_RUN_SIZE] : m_map[name];
+    const bool isNew = slot.rawSize == 0;
+
+    if (!isNew)
+    {
+      // The new chunk is already referenced, so an identical one survives
+      release(slot);
+      uncache(name);
+    }
+
+    slot = std::move(record);
+    account(slot, 1);
+
+    m_digestTree.insert(name, data.getFullName()[-1]);
+    if (isNew)
+      filterInsert(name);
     return true;
   }
 
   inline std::shared_ptr<const ndn::Data>
   get(const ndn::Name& dataName)
   {
-    if (m_map.find(dataName) != m_map.end())
+    if (!filterMayContain(dataName))
+      return nullptr;
+
+    const Record* record = find(dataName);
+    if (!record)
     {
-      return m_map.at(dataName);
+      m_stats.nFilterFalsePositives++;
+      return nullptr;
     }
-    else
+
+    if (record->data)
+      return record->data;
+
+    // Recently assembled packets are served from the cache
+    auto cIt = m_cache.find(dataName);
+    if (cIt != m_cache.end())
     {
+      m_lru.splice(m_lru.begin(), m_lru, cIt->second.second);
+      return cIt->second.first;
+    }
+
+    auto content = m_chunks->get(record->chunk);
+    if (!content)
       return nullptr;
+
+    const auto split = record->shell.begin() + record->headSize;
+
+    auto wire = std::make_shared<ndn::Buffer>();
+    wire->reserve(record->rawSize);
+    wire->insert(wire->end(), record->shell.begin(), split);
+    wire->insert(wire->end(), content->begin(), content->end());
+    wire->insert(wire->end(), split, record->shell.end());
+
+    auto data = std::make_shared<const ndn::Data>(ndn::Block(wire));
+    cache(dataName, data);
+    return data;
+  }
+
+  inline bool
+  has(const ndn::Name& dataName)
+  {
+    return filterMayContain(dataName) && find(dataName) != nullptr;
+  }
+
+  inline bool
+  erase(const ndn::Name& name)
+  {
+    if (name.size() >= 1 && name[-1].isSegment())
+    {
+      auto it = m_runs.find(Bucket::runName(name));
+      if (it == m_runs.end())
+        return false;
+
+      Run& run = it->second;
+      Record& slot = run.slots[name[-1].toSegment() % SEGMENT_RUN_SIZE];
+      if (slot.rawSize == 0)
+        return false;
+
+      release(slot);
+      slot = Record();
+
+      // Drop the run once all of its slots are empty
+      if (std::all_of(run.slots.begin(), run.slots.end(),
+                      [] (const Record& r) { return r.rawSize == 0; }))
+        m_runs.erase(it);
+    }
+    else
+    {
+      auto it = m_map.find(name);
+      if (it == m_map.end())
+        return false;
+
+      release(it->second);
+      m_map.erase(it);
+    }
+
+    uncache(name);
+    m_digestTree.erase(name);
+    filterErase(name);
+    return true;
+  }
+
+  void
+  list(const ndn::Name& prefix, const ndn::Name& after,
+       const std::function<bool(const ndn::Name&)>& visit) const
+  {
+    const bool isResuming = !after.empty() && RunOrder::compare(after, prefix) >= 0;
+    const ndn::Name startRun = Bucket::runName(isResuming ? after : prefix);
+
+    // Names that are not segments are their own run names, so both maps are in RunOrder
+    auto mIt = m_map.lower_bound(startRun);
+    auto rIt = m_runs.lower_bound(startRun);
+
+    while (mIt != m_map.end() || rIt != m_runs.end())
+    {
+      if (rIt == m_runs.end() || (mIt != m_map.end() && mIt->first < rIt->first))
+      {
+        const ndn::Name& name = (mIt++)->first;
+        if (isResuming && RunOrder::compare(name, after) <= 0)
+          continue;
+
+        if (!prefix.isPrefixOf(name))
+        {
+          if (isPastPrefix(prefix, name))
+            return;
+          continue;
+        }
+
+        if (!visit(name))
+          return;
+        continue;
+      }
+
+      const auto& run = *(rIt++);
+      if (isPastPrefix(prefix, run.first))
+        return;
+
+      const ndn::Name runPrefix = run.first.getPrefix(-1);
+      const uint64_t firstSeg = run.first[-1].toSegment() * SEGMENT_RUN_SIZE;
+
+      for (size_t i = 0; i < run.second.slots.size(); i++)
+      {
+        if (run.second.slots[i].rawSize == 0)
+          continue;
+
+        ndn::Name name(runPrefix);
+        name.appendSegment(firstSeg + i);
+        if (!prefix.isPrefixOf(name) || (isResuming && RunOrder::compare(name, after) <= 0))
+          continue;
+
+        if (!visit(name))
+          return;
+      }
+    }
+  }
+
+private:
+  struct Record
+  {
+    /** Size of the packet; zero for an empty slot */
+    size_t rawSize = 0;
+    /** Whole packet, if the content is too small for the chunk store */
+    std::shared_ptr<const ndn::Data> data;
+    /** Wire encoding before and after the content value otherwise */
+    ndn::Buffer shell;
+    uint32_t headSize = 0;
+    ChunkStore::Key chunk;
+  };
+
+  struct Run
+  {
+    /** Offset table indexed by segment number within the run */
+    std::vector<Record> slots;
+  };
+
+  inline const Record*
+  find(const ndn::Name& name) const
+  {
+    if (name.size() >= 1 && name[-1].isSegment())
+    {
+      auto it = m_runs.find(Bucket::runName(name));
+      if (it == m_runs.end())
+        return nullptr;
+
+      const Record& slot = it->second.slots[name[-1].toSegment() % SEGMENT_RUN_SIZE];
+      return slot.rawSize > 0 ? &slot : nullptr;
+    }
+
+    auto it = m_map.find(name);
+    return it != m_map.end() && it->second.rawSize > 0 ? &it->second : nullptr;
+  }
+
+  /** Split the wire encoding around the content, which goes to the chunk store */
+  inline Record
+  makeRecord(const ndn::Data& data)
+  {
+    const ndn::Block& wire = data.wireEncode();
+    const ndn::Block& content = data.getContent();
+
+    Record record;
+    record.rawSize = wire.size();
+
+    if (content.value_size() >= ChunkStore::MIN_SIZE &&
+        content.value() >= wire.wire() &&
+        content.value() + content.value_size() <= wire.wire() + wire.size())
+    {
+      const size_t headSize = content.value() - wire.wire();
+      const size_t tailOffset = headSize + content.value_size();
+
+      record.headSize = headSize;
+      record.shell.reserve(wire.size() - content.value_size());
+      record.shell.insert(record.shell.end(), wire.wire(), wire.wire() + headSize);
+      record.shell.insert(record.shell.end(), wire.wire() + tailOffset, wire.wire() + wire.size());
+
+      record.chunk = m_chunks->acquire(content.value(), content.value_size(), m_compressor);
+    }
+    else
+    {
+      record.data = std::make_shared<const ndn::Data>(data);
+    }
+
+    return record;
+  }
+
+  /** Account for a record, except for its chunk which the chunk store tracks */
+  inline void
+  account(const Record& record, int sign)
+  {
+    m_stats.nEntries += sign;
+    m_stats.logicalBytes += sign * record.rawSize;
+    m_stats.storedBytes += sign * (record.data ? record.rawSize : record.shell.size());
+  }
+
+  inline void
+  release(const Record& record)
+  {
+    account(record, -1);
+    if (!record.data)
+      m_chunks->release(record.chunk);
+  }
+
+  inline void
+  cache(const ndn::Name& name, std::shared_ptr<const ndn::Data> data)
+  {
+    m_lru.push_front(name);
+    m_cache[name] = { data, m_lru.begin() };
+
+    if (m_lru.size() > STORE_MEMORY_CACHE_SIZE)
+    {
+      m_cache.erase(m_lru.back());
+      m_lru.pop_back();
     }
   }
 
+  inline void
+  uncache(const ndn::Name& name)
+  {
+    auto it = m_cache.find(name);
+    if (it == m_cache.end())
+      return;
+
+    m_lru.erase(it->second.second);
+    m_cache.erase(it);
+  }
+
 private:
-  std::map<ndn::Name, std::shared_ptr<const ndn::Data>> m_map;
+  /** Names that are not segments */
+  std::map<ndn::Name, Record> m_map;
+  /** Segment runs by run name */
+  std::map<ndn::Name, Run> m_runs;
+  /** Shared by the workers of the node */
+  std::shared_ptr<ChunkStore> m_chunks;
+  Compressor m_compressor;
+
+  /** Assembled packets, most recently used first */
+  std::list<ndn::Name> m_lru;
+  std::map<ndn::Name, std::pair<std::shared_ptr<const ndn::Data>,
+                                std::list<ndn::Name>::iterator>> m_cache;
 };
 
-} // namespace kua
\ No newline at end of file
+} // namespace kua
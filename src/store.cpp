@@ -0,0 +1,215 @@
+#include "store.hpp"
+
+#include <algorithm>
+
+namespace kua {
+
+/** Component of the run name of a name, which has the same length */
+static ndn::name::Component
+runComponent(const ndn::Name& name, size_t i)
+{
+  if (i + 1 == name.size() && name[i].isSegment())
+    return ndn::name::Component::fromSegment(name[i].toSegment() / SEGMENT_RUN_SIZE);
+  return name[i];
+}
+
+int
+RunOrder::compare(const ndn::Name& a, const ndn::Name& b)
+{
+  // Compare run names without building them
+  const size_t n = std::min(a.size(), b.size());
+  for (size_t i = 0; i < n; i++)
+  {
+    const bool isLast = i + 1 == a.size() || i + 1 == b.size();
+    const int c = isLast ? runComponent(a, i).compare(runComponent(b, i)) : a[i].compare(b[i]);
+    if (c != 0)
+      return c;
+  }
+
+  if (a.size() != b.size())
+    return a.size() < b.size() ? -1 : 1;
+
+  return a.compare(b);
+}
+
+bool
+Store::remove(const ndn::Name& dataName)
+{
+  const auto until = ndn::time::steady_clock::now() +
+                     ndn::time::milliseconds(TOMBSTONE_LIFETIME_MS);
+  m_tombstones[dataName] = until;
+  m_tombstoneQueue.emplace_back(until, dataName);
+  m_expiries.erase(dataName);
+  m_writeTimes.erase(dataName);
+  return erase(dataName);
+}
+
+bool
+Store::isSuperseded(const ndn::Name& dataName, uint64_t writeTime,
+                    const ndn::name::Component& implicitDigest) const
+{
+  const DigestTree::Digest* stored = m_digestTree.find(dataName);
+  if (!stored)
+    return false;
+
+  const uint64_t storedTime = getWriteTime(dataName);
+  if (storedTime != writeTime)
+    return storedTime > writeTime;
+
+  return !std::lexicographical_compare(stored->begin(), stored->end(), implicitDigest.value(),
+                                       implicitDigest.value() + implicitDigest.value_size());
+}
+
+void
+Store::filterInsert(const ndn::Name& dataName)
+{
+  if (m_filter.size() < m_filter.capacity())
+    return m_filter.insert(dataName);
+
+  // Rebuild at twice the capacity from the digest tree, which holds every name
+  BloomFilter filter(m_filter.capacity() * 2);
+  for (size_t i = 0; i < DigestTree::NUM_LEAVES; i++)
+  {
+    for (const auto& entry : m_digestTree.getLeaf(i))
+      filter.insert(entry.first);
+  }
+  m_filter = std::move(filter);
+}
+
+uint64_t
+Store::currentTick() const
+{
+  return ndn::time::duration_cast<ndn::time::milliseconds>(
+    ndn::time::steady_clock::now() - m_wheelStart).count() / TTL_TICK_MS;
+}
+
+void
+Store::setTtl(const ndn::Name& dataName, uint64_t ttl)
+{
+  if (ttl == 0)
+  {
+    m_expiries.erase(dataName);
+    return;
+  }
+
+  // Round up so that entries never expire early
+  const uint64_t tick = currentTick() + (ttl + TTL_TICK_MS - 1) / TTL_TICK_MS + 1;
+  m_expiries[dataName] = tick;
+  m_expiryWheel.schedule(tick, dataName);
+}
+
+uint64_t
+Store::getTtl(const ndn::Name& dataName) const
+{
+  auto it = m_expiries.find(dataName);
+  if (it == m_expiries.end())
+    return 0;
+
+  const uint64_t now = currentTick();
+  return it->second > now ? (it->second - now) * TTL_TICK_MS : 1;
+}
+
+size_t
+Store::expire()
+{
+  size_t count = 0;
+  m_expiryWheel.advance(currentTick(), [this, &count] (const ndn::Name& name, uint64_t tick) {
+    auto it = m_expiries.find(name);
+    if (it == m_expiries.end() || it->second != tick)
+      return;
+
+    remove(name);
+    count++;
+  });
+
+  const auto now = ndn::time::steady_clock::now();
+  while (!m_tombstoneQueue.empty() && m_tombstoneQueue.front().first <= now)
+  {
+    auto it = m_tombstones.find(m_tombstoneQueue.front().second);
+    if (it != m_tombstones.end() && it->second <= now)
+      m_tombstones.erase(it);
+    m_tombstoneQueue.pop_front();
+  }
+
+  return count;
+}
+
+namespace coro {
+namespace {
+
+class StoreGetAwaiter : public detail::CallbackAwaiter<std::shared_ptr<const ndn::Data>>
+{
+public:
+  StoreGetAwaiter(Store& store, const ndn::Name& dataName, const CancelToken& token)
+    : CallbackAwaiter(token)
+    , m_store(store)
+    , m_dataName(dataName)
+  { }
+
+protected:
+  void
+  begin(const Pending& pending) final
+  {
+    m_store.asyncGet(m_dataName, [this, pending] (std::shared_ptr<const ndn::Data> data) {
+      if (*pending)
+        complete(std::move(data));
+    });
+  }
+
+  void
+  onCancel() final
+  {
+    // The I/O runs to completion; the result is dropped
+  }
+
+private:
+  Store& m_store;
+  ndn::Name m_dataName;
+};
+
+class StorePutAwaiter : public detail::CallbackAwaiter<bool>
+{
+public:
+  StorePutAwaiter(Store& store, const ndn::Data& data, const CancelToken& token)
+    : CallbackAwaiter(token)
+    , m_store(store)
+    , m_data(data)
+  { }
+
+protected:
+  void
+  begin(const Pending& pending) final
+  {
+    m_store.asyncPut(m_data, [this, pending] (bool ok) {
+      if (*pending)
+        complete(ok);
+    });
+  }
+
+  void
+  onCancel() final
+  {
+  }
+
+private:
+  Store& m_store;
+  ndn::Data m_data;
+};
+
+} // namespace
+
+Task<std::shared_ptr<const ndn::Data>>
+get(Store& store, ndn::Name dataName, CancelToken token)
+{
+  co_return co_await StoreGetAwaiter(store, dataName, token);
+}
+
+Task<bool>
+put(Store& store, ndn::Data data, CancelToken token)
+{
+  co_return co_await StorePutAwaiter(store, data, token);
+}
+
+} // namespace coro
+
+} // namespace kua
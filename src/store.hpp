@@ -1,21 +1,251 @@
 #pragma once
 
 #include <ndn-cxx/data.hpp>
+#include <ndn-cxx/util/time.hpp>
 #include "bucket.hpp"
+#include "digest-tree.hpp"
+#include "timer-wheel.hpp"
+#include "bloom-filter.hpp"
+#include "coro.hpp"
+
+#include <deque>
+#include <functional>
+#include <unordered_map>
+
+#define STORE_FILTER_MIN_CAPACITY 1024
 
 namespace kua {
 
+/**
+ * Order in which stores list their entries: by run name, then by name.
+ * This is the canonical order of names, except that the segments of a
+ * run are kept together, so it does not depend on how a store groups them.
+ */
+struct RunOrder
+{
+  static int
+  compare(const ndn::Name& a, const ndn::Name& b);
+
+  bool
+  operator()(const ndn::Name& a, const ndn::Name& b) const
+  {
+    return compare(a, b) < 0;
+  }
+};
+
 class Store {
+public:
+  struct Stats
+  {
+    uint64_t nEntries = 0;
+    /** Size of the packets as received */
+    uint64_t logicalBytes = 0;
+    /** Size of the packets as held by the store, without contents in the shared chunk store */
+    uint64_t storedBytes = 0;
+
+    /** Lookups answered by the filter without touching the index */
+    uint64_t nFilterNegatives = 0;
+    /** Lookups the filter let through for absent entries */
+    uint64_t nFilterFalsePositives = 0;
+  };
+
+  using GetCallback = std::function<void(std::shared_ptr<const ndn::Data>)>;
+  using PutCallback = std::function<void(bool)>;
+
 public:
   Store(bucket_id_t bucketId) {}
 
+  Store(const Store&) = delete;
+
   virtual bool
   put(const ndn::Data& data) = 0;
 
   virtual std::shared_ptr<const ndn::Data>
   get(const ndn::Name& dataName) = 0;
 
+  /** Check for an entry without reading it */
+  virtual bool
+  has(const ndn::Name& dataName) = 0;
+
+  /** Remove an entry; returns false if it did not exist */
+  virtual bool
+  erase(const ndn::Name& dataName) = 0;
+
+  /**
+   * Visit the names under a prefix in RunOrder, starting after a name or
+   * from the first one if it is empty, until the visitor returns false.
+   * Iteration starts from an index lookup and does not copy the index.
+   */
+  virtual void
+  list(const ndn::Name& prefix, const ndn::Name& after,
+       const std::function<bool(const ndn::Name&)>& visit) const = 0;
+
+  /**
+   * Start a get and call back when it completes.
+   * Stores backed by slow media override this to not block the caller;
+   * the default completes immediately.
+   */
+  virtual void
+  asyncGet(const ndn::Name& dataName, GetCallback callback)
+  {
+    callback(get(dataName));
+  }
+
+  /**
+   * Start a put and call back once it is written, which does not sync it;
+   * inserts are durable through the write-ahead log. The default completes immediately
+   */
+  virtual void
+  asyncPut(const ndn::Data& data, PutCallback callback)
+  {
+    callback(put(data));
+  }
+
   virtual ~Store() = default;
+
+  /** Digest tree over the contents, kept up to date by put */
+  const DigestTree&
+  getDigestTree() const
+  {
+    return m_digestTree;
+  }
+
+  const Stats&
+  getStats() const
+  {
+    return m_stats;
+  }
+
+  /** Expected rate of lookups for absent entries that the filter lets through */
+  double
+  getFilterFalsePositiveRate() const
+  {
+    return m_filter.falsePositiveRate();
+  }
+
+  /**
+   * Remove an entry and keep a tombstone for TOMBSTONE_LIFETIME_MS,
+   * so that anti-entropy does not pull it back from a lagging replica.
+   */
+  bool
+  remove(const ndn::Name& dataName);
+
+  bool
+  isRemoved(const ndn::Name& dataName) const
+  {
+    return m_tombstones.count(dataName) > 0;
+  }
+
+  /** Forget a tombstone when the name is inserted again */
+  void
+  clearTombstone(const ndn::Name& dataName)
+  {
+    m_tombstones.erase(dataName);
+  }
+
+  /** Remove the entry after a TTL in ms; 0 clears the TTL */
+  void
+  setTtl(const ndn::Name& dataName, uint64_t ttl);
+
+  /** Get the remaining TTL of an entry in ms, or 0 if it has none */
+  uint64_t
+  getTtl(const ndn::Name& dataName) const;
+
+  /**
+   * Set when the stored version of an entry was written, in ms since the
+   * epoch as given by the replica that coordinated the write
+   */
+  void
+  setWriteTime(const ndn::Name& dataName, uint64_t writeTime)
+  {
+    m_writeTimes[dataName] = writeTime;
+  }
+
+  /** Get when the stored version was written, or 0 if unknown */
+  uint64_t
+  getWriteTime(const ndn::Name& dataName) const
+  {
+    auto it = m_writeTimes.find(dataName);
+    return it != m_writeTimes.end() ? it->second : 0;
+  }
+
+  /**
+   * Check whether a version of an entry is the stored one or superseded by it.
+   * Later writes win, and the larger digest breaks ties so replicas agree.
+   */
+  bool
+  isSuperseded(const ndn::Name& dataName, uint64_t writeTime, const ndn::name::Component& implicitDigest) const;
+
+  /** Remove entries past their TTL and drop old tombstones; call every TTL_TICK_MS */
+  size_t
+  expire();
+
+protected:
+  /**
+   * True once a listing can stop: no name in RunOrder after one in the
+   * run with this name can be under the prefix.
+   */
+  static bool
+  isPastPrefix(const ndn::Name& prefix, const ndn::Name& runName)
+  {
+    return runName.compare(prefix) > 0 && !prefix.isPrefixOf(runName);
+  }
+
+  /** Add a new entry to the filter, after adding it to the digest tree */
+  void
+  filterInsert(const ndn::Name& dataName);
+
+  void
+  filterErase(const ndn::Name& dataName)
+  {
+    m_filter.erase(dataName);
+  }
+
+  /** False if the entry is definitely absent, which is counted in the stats */
+  bool
+  filterMayContain(const ndn::Name& dataName)
+  {
+    if (m_filter.mayContain(dataName))
+      return true;
+
+    m_stats.nFilterNegatives++;
+    return false;
+  }
+
+protected:
+  DigestTree m_digestTree;
+  Stats m_stats;
+
+private:
+  uint64_t
+  currentTick() const;
+
+private:
+  /** Names in the store, so that lookups for absent ones stop early */
+  BloomFilter m_filter{ STORE_FILTER_MIN_CAPACITY };
+
+  std::unordered_map<ndn::Name, ndn::time::steady_clock::time_point> m_tombstones;
+  /** Tombstones in order of expiry, as all share the same lifetime */
+  std::deque<std::pair<ndn::time::steady_clock::time_point, ndn::Name>> m_tombstoneQueue;
+
+  std::unordered_map<ndn::Name, uint64_t> m_writeTimes;
+
+  /** Expiry tick of entries with a TTL; wheel entries not matching are stale */
+  std::unordered_map<ndn::Name, uint64_t> m_expiries;
+  TimerWheel<ndn::Name> m_expiryWheel;
+  ndn::time::steady_clock::time_point m_wheelStart = ndn::time::steady_clock::now();
 };
 
+namespace coro {
+
+/** Get from a store without blocking the event loop */
+Task<std::shared_ptr<const ndn::Data>>
+get(Store& store, ndn::Name dataName, CancelToken token = CancelToken());
+
+/** Put into a store without blocking the event loop */
+Task<bool>
+put(Store& store, ndn::Data data, CancelToken token = CancelToken());
+
+} // namespace coro
+
 } // namespace kua
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "config-bundle.hpp"
+
+#include <ndn-cxx/name.hpp>
+
+#include <algorithm>
+
+namespace kua {
+
+/**
+ * Layout of erasure-coded stripes.
+ *
+ * A stripe is EC_DATA_FRAGMENTS consecutive segments aligned within their
+ * segment run; any other name is a stripe of its own. Stripes are named
+ * by their first segment, and parity j of a stripe is <stripe>/32=ec/<j>;
+ * the keyword component keeps parity apart from the names of objects.
+ * Fragment f of a stripe goes to host (f + stripe number) of the sorted
+ * hosts, so consecutive stripes rotate over all of them.
+ */
+class Stripe
+{
+public:
+  /** Get the name of the stripe a name belongs to */
+  static inline ndn::Name
+  base(const ndn::Name& name)
+  {
+    if (name.empty() || !name[-1].isSegment())
+      return name;
+
+    const uint64_t seg = name[-1].toSegment();
+    const uint64_t runStart = seg / SEGMENT_RUN_SIZE * SEGMENT_RUN_SIZE;
+    return name.getPrefix(-1).appendSegment(runStart + (seg - runStart) / EC_DATA_FRAGMENTS * EC_DATA_FRAGMENTS);
+  }
+
+  /** Get the position of a name in its stripe */
+  static inline size_t
+  index(const ndn::Name& name)
+  {
+    if (name.empty() || !name[-1].isSegment())
+      return 0;
+
+    const uint64_t seg = name[-1].toSegment();
+    return (seg % SEGMENT_RUN_SIZE) % EC_DATA_FRAGMENTS;
+  }
+
+  /** Get the number of data fragments a stripe can hold; stripes end with their run */
+  static inline size_t
+  width(const ndn::Name& base)
+  {
+    if (base.empty() || !base[-1].isSegment())
+      return 1;
+
+    const uint64_t left = SEGMENT_RUN_SIZE - base[-1].toSegment() % SEGMENT_RUN_SIZE;
+    return std::min<uint64_t>(EC_DATA_FRAGMENTS, left);
+  }
+
+  /** Get the name of a member of a stripe */
+  static inline ndn::Name
+  member(const ndn::Name& base, size_t index)
+  {
+    if (base.empty() || !base[-1].isSegment())
+      return base;
+
+    return base.getPrefix(-1).appendSegment(base[-1].toSegment() + index);
+  }
+
+  static inline ndn::Name
+  parityName(const ndn::Name& base, size_t j)
+  {
+    return ndn::Name(base).append(parityKeyword()).appendNumber(j);
+  }
+
+  static inline bool
+  isParityName(const ndn::Name& name)
+  {
+    return name.size() >= 2 && name[-1].isNumber() && name[-2] == parityKeyword();
+  }
+
+  /** Get the position in the sorted hosts of the host of a fragment, data first */
+  static inline size_t
+  host(const ndn::Name& base, size_t fragment, size_t nHosts)
+  {
+    static std::hash<ndn::Name> hashFunc;
+
+    const uint64_t stripeNo = !base.empty() && base[-1].isSegment()
+                              ? base[-1].toSegment() / EC_DATA_FRAGMENTS
+                              : hashFunc(base);
+    return (fragment + stripeNo) % nHosts;
+  }
+
+private:
+  static inline const ndn::name::Component&
+  parityKeyword()
+  {
+    static const ndn::name::Component keyword(ndn::tlv::KeywordNameComponent,
+                                              reinterpret_cast<const uint8_t*>("ec"), 2);
+    return keyword;
+  }
+};
+
+} // namespace kua
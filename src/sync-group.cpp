@@ -0,0 +1,74 @@
+#include "sync-group.hpp"
+
+#include <ndn-cxx/util/logger.hpp>
+
+namespace kua {
+
+NDN_LOG_INIT(kua.syncgroup);
+
+SyncGroup::SyncGroup(ConfigBundle& configBundle)
+  : m_syncPrefix(ndn::Name(configBundle.kuaPrefix).append("sync"))
+  , m_nodePrefix(configBundle.nodePrefix)
+{
+  NDN_LOG_INFO("Constructing SyncGroup");
+
+  m_svs = std::make_unique<ndn::svs::SVSync>(
+    m_syncPrefix, m_nodePrefix, configBundle.face, std::bind(&SyncGroup::updateCallback, this, _1));
+}
+
+void
+SyncGroup::publish(const ndn::Name& stream, const ndn::Block& content, ndn::time::milliseconds freshness)
+{
+  ndn::Name id(m_nodePrefix);
+  if (!stream.empty())
+    id.append(m_syncPrefix).append(stream);
+
+  m_svs->publishData(content, freshness, id);
+  m_lastPublished = ndn::time::steady_clock::now();
+}
+
+void
+SyncGroup::subscribe(const ndn::Name& stream, const NodeFilter& filter, const MessageCallback& callback)
+{
+  m_subscriptions.emplace(stream, Subscription{filter, callback});
+}
+
+std::pair<ndn::Name, ndn::Name>
+SyncGroup::parseId(const ndn::Name& id) const
+{
+  const size_t n = m_syncPrefix.size();
+  for (size_t i = 0; i + n <= id.size(); i++)
+  {
+    if (id.getSubName(i, n) == m_syncPrefix)
+      return {id.getPrefix(i), id.getSubName(i + n)};
+  }
+  return {id, ndn::Name()};
+}
+
+void
+SyncGroup::updateCallback(const std::vector<ndn::svs::MissingDataInfo>& missingInfo)
+{
+  for (const auto& m : missingInfo)
+  {
+    const auto [node, stream] = parseId(m.nodeId);
+    NDN_LOG_TRACE("update " << node << " on " << stream);
+    onNodeUpdate(node);
+
+    const auto range = m_subscriptions.equal_range(stream);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (it->second.filter && !it->second.filter(node))
+        continue;
+
+      auto callback = it->second.callback;
+      for (ndn::svs::SeqNo i = m.low; i <= m.high; i++)
+      {
+        m_svs->fetchData(m.nodeId, i, [callback, node = node] (const ndn::Data& data) {
+          callback(node, data);
+        }, 10);
+      }
+    }
+  }
+}
+
+} // namespace kua
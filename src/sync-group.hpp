@@ -0,0 +1,75 @@
+#pragma once
+
+#include <ndn-svs/svsync.hpp>
+#include <ndn-cxx/util/signal.hpp>
+
+#include <map>
+
+#include "config-bundle.hpp"
+
+namespace kua {
+
+/**
+ * The one sync group of a node, at /<kua>/sync.
+ *
+ * Health and auction traffic are streams of the same group, so a single
+ * state vector and a single sync Interest timer cover all of them. Each
+ * stream is published under its own ID, <node>/<sync prefix>/<stream>,
+ * which lies under the data prefix of the node and lets receivers tell
+ * streams apart from the state vector alone; publications on streams
+ * nobody subscribed to are never fetched. Bare node IDs carry heartbeats.
+ */
+class SyncGroup
+{
+public:
+  using MessageCallback = std::function<void(const ndn::Name& node, const ndn::Data& data)>;
+  using NodeFilter = std::function<bool(const ndn::Name& node)>;
+
+  SyncGroup(ConfigBundle& configBundle);
+
+  /** Publish on a stream; an empty stream publishes under the node prefix */
+  void
+  publish(const ndn::Name& stream, const ndn::Block& content, ndn::time::milliseconds freshness);
+
+  /** Fetch publications on a stream from the nodes the filter accepts, or all if null */
+  void
+  subscribe(const ndn::Name& stream, const NodeFilter& filter, const MessageCallback& callback);
+
+  /** Time of the last publication of this node, on any stream */
+  ndn::time::steady_clock::time_point
+  getLastPublished() const
+  {
+    return m_lastPublished;
+  }
+
+public:
+  /** Signals a publication by another node, on any stream */
+  ndn::util::Signal<SyncGroup, ndn::Name> onNodeUpdate;
+
+private:
+  /** On SVS update */
+  void
+  updateCallback(const std::vector<ndn::svs::MissingDataInfo>& missingInfo);
+
+  /** Split a stream ID into the node and the stream */
+  std::pair<ndn::Name, ndn::Name>
+  parseId(const ndn::Name& id) const;
+
+private:
+  struct Subscription
+  {
+    NodeFilter filter;
+    MessageCallback callback;
+  };
+
+private:
+  ndn::Name m_syncPrefix;
+  ndn::Name m_nodePrefix;
+  ndn::time::steady_clock::time_point m_lastPublished;
+
+  std::multimap<ndn::Name, Subscription> m_subscriptions;
+
+  std::unique_ptr<ndn::svs::SVSync> m_svs;
+};
+
+} // namespace kua
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace kua {
+
+/**
+ * Hierarchical timer wheel.
+ *
+ * Entries are scheduled at an absolute tick. Each level has SLOTS slots
+ * covering SLOTS times the span of the level below; when the lowest level
+ * wraps, the next slot of the level above is cascaded down. Scheduling is
+ * O(1) and advancing one tick only touches the entries due or cascaded,
+ * so cost does not grow with the number of pending entries.
+ * Entries are never cancelled; owners check on expiry if still current.
+ */
+template<typename T>
+class TimerWheel
+{
+public:
+  static constexpr size_t SLOT_BITS = 8;
+  static constexpr size_t SLOTS = 1 << SLOT_BITS;
+  static constexpr size_t LEVELS = 4;
+
+  explicit
+  TimerWheel(uint64_t now = 0)
+    : m_now(now)
+  { }
+
+  /** Schedule an entry; ticks in the past fire on the next advance */
+  void
+  schedule(uint64_t tick, T value)
+  {
+    place(Entry{ tick, std::move(value) });
+    m_size++;
+  }
+
+  /**
+   * Advance to a tick, calling back with each entry due and its tick.
+   * Callbacks may schedule new entries.
+   */
+  template<typename Callback>
+  void
+  advance(uint64_t tick, Callback&& onExpire)
+  {
+    while (m_now < tick)
+    {
+      m_now++;
+
+      // Cascade upper levels whose slot changed
+      for (size_t level = 1; level < LEVELS; level++)
+      {
+        if (index(m_now, level - 1) != 0)
+          break;
+        cascade(level, index(m_now, level));
+      }
+
+      auto due = std::move(m_wheels[0][index(m_now, 0)]);
+      m_wheels[0][index(m_now, 0)].clear();
+
+      for (auto& entry : due)
+      {
+        if (entry.tick > m_now)
+        {
+          // Clamped beyond the range of the wheel
+          place(std::move(entry));
+          continue;
+        }
+
+        m_size--;
+        onExpire(entry.value, entry.tick);
+      }
+    }
+  }
+
+  uint64_t
+  now() const
+  {
+    return m_now;
+  }
+
+  size_t
+  size() const
+  {
+    return m_size;
+  }
+
+private:
+  struct Entry
+  {
+    uint64_t tick;
+    T value;
+  };
+
+  static size_t
+  index(uint64_t tick, size_t level)
+  {
+    return (tick >> (level * SLOT_BITS)) & (SLOTS - 1);
+  }
+
+  void
+  place(Entry&& entry)
+  {
+    // Due entries go to the next slot
+    const uint64_t tick = std::max(entry.tick, m_now + 1);
+    const uint64_t delta = tick - m_now;
+
+    for (size_t level = 0; level < LEVELS; level++)
+    {
+      if (delta < (uint64_t(1) << ((level + 1) * SLOT_BITS)))
+      {
+        m_wheels[level][index(tick, level)].push_back(std::move(entry));
+        return;
+      }
+    }
+
+    // Beyond the top level; park in the slot furthest away
+    const size_t top = LEVELS - 1;
+    m_wheels[top][(index(m_now, top) + SLOTS - 1) & (SLOTS - 1)].push_back(std::move(entry));
+  }
+
+  void
+  cascade(size_t level, size_t slot)
+  {
+    auto entries = std::move(m_wheels[level][slot]);
+    m_wheels[level][slot].clear();
+
+    for (auto& entry : entries)
+      place(std::move(entry));
+  }
+
+private:
+  uint64_t m_now;
+  size_t m_size = 0;
+  std::array<std::array<std::vector<Entry>, SLOTS>, LEVELS> m_wheels;
+};
+
+} // namespace kua
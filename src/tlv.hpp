@@ -10,7 +10,26 @@ enum {
   AuctionBidAmount = 224,
   AuctionWinner = 225,
   AuctionWinnerList = 226,
+  AuctionEpoch = 227,
+  AuctionReadRate = 228,
+  AuctionReaderList = 229,
+  AuctionFailureDomain = 230,
+  AuctionRttList = 231,
+  AuctionAssignmentVersion = 232,
   BucketId = 240,
+  EntryTtl = 241,
+  ListResumeToken = 242,
+  StripeMemberSize = 243,
+  StripeParity = 244,
+  RangeBitmap = 245,
+  InsertId = 246,
+  CheckpointEntry = 247,
+  CheckpointExpiry = 248,
+  CheckpointTombstone = 249,
+  CheckpointCompressed = 250,
+  CheckpointCodec = 251,
+  CheckpointRawSize = 252,
+  EntryWriteTime = 253,
 };
 
 } // namespace tlv
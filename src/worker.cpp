@@ -1,165 +1,530 @@
 #include "worker.hpp"
 #include "store-memory.hpp"
 #include "command-codes.hpp"
+#include "checkpoint.hpp"
+#include "batch-transport.hpp"
+#include "stripe.hpp"
+#include "range-bitmap.hpp"
+#include "ring-log.hpp"
+#include "tlv.hpp"
 
 #include <ndn-cxx/util/logger.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <set>
 #include <thread>
 
+#define LIST_PAGE_BYTES 4096
+#define EC_FETCH_TIMEOUT_MS 1000
+/** Time a range insert leaves for its reply to reach the inserter */
+#define RANGE_REPLY_MARGIN_MS 500
+/** Time a put has to retry a range before its progress is forgotten */
+#define RANGE_PROGRESS_MS 60000
+
 namespace kua {
 
 NDN_LOG_INIT(kua.worker);
+RLOG_INIT(kua.worker)
+
+namespace {
+
+/** Forwarding hint to reach the worker of a bucket on one node */
+ndn::DelegationList
+fetchHint(const ndn::Name& node, bucket_id_t bucketId)
+{
+  ndn::Name hint(node);
+  hint.appendNumber(bucketId);
+  hint.appendNumber(CommandCodes::FETCH);
+  return ndn::DelegationList({{15893, hint}});
+}
+
+/** Wall clock time in ms, which orders versions of an entry across replicas */
+uint64_t
+writeTimeNow()
+{
+  return ndn::time::toUnixTimestamp(ndn::time::system_clock::now()).count();
+}
+
+/** Number in the parameters of a command, such as its put or write time; 0 if absent */
+uint64_t
+readParameter(const ndn::Interest& request, uint32_t type)
+{
+  if (!request.hasApplicationParameters())
+    return 0;
+
+  try {
+    const ndn::Block& params = request.getApplicationParameters();
+    params.parse();
+    auto it = params.find(type);
+    return it == params.elements_end() ? 0 : ndn::encoding::readNonNegativeInteger(*it);
+  }
+  catch (const ndn::tlv::Error&) {
+    return 0;
+  }
+}
+
+/** Time to work on a range insert before replying with what is stored */
+ndn::time::milliseconds
+rangeBudget(const ndn::Interest& request)
+{
+  const auto lifetime = request.getInterestLifetime();
+  return std::max<ndn::time::milliseconds>(lifetime - ndn::time::milliseconds(RANGE_REPLY_MARGIN_MS),
+                                           lifetime / 2);
+}
+
+/** Parse the wire sizes of the members of a stripe and the parity bytes */
+bool
+decodeParity(const ndn::Data& data, std::vector<size_t>& sizes, const uint8_t*& parity, size_t& len)
+{
+  try {
+    const ndn::Block& content = data.getContent();
+    content.parse();
+
+    sizes.clear();
+    parity = nullptr;
+    for (const auto& element : content.elements())
+    {
+      if (element.type() == tlv::StripeMemberSize)
+        sizes.push_back(ndn::encoding::readNonNegativeInteger(element));
+      else if (element.type() == tlv::StripeParity)
+      {
+        parity = element.value();
+        len = element.value_size();
+      }
+    }
+    return parity != nullptr && !sizes.empty() && sizes.size() <= EC_DATA_FRAGMENTS;
+  }
+  catch (const ndn::tlv::Error&) {
+    return false;
+  }
+}
 
-Worker::Worker(ConfigBundle& configBundle, const Bucket& bucket)
+} // namespace
+
+Worker::Worker(ConfigBundle& configBundle, const Bucket& bucket, Dispatcher& dispatcher)
   : m_configBundle(configBundle)
-  , m_bucket(bucket)
+  , m_bucket(bucket.id)
+  , m_dispatcher(dispatcher)
   , m_nodePrefix(configBundle.nodePrefix)
+  , m_facePtr(configBundle.workerFaceFactory ? configBundle.workerFaceFactory()
+                                             : makeFace())
+  , m_face(*m_facePtr)
   , m_scheduler(m_face.getIoService())
   , m_keyChain(configBundle.keyChain)
-  , m_bucketPrefix(ndn::Name(configBundle.kuaPrefix).appendNumber(bucket.id))
-  , m_bucketNodePrefix(ndn::Name(m_nodePrefix).appendNumber(bucket.id))
+  , m_wal(configBundle.wal)
 {
   NDN_LOG_INFO("Constructing worker for #" << bucket.id << " " << m_nodePrefix);
 
-  // Make NLSR controller
-  nlsr = std::make_shared<NLSR>(m_keyChain, m_face);
+  m_bucket.confirmedHosts = bucket.confirmedHosts;
+  m_bucket.readHosts = bucket.readHosts;
 
   // Make data store
-  this->store = std::make_shared<StoreMemory>(bucket.id);
+  this->store = std::make_shared<StoreMemory>(bucket.id,
+                                              configBundle.chunks ? configBundle.chunks
+                                                                  : std::make_shared<ChunkStore>(),
+                                              STORE_COMPRESSION ? Codec::AUTO : Codec::NONE);
 
-  // Get all interests
-  m_face.setInterestFilter("/", std::bind(&Worker::onInterest, this, _1, _2));
+  // Warm restart from the last checkpoint
+  if (!configBundle.stateDir.empty())
+  {
+    m_checkpointPath = Checkpoint::storePath(configBundle.stateDir, bucket.id);
+    size_t count = Checkpoint::loadStore(m_checkpointPath, *store);
+    NDN_LOG_INFO("Loaded " << count << " entries for #" << bucket.id << " from checkpoint");
+  }
+
+  // Inserts acknowledged after the checkpoint, which is built from the log
+  if (m_wal && !m_checkpointPath.empty())
+  {
+    size_t count = m_wal->replay(bucket.id, *store);
+    NDN_LOG_INFO("Replayed " << count << " log records for #" << bucket.id);
 
-  // Register for unique node
+    // Not in the checkpoint yet if the last run stopped before merging them
+    m_loggedBytes = count;
+    m_checkpointEvent = m_scheduler.schedule(ndn::time::milliseconds(CHECKPOINT_INTERVAL_MS),
+                                             [this] { checkpoint(); });
+  }
+
+  // Reclaim entries past their TTL
+  m_expiryEvent = m_scheduler.schedule(ndn::time::milliseconds(TTL_TICK_MS), [this] { expire(); });
+
+  if (Bucket::isErasureCoded(bucket.id))
+  {
+    // Hosts hold different fragments, so there is nothing to compare or pull
+    m_erasureCode = std::make_unique<ErasureCode>(EC_DATA_FRAGMENTS, EC_PARITY_FRAGMENTS);
+    m_dispatcher.announce(m_bucket.id);
+  }
+  else
+  {
+    // Repair divergence from other replicas
+    m_antiEntropy = std::make_unique<AntiEntropy>(configBundle, m_bucket, m_face, dispatcher, store,
+      [this] (const ndn::Data& data, uint64_t ttl, uint64_t writeTime, std::function<void(bool)> done) {
+        coro::spawn(repair(data, ttl, writeTime, std::move(done)));
+      });
 
-  m_face.registerPrefix(m_bucketNodePrefix,
-                        [this] (const auto&) {
-                          nlsr->advertise(m_bucketNodePrefix);
-                        },
-                        std::bind(&Worker::onRegisterFailed, this, _1, _2));
+    // Pull existing data from other replicas before serving reads
+    m_face.getIoService().post([this] {
+      m_antiEntropy->bootstrap([this] { m_dispatcher.announce(m_bucket.id); });
+    });
+  }
 
-  // Register for bucket
-  m_face.registerPrefix(m_bucketPrefix,
-                        [this] (const auto&) {
-                          nlsr->advertise(m_bucketPrefix);
-                        },
-                        std::bind(&Worker::onRegisterFailed, this, _1, _2));
+  // Injected faces are driven by the owner of the io_service
+  if (configBundle.workerFaceFactory)
+    return;
 
-  std::thread thread(std::bind(&Worker::run, this));
-  thread.detach();
+  m_thread = std::thread(std::bind(&Worker::run, this));
 }
 
 Worker::~Worker() {
-  m_face.shutdown();
+  if (!m_thread.joinable())
+  {
+    m_cancel.cancel();
+    m_face.shutdown();
+  }
+  else
+  {
+    m_face.getIoService().post([this] {
+      m_cancel.cancel();
+      m_face.shutdown();
+      m_face.getIoService().stop();
+    });
+    m_thread.join();
+  }
+
+  // Log callbacks must not outlive the io_service
+  if (m_checkpointThread.joinable())
+    m_checkpointThread.join();
+  if (m_wal)
+    m_wal->release(m_bucket.id);
+
+  // Stores may hold I/O objects of the io_service of the face
+  m_antiEntropy.reset();
+  store.reset();
 }
 
 void
 Worker::run()
 {
-  m_face.processEvents();
+  // Keep running while idle; requests arrive through the dispatcher
+  m_face.processEvents(ndn::time::milliseconds::zero(), true);
 }
 
 void
-Worker::onRegisterFailed(const ndn::Name& prefix, const std::string& reason)
+Worker::checkpoint()
 {
-  NDN_LOG_ERROR("ERROR: Failed to register prefix '" << prefix
-             << "' with the local forwarder (" << reason << ")");
+  m_checkpointEvent = m_scheduler.schedule(ndn::time::milliseconds(CHECKPOINT_INTERVAL_MS),
+                                           [this] { checkpoint(); });
 
-  if (m_failedRegistrations >= 50) {
-    NDN_LOG_ERROR("FATAL: Too many failures to register prefix '" << prefix
-             << "' with the local forwarder (" << reason << ")");
-    m_face.shutdown();
+  if (m_loggedBytes > 0 && !m_isCheckpointing)
+    coro::spawn(saveCheckpoint());
+}
+
+void
+Worker::onLogged(size_t size)
+{
+  m_loggedBytes += size;
+  if (m_checkpointPath.empty() || m_isCheckpointing)
     return;
-  }
 
-  m_scheduler.schedule(ndn::time::milliseconds(300), [this, prefix] {
-    m_face.registerPrefix(prefix,
-                          nullptr, // RegisterPrefixSuccessCallback is optional
-                          std::bind(&Worker::onRegisterFailed, this, _1, _2));
+  const uint64_t threshold = std::max<uint64_t>(CHECKPOINT_MIN_LOG_BYTES,
+                                                store->getStats().logicalBytes / CHECKPOINT_LOG_FRACTION);
+  if (m_loggedBytes >= threshold)
+    coro::spawn(saveCheckpoint());
+}
+
+coro::Task<>
+Worker::saveCheckpoint()
+{
+  // Records this worker has seen committed are below the committed position
+  const uint64_t position = m_wal->committedPosition();
+  const uint64_t loggedBytes = m_loggedBytes;
+
+  m_isCheckpointing = true;
+  bool isSaved = co_await coro::mergeLog(m_checkpointThread, m_face.getIoService(), m_checkpointPath,
+                                         *m_wal, m_bucket.id, m_checkpointPosition, position, m_cancel);
+  m_isCheckpointing = false;
+  if (!isSaved)
+    co_return;
+
+  // Log records are dropped only once the checkpoint is on disk
+  m_loggedBytes -= std::min(loggedBytes, m_loggedBytes);
+  m_checkpointPosition = position;
+  m_wal->checkpointed(m_bucket.id, position);
+  NDN_LOG_DEBUG("#" << m_bucket.id << " : CHECKPOINT : up to " << position);
+}
+
+void
+Worker::expire()
+{
+  m_expiryEvent = m_scheduler.schedule(ndn::time::milliseconds(TTL_TICK_MS), [this] { expire(); });
+
+  if (size_t count = store->expire())
+    NDN_LOG_DEBUG("#" << m_bucket.id << " : EXPIRED : " << count << " entries");
+
+  m_rangeProgressWheel.advance(rangeProgressTick(), [this] (const RangeKey& key, uint64_t tick) {
+    auto it = m_rangeProgress.find(key);
+    if (it != m_rangeProgress.end() && it->second.expiry == tick)
+      m_rangeProgress.erase(it);
   });
+}
 
-  m_failedRegistrations += 1;
+uint64_t
+Worker::rangeProgressTick() const
+{
+  return ndn::time::duration_cast<ndn::time::milliseconds>(
+    ndn::time::steady_clock::now() - m_rangeProgressStart).count() / TTL_TICK_MS;
 }
 
 void
-Worker::onInterest(const ndn::InterestFilter&, const ndn::Interest& interest)
+Worker::setHosts(const Bucket& bucket)
 {
-  auto reqName = interest.isSigned() ? interest.getName().getPrefix(-1) : interest.getName();
+  m_face.getIoService().post([this, confirmed = bucket.confirmedHosts, readers = bucket.readHosts] () mutable {
+    m_bucket.confirmedHosts = std::move(confirmed);
+    m_bucket.readHosts = std::move(readers);
+  });
+}
 
-  // Ignore interests from localhost
-  if (ndn::Name("localhost").isPrefixOf(reqName)) return;
+void
+Worker::handleInsert(const ndn::Name& dataName, const ndn::Interest& request, uint64_t commandCode,
+                     uint64_t ttl, const ndn::Name& source)
+{
+  m_face.getIoService().post([this, dataName, request, commandCode, ttl, source] {
+    coro::spawn(insert(dataName, request, commandCode, ttl, source));
+  });
+}
 
-  NDN_LOG_DEBUG("NEW_REQ : #" << m_bucket.id << " : " << reqName);
+void
+Worker::handleDelete(const ndn::Name& dataName, const ndn::Interest& request, uint64_t commandCode)
+{
+  m_face.getIoService().post([this, dataName, request, commandCode] {
+    coro::spawn(remove(dataName, request, commandCode));
+  });
+}
 
-  // Command Code
-  if (reqName.size() > 1 && reqName[-1].isNumber() &&
-      (m_bucketPrefix.isPrefixOf(reqName) || m_nodePrefix.isPrefixOf(reqName)))
+void
+Worker::handleFetch(const ndn::Interest& request)
+{
+  m_nReads++;
+  m_face.getIoService().post([this, request] { coro::spawn(fetch(request)); });
+}
+
+void
+Worker::handleDigest(const ndn::Name& node, const ndn::Interest& request)
+{
+  m_face.getIoService().post([this, node, request] {
+    if (m_antiEntropy)
+      m_antiEntropy->onDigestRequest(node, request);
+  });
+}
+
+void
+Worker::handleList(const ndn::Name& prefix, const ndn::Name& after, const ndn::Interest& request)
+{
+  m_face.getIoService().post([this, prefix, after, request] { list(prefix, after, request); });
+}
+
+ndn::Interest
+Worker::makeCommand(const ndn::Name& host, const ndn::Name& dataName, uint64_t commandCode, uint64_t ttl,
+                    uint64_t writeTime, const ndn::Name& source, uint64_t insertId)
+{
+  // Interest
+  ndn::Name interestName(host);
+  interestName.appendNumber(m_bucket.id);
+  interestName.append(dataName.wireEncode());
+  if (commandCode & CommandCodes::HAS_TTL)
+    interestName.appendNumber(ttl);
+  if (commandCode & CommandCodes::HAS_SOURCE)
+    interestName.append(source.wireEncode());
+  interestName.appendNumber(commandCode | CommandCodes::NO_REPLICATE);
+
+  ndn::Interest interest(interestName);
+  interest.setCanBePrefix(false);
+  interest.setMustBeFresh(true);
+
+  ndn::Block params(ndn::tlv::ApplicationParameters);
+  params.push_back(ndn::encoding::makeNonNegativeIntegerBlock(tlv::EntryWriteTime, writeTime));
+  if (insertId != 0)
+    params.push_back(ndn::encoding::makeNonNegativeIntegerBlock(tlv::InsertId, insertId));
+  params.encode();
+  interest.setApplicationParameters(params);
+
+  // Signature
+  ndn::security::SigningInfo interestSigningInfo;
+  interestSigningInfo.setSha256Signing();
+  interestSigningInfo.setSignedInterestFormat(ndn::security::SignedInterestFormat::V03);
+  m_keyChain.sign(interest, interestSigningInfo);
+
+  return interest;
+}
+
+coro::Task<int>
+Worker::replicate(ndn::Name dataName, uint64_t commandCode, uint64_t ttl)
+{
+  std::vector<ndn::Name> hosts;
+  std::vector<coro::Task<coro::Response>> replicas;
+
+  // All replicas order this version by the same time
+  const uint64_t writeTime = writeTimeNow();
+  for (const auto& host : m_bucket.confirmedHosts)
   {
-    uint64_t ccode = reqName[-1].toNumber();
+    hosts.push_back(host.first);
+    replicas.push_back(coro::send(m_face, makeCommand(host.first, dataName, commandCode, ttl, writeTime),
+                                  m_cancel));
+  }
 
-    if (ccode & CommandCodes::INSERT)
-    {
-      ndn::Name insertName(reqName.get(-2).blockFromValue());
-      insert(insertName, interest, ccode);
-      return;
-    }
+  // Read replicas serve from their own store, so they must not keep old versions or
+  // deleted entries; they are not needed to acknowledge
+  for (const auto& host : m_bucket.readHosts)
+    coro::spawn(updateReader(makeCommand(host.first, dataName, commandCode, ttl, writeTime)));
+
+  auto responses = co_await coro::whenAll(std::move(replicas));
+
+  int replicaCount = 0;
+  for (size_t i = 0; i < hosts.size(); i++)
+  {
+    if (responses[i])
+      replicaCount++;
+    else
+      RLOG_DEBUG("#{} : FAILED_REPLICATOR : {} : {} : {}", m_bucket.id, dataName, hosts[i],
+                 coro::toString(responses[i].status));
   }
 
-  // FETCH command
-  for (const auto& delegation : interest.getForwardingHint())
-    if (delegation.name.size() > 1 && delegation.name[-1].isNumber() &&
-        delegation.name[-1].toNumber() == CommandCodes::FETCH)
-      return this->fetch(interest);
+  co_return replicaCount;
 }
 
-void
-Worker::insert(const ndn::Name& dataName, const ndn::Interest& request, const uint64_t& commandCode)
+coro::Task<>
+Worker::updateReader(ndn::Interest command)
+{
+  auto response = co_await coro::send(m_face, command, m_cancel);
+  if (!response)
+  {
+    RLOG_DEBUG("#{} : FAILED_READER : {} : {}", m_bucket.id, command.getName(),
+               coro::toString(response.status));
+  }
+}
+
+coro::Task<>
+Worker::insert(ndn::Name dataName, ndn::Interest request, uint64_t commandCode, uint64_t ttl,
+               ndn::Name source)
 {
   if (commandCode & CommandCodes::NO_REPLICATE)
-    return insertNoReplicate(dataName, request, commandCode);
+  {
+    co_await insertNoReplicate(dataName, request, commandCode, ttl, source);
+    co_return;
+  }
 
-  std::shared_ptr<int> replicaCount = std::make_shared<int>(0);
+  if (m_erasureCode)
+  {
+    co_await insertErasureCoded(dataName, request, commandCode, ttl);
+    co_return;
+  }
+
+  if (commandCode & CommandCodes::IS_RANGE)
+  {
+    co_await insertRange(dataName, request, commandCode, ttl);
+    co_return;
+  }
+
+  // Replicate at all replicas
+  int replicaCount = co_await replicate(dataName, commandCode, ttl);
+
+  if (replicaCount >= NUM_REPLICA)
+  {
+    RLOG_DEBUG("#{} : ALL_REPLICAS : {}", m_bucket.id, dataName);
+    replyCommand(request);
+  }
+  else
+  {
+    NDN_LOG_INFO("#" << m_bucket.id << " : INSERT_FAILED : " << dataName
+                 << " : REPLICAS " << replicaCount);
+  }
+}
 
+coro::Task<>
+Worker::insertRange(ndn::Name dataName, ndn::Interest request, uint64_t commandCode, uint64_t ttl)
+{
+  if (dataName.size() <= 2 || !dataName[-1].isSegment() || !dataName[-2].isSegment() ||
+      dataName[-1].toSegment() < dataName[-2].toSegment())
+    co_return;
+
+  const uint64_t nSegs = dataName[-1].toSegment() - dataName[-2].toSegment() + 1;
+
+  // Replicas must reply with partial progress before the inserter gives up
+  const uint64_t writeTime = writeTimeNow();
+  const uint64_t insertId = readParameter(request, tlv::InsertId);
+  std::vector<ndn::Name> hosts;
+  std::vector<coro::Task<coro::Response>> replicas;
   for (const auto& host : m_bucket.confirmedHosts)
   {
-    // Interest
-    ndn::Name interestName(host.first);
-    interestName.appendNumber(m_bucket.id);
-    interestName.append(dataName.wireEncode());
-    interestName.appendNumber(commandCode | CommandCodes::NO_REPLICATE);
+    auto command = makeCommand(host.first, dataName, commandCode, ttl, writeTime, ndn::Name(), insertId);
+    command.setInterestLifetime(rangeBudget(request));
+    hosts.push_back(host.first);
+    replicas.push_back(coro::send(m_face, command, m_cancel));
+  }
 
-    ndn::Interest interest(interestName);
-    interest.setCanBePrefix(false);
-    interest.setMustBeFresh(true);
+  for (const auto& host : m_bucket.readHosts)
+  {
+    auto command = makeCommand(host.first, dataName, commandCode, ttl, writeTime, ndn::Name(), insertId);
+    command.setInterestLifetime(rangeBudget(request));
+    coro::spawn(updateReader(std::move(command)));
+  }
 
-    // Signature
-    ndn::security::SigningInfo interestSigningInfo;
-    interestSigningInfo.setSha256Signing();
-    interestSigningInfo.setSignedInterestFormat(ndn::security::SignedInterestFormat::V03);
-    m_keyChain.sign(interest, interestSigningInfo);
+  auto responses = co_await coro::whenAll(std::move(replicas));
 
+  // A segment is inserted once enough replicas stored it
+  std::vector<int> replicaCounts(nSegs, 0);
+  for (size_t i = 0; i < hosts.size(); i++)
+  {
+    if (!responses[i])
+    {
+      RLOG_DEBUG("#{} : FAILED_REPLICATOR : {} : {} : {}", m_bucket.id, dataName, hosts[i],
+                 coro::toString(responses[i].status));
+      continue;
+    }
 
-    // Replicate at all replicas
-    m_face.expressInterest(interest, [this, request, replicaCount, dataName] (const auto&, const auto& data) {
-      (*replicaCount)++;
-      NDN_LOG_TRACE("#" << m_bucket.id << " : INSERT_SUCCESS_REPLICATOR : "
-                  << data.getName() << " : REPLICA " << *replicaCount);
+    try {
+      const auto stored = RangeBitmap::decode(responses[i].data->getContent(), nSegs);
+      for (uint64_t seg = 0; seg < nSegs; seg++)
+        replicaCounts[seg] += stored[seg];
+    }
+    catch (const ndn::tlv::Error& e) {
+      RLOG_DEBUG("#{} : FAILED_REPLICATOR : {} : {} : {}", m_bucket.id, dataName, hosts[i], e.what());
+    }
+  }
 
-      // All replicas done
-      if ((*replicaCount) >= NUM_REPLICA)
-      {
-        NDN_LOG_DEBUG("#" << m_bucket.id << " : ALL_REPLICAS : " << dataName);
-        replyInsert(request);
-      }
-    }, nullptr, nullptr);
+  std::vector<bool> inserted(nSegs);
+  uint64_t nInserted = 0;
+  for (uint64_t seg = 0; seg < nSegs; seg++)
+  {
+    inserted[seg] = replicaCounts[seg] >= NUM_REPLICA;
+    nInserted += inserted[seg];
+  }
+
+  if (nInserted == nSegs)
+  {
+    RLOG_DEBUG("#{} : ALL_REPLICAS : {}", m_bucket.id, dataName);
+  }
+  else
+  {
+    NDN_LOG_INFO("#" << m_bucket.id << " : INSERT_PARTIAL : " << dataName
+                 << " : SEGMENTS " << nInserted << " OF " << nSegs);
   }
+
+  // The inserter sends the missing segments again
+  replyCommand(request, RangeBitmap::encode(inserted));
 }
 
-void
-Worker::insertNoReplicate(const ndn::Name& dataName, const ndn::Interest& request,
-                          const uint64_t& commandCode)
+coro::Task<>
+Worker::insertNoReplicate(ndn::Name dataName, ndn::Interest request, uint64_t commandCode,
+                          uint64_t ttl, ndn::Name source)
 {
   if (commandCode & CommandCodes::IS_RANGE)
-    return insertNoReplicateRange(dataName, request, commandCode);
+  {
+    co_await insertNoReplicateRange(dataName, request, commandCode, ttl, source);
+    co_return;
+  }
 
   // Request data
   ndn::Interest interest(dataName);
@@ -167,74 +532,732 @@ Worker::insertNoReplicate(const ndn::Name& dataName, const ndn::Interest& reques
   interest.setCanBePrefix(false);
   interest.setMustBeFresh(false);
   interest.setInterestLifetime(request.getInterestLifetime());
+  if (!source.empty())
+    interest.setForwardingHint(fetchHint(source, m_bucket.id));
 
-  m_face.expressInterest(interest, [this, request] (const auto&, const auto& data) {
-    if (store->put(data))
-      replyInsert(request);
-    else
-      NDN_LOG_TRACE("#" << m_bucket.id << " : FAILED_STORE_PUT : " << data.getName());
-  }, nullptr, nullptr);
+  if (co_await fetchAndStore(interest, m_cancel, ttl, readParameter(request, tlv::EntryWriteTime)))
+    replyCommand(request);
 }
 
-void
-Worker::insertNoReplicateRange(const ndn::Name& dataName, const ndn::Interest& request,
-                               const uint64_t& commandCode)
+coro::Task<>
+Worker::insertNoReplicateRange(ndn::Name dataName, ndn::Interest request, uint64_t commandCode,
+                               uint64_t ttl, ndn::Name source)
 {
-  if (dataName.size() <= 2 || !dataName[-1].isSegment() || !dataName[-2].isSegment())
-    return;
+  if (dataName.size() <= 2 || !dataName[-1].isSegment() || !dataName[-2].isSegment() ||
+      dataName[-1].toSegment() < dataName[-2].toSegment())
+    co_return;
 
   const auto startSeg = dataName[-2].toSegment();
-  const auto endSeg = dataName[-1].toSegment();
+  const uint64_t nSegs = dataName[-1].toSegment() - startSeg + 1;
 
   ndn::Name dataNamePrefix(dataName.getPrefix(-2));
 
-  const auto fetchedCount = std::make_shared<uint64_t>(0);
+  // Reply with what is stored while the command is still pending
+  const auto budget = rangeBudget(request);
+  auto deadline = coro::CancelToken::deadline(m_scheduler, budget, m_cancel);
 
-  for (auto currSeg = startSeg; currSeg <= endSeg; currSeg++)
+  // A name already stored may hold an older version, so only a retry of the same put skips it
+  const uint64_t insertId = readParameter(request, tlv::InsertId);
+  const uint64_t writeTime = readParameter(request, tlv::EntryWriteTime);
+  const RangeKey key(insertId, dataNamePrefix);
+
+  std::vector<bool> stored(nSegs, false);
+  std::vector<uint64_t> pending;
+  std::vector<coro::Task<bool>> fetches;
+  auto progress = insertId != 0 ? m_rangeProgress.find(key) : m_rangeProgress.end();
+  for (uint64_t seg = 0; seg < nSegs; seg++)
   {
-    // Request data
     ndn::Name interestName(dataNamePrefix);
-    interestName.appendSegment(currSeg);
+    interestName.appendSegment(startSeg + seg);
+
+    if (progress != m_rangeProgress.end())
+    {
+      const uint64_t bit = startSeg + seg - progress->second.first;
+      if (startSeg + seg >= progress->second.first && bit < progress->second.stored.size() &&
+          progress->second.stored[bit] && store->has(interestName))
+      {
+        store->setTtl(interestName, ttl);
+        stored[seg] = true;
+        continue;
+      }
+    }
 
+    // Request data
     ndn::Interest interest(interestName);
     interest.setCanBePrefix(false);
     interest.setMustBeFresh(false);
+    interest.setInterestLifetime(budget);
+    if (!source.empty())
+      interest.setForwardingHint(fetchHint(source, m_bucket.id));
+
+    pending.push_back(seg);
+    fetches.push_back(fetchAndStore(interest, deadline, ttl, writeTime));
+  }
+
+  auto results = co_await coro::whenAll(std::move(fetches));
+  for (size_t i = 0; i < pending.size(); i++)
+    stored[pending[i]] = results[i];
+
+  // One bitmap per put and object, kept while the put may still retry
+  if (insertId != 0)
+  {
+    auto& entry = m_rangeProgress[key];
+    if (entry.stored.empty())
+      entry.first = startSeg;
+    else if (startSeg < entry.first)
+    {
+      entry.stored.insert(entry.stored.begin(), entry.first - startSeg, false);
+      entry.first = startSeg;
+    }
+
+    const uint64_t offset = startSeg - entry.first;
+    if (entry.stored.size() < offset + nSegs)
+      entry.stored.resize(offset + nSegs, false);
+    for (uint64_t seg = 0; seg < nSegs; seg++)
+      entry.stored[offset + seg] = entry.stored[offset + seg] || stored[seg];
+
+    entry.expiry = rangeProgressTick() + RANGE_PROGRESS_MS / TTL_TICK_MS + 1;
+    m_rangeProgressWheel.schedule(entry.expiry, key);
+  }
+
+  RLOG_DEBUG("#{} : FETCHED : {} of {} : {} already stored", m_bucket.id,
+             std::count(results.begin(), results.end(), true), pending.size(), nSegs - pending.size());
+
+  replyCommand(request, RangeBitmap::encode(stored));
+}
+
+coro::Task<bool>
+Worker::fetchAndStore(ndn::Interest interest, coro::CancelToken token, uint64_t ttl, uint64_t writeTime)
+{
+  auto response = co_await coro::expressInterest(m_face, interest, token);
+  if (!response)
+  {
+    RLOG_TRACE("#{} : FAILED_FETCH : {} : {}", m_bucket.id, interest.getName(),
+               coro::toString(response.status));
+    co_return false;
+  }
+
+  co_return co_await storeDurably(*response.data, ttl, writeTime);
+}
+
+coro::Task<bool>
+Worker::storeDurably(ndn::Data data, uint64_t ttl, uint64_t writeTime)
+{
+  // Commands from older coordinators carry no write time
+  if (writeTime == 0)
+    writeTime = writeTimeNow();
+
+  // A version written later may have arrived first, e.g. through anti-entropy
+  if (store->isSuperseded(data.getName(), writeTime, data.getFullName()[-1]))
+  {
+    RLOG_TRACE("#{} : SUPERSEDED : {}", m_bucket.id, data.getName());
+    co_return true;
+  }
+
+  // Keep the result of a write already started unless shutting down
+  if (!co_await coro::put(*store, data, m_cancel))
+  {
+    RLOG_TRACE("#{} : FAILED_STORE_PUT : {}", m_bucket.id, data.getName());
+    co_return false;
+  }
+
+  store->clearTombstone(data.getName());
+  store->setTtl(data.getName(), ttl);
+  store->setWriteTime(data.getName(), writeTime);
+
+  if (m_wal)
+  {
+    if (!co_await coro::logPut(*m_wal, m_face.getIoService(), m_bucket.id, data, ttl, writeTime, m_cancel))
+    {
+      RLOG_TRACE("#{} : FAILED_LOG_PUT : {}", m_bucket.id, data.getName());
+      co_return false;
+    }
+    onLogged(data.wireEncode().size());
+  }
+
+  co_return true;
+}
+
+coro::Task<>
+Worker::repair(ndn::Data data, uint64_t ttl, uint64_t writeTime, std::function<void(bool)> done)
+{
+  done(co_await storeDurably(data, ttl, writeTime));
+}
+
+coro::Task<>
+Worker::insertErasureCoded(ndn::Name dataName, ndn::Interest request, uint64_t commandCode, uint64_t ttl)
+{
+  std::vector<ndn::Name> names;
+  if (commandCode & CommandCodes::IS_RANGE)
+  {
+    if (dataName.size() <= 2 || !dataName[-1].isSegment() || !dataName[-2].isSegment())
+      co_return;
+
+    for (auto seg = dataName[-2].toSegment(); seg <= dataName[-1].toSegment(); seg++)
+      names.push_back(dataName.getPrefix(-2).appendSegment(seg));
+  }
+  else
+  {
+    names.push_back(dataName);
+  }
+
+  // Parity has its own namespace, which clients cannot write to
+  for (const auto& name : names)
+  {
+    if (Stripe::isParityName(name))
+    {
+      NDN_LOG_INFO("#" << m_bucket.id << " : INSERT_FAILED : " << dataName << " : RESERVED " << name);
+      co_return;
+    }
+  }
+
+  std::vector<ndn::Name> hosts;
+  for (const auto& host : m_bucket.confirmedHosts)
+    hosts.push_back(host.first);
+  if (hosts.empty())
+    co_return;
+
+  // No use finishing after the inserter gave up on the command
+  auto deadline = coro::CancelToken::deadline(m_scheduler, request.getInterestLifetime(), m_cancel);
+
+  // Parity needs all the data here, so it is fetched from the client only once
+  std::vector<coro::Task<coro::Response>> fetches;
+  for (const auto& name : names)
+  {
+    ndn::Interest interest(name);
+    interest.setCanBePrefix(false);
+    interest.setMustBeFresh(false);
     interest.setInterestLifetime(request.getInterestLifetime());
+    fetches.push_back(coro::send(m_face, interest, deadline));
+  }
+  auto responses = co_await coro::whenAll(std::move(fetches));
+
+  // Members of each stripe in stripe order
+  std::map<ndn::Name, std::vector<std::shared_ptr<const ndn::Data>>> stripes;
+  for (size_t i = 0; i < names.size(); i++)
+  {
+    if (!responses[i])
+    {
+      NDN_LOG_INFO("#" << m_bucket.id << " : INSERT_FAILED : " << dataName
+                   << " : FETCH " << names[i] << " : " << responses[i].status);
+      co_return;
+    }
+
+    auto& members = stripes[Stripe::base(names[i])];
+    members.resize(EC_DATA_FRAGMENTS);
+    members[Stripe::index(names[i])] = std::make_shared<const ndn::Data>(*responses[i].data);
+  }
+
+  // Commands updating a stripe take turns, so parity always covers the members
+  // stored by the ones before; locks are taken in stripe order
+  for (const auto& stripe : stripes)
+    co_await lockStripe(stripe.first);
+
+  // Parity must cover members stored by other commands, so load them from their hosts
+  std::vector<std::pair<ndn::Name, size_t>> siblings;
+  std::vector<coro::Task<std::shared_ptr<const ndn::Data>>> siblingFetches;
+  for (const auto& stripe : stripes)
+  {
+    // Members after the last segment of the object do not exist
+    uint64_t lastSeg = std::numeric_limits<uint64_t>::max();
+    for (const auto& member : stripe.second)
+    {
+      if (member && member->getFinalBlock() && member->getFinalBlock()->isSegment())
+        lastSeg = member->getFinalBlock()->toSegment();
+    }
+
+    for (size_t i = 0; i < Stripe::width(stripe.first); i++)
+    {
+      const ndn::Name name = Stripe::member(stripe.first, i);
+      if (stripe.second[i] || (name[-1].isSegment() && name[-1].toSegment() > lastSeg))
+        continue;
+
+      siblings.emplace_back(stripe.first, i);
+      siblingFetches.push_back(fetchFromHost(hosts[Stripe::host(stripe.first, i, hosts.size())], name));
+    }
+  }
 
-    m_face.expressInterest(interest,
-      [this, fetchedCount, endSeg, startSeg, request] (const auto&, const auto& data)
+  // Absent ones are not inserted yet, and their own insert loads these members
+  auto siblingData = co_await coro::whenAll(std::move(siblingFetches));
+  std::set<ndn::Name> loaded;
+  for (size_t s = 0; s < siblings.size(); s++)
+  {
+    if (!siblingData[s])
+      continue;
+
+    stripes[siblings[s].first][siblings[s].second] = siblingData[s];
+    loaded.insert(siblingData[s]->getName());
+  }
+
+  std::vector<ndn::Name> outgoing;
+  std::vector<coro::Task<bool>> placements;
+  for (const auto& stripe : stripes)
+  {
+    const auto parity = encodeStripe(stripe.first, stripe.second);
+
+    for (size_t f = 0; f < EC_DATA_FRAGMENTS + EC_PARITY_FRAGMENTS; f++)
     {
-      NDN_LOG_DEBUG("FETCH" << *fetchedCount << " " << endSeg - startSeg + 1);
+      const auto& fragment = f < EC_DATA_FRAGMENTS ? stripe.second[f] : parity[f - EC_DATA_FRAGMENTS];
+      if (!fragment || loaded.count(fragment->getName()))
+        continue;
 
-      if (store->put(data))
-        (*fetchedCount)++;
-      else
-        NDN_LOG_TRACE("#" << m_bucket.id << " : FAILED_STORE_PUT : " << data.getName());
+      m_outgoing[fragment->getName()] = fragment;
+      outgoing.push_back(fragment->getName());
 
-      if (*fetchedCount == endSeg - startSeg + 1)
-        replyInsert(request);
-    }, nullptr, nullptr);
+      const auto& host = hosts[Stripe::host(stripe.first, f, hosts.size())];
+      placements.push_back(placeFragment(host, fragment, commandCode, ttl, deadline));
+    }
+  }
+
+  auto placed = co_await coro::whenAll(std::move(placements));
+  for (const auto& name : outgoing)
+    m_outgoing.erase(name);
+  for (const auto& stripe : stripes)
+    unlockStripe(stripe.first);
+
+  const auto placedCount = std::count(placed.begin(), placed.end(), true);
+  if (static_cast<size_t>(placedCount) == placed.size())
+  {
+    RLOG_DEBUG("#{} : ALL_FRAGMENTS : {}", m_bucket.id, dataName);
+    replyCommand(request);
+  }
+  else
+  {
+    NDN_LOG_INFO("#" << m_bucket.id << " : INSERT_FAILED : " << dataName
+                 << " : FRAGMENTS " << placedCount << "/" << placed.size());
   }
 }
 
+coro::Task<>
+Worker::lockStripe(ndn::Name base)
+{
+  auto& queue = m_stripeQueues[base];
+  auto turn = std::make_shared<coro::Event>();
+  queue.push_back(turn);
+  if (queue.size() == 1)
+    turn->set();
+
+  co_await *turn;
+}
+
 void
-Worker::replyInsert(const ndn::Interest& request)
+Worker::unlockStripe(const ndn::Name& base)
+{
+  auto it = m_stripeQueues.find(base);
+  if (it == m_stripeQueues.end())
+    return;
+
+  it->second.pop_front();
+  if (it->second.empty())
+  {
+    m_stripeQueues.erase(it);
+    return;
+  }
+
+  // Resumed from the event loop, not from inside the command releasing the stripe
+  m_face.getIoService().post([next = it->second.front()] { next->set(); });
+}
+
+std::vector<std::shared_ptr<const ndn::Data>>
+Worker::encodeStripe(const ndn::Name& base, const std::vector<std::shared_ptr<const ndn::Data>>& members)
 {
-  NDN_LOG_TRACE("#" << m_bucket.id << " : INSERT_SUCCESS_REPLY : " << request);
+  // Members are padded to the longest; absent ones are zero
+  size_t n = 0;
+  size_t len = 0;
+  for (size_t i = 0; i < members.size(); i++)
+  {
+    if (members[i])
+    {
+      n = i + 1;
+      len = std::max(len, members[i]->wireEncode().size());
+    }
+  }
+
+  std::vector<std::vector<uint8_t>> padded(n, std::vector<uint8_t>(len, 0));
+  std::vector<const uint8_t*> data(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    if (members[i])
+      std::memcpy(padded[i].data(), members[i]->wireEncode().wire(), members[i]->wireEncode().size());
+    data[i] = padded[i].data();
+  }
+
+  std::vector<std::vector<uint8_t>> parity(EC_PARITY_FRAGMENTS, std::vector<uint8_t>(len));
+  std::vector<uint8_t*> parityPtrs;
+  for (auto& p : parity)
+    parityPtrs.push_back(p.data());
+
+  m_erasureCode->encode(data.data(), n, parityPtrs.data(), len);
+
+  std::vector<std::shared_ptr<const ndn::Data>> packets;
+  for (size_t j = 0; j < EC_PARITY_FRAGMENTS; j++)
+  {
+    // Sizes tell which members are in the stripe and where they end
+    ndn::Block content(ndn::tlv::Content);
+    for (size_t i = 0; i < n; i++)
+      content.push_back(ndn::encoding::makeNonNegativeIntegerBlock(
+        tlv::StripeMemberSize, members[i] ? members[i]->wireEncode().size() : 0));
+    content.push_back(ndn::encoding::makeBinaryBlock(tlv::StripeParity, parity[j].data(), len));
+    content.encode();
+
+    auto packet = std::make_shared<ndn::Data>(Stripe::parityName(base, j));
+    packet->setContent(content);
+    ndn::security::SigningInfo info;
+    info.setSha256Signing();
+    m_keyChain.sign(*packet, info);
+    packets.push_back(packet);
+  }
+
+  return packets;
+}
+
+coro::Task<bool>
+Worker::placeFragment(ndn::Name host, std::shared_ptr<const ndn::Data> fragment, uint64_t commandCode,
+                      uint64_t ttl, coro::CancelToken token)
+{
+  // Fragments for this node skip the round trip
+  if (host == m_nodePrefix)
+    co_return co_await storeDurably(*fragment, ttl, 0);
+
+  const uint64_t ccode = (commandCode & ~CommandCodes::IS_RANGE) | CommandCodes::HAS_SOURCE;
+  auto command = makeCommand(host, fragment->getName(), ccode, ttl, writeTimeNow(), m_nodePrefix);
+  auto response = co_await coro::send(m_face, command, token);
+  if (!response)
+  {
+    RLOG_DEBUG("#{} : FAILED_FRAGMENT : {} : {} : {}", m_bucket.id, fragment->getName(), host,
+               coro::toString(response.status));
+  }
+  co_return bool(response);
+}
+
+coro::Task<std::shared_ptr<const ndn::Data>>
+Worker::fetchFromHost(ndn::Name host, ndn::Name name)
+{
+  if (host == m_nodePrefix)
+    co_return co_await coro::get(*store, name, m_cancel);
+
+  ndn::Interest interest(name);
+  interest.setCanBePrefix(false);
+  interest.setMustBeFresh(false);
+  interest.setInterestLifetime(ndn::time::milliseconds(EC_FETCH_TIMEOUT_MS));
+  interest.setForwardingHint(fetchHint(host, m_bucket.id));
+
+  auto response = co_await coro::expressInterest(m_face, interest, m_cancel);
+  if (!response)
+    co_return nullptr;
+  co_return std::make_shared<const ndn::Data>(*response.data);
+}
+
+coro::Task<std::shared_ptr<const ndn::Data>>
+Worker::reconstruct(ndn::Name name)
+{
+  std::vector<ndn::Name> hosts;
+  for (const auto& host : m_bucket.confirmedHosts)
+    hosts.push_back(host.first);
+  if (hosts.empty())
+    co_return nullptr;
+
+  const ndn::Name base = Stripe::base(name);
+  const size_t index = Stripe::index(name);
+  const size_t k = EC_DATA_FRAGMENTS;
+
+  // Usually the host of the fragment has it
+  const auto& holder = hosts[Stripe::host(base, index, hosts.size())];
+  if (holder != m_nodePrefix)
+  {
+    if (auto data = co_await fetchFromHost(holder, name))
+      co_return data;
+  }
+
+  // Parity tells which members the stripe has
+  std::vector<coro::Task<std::shared_ptr<const ndn::Data>>> parityFetches;
+  for (size_t j = 0; j < EC_PARITY_FRAGMENTS; j++)
+    parityFetches.push_back(fetchFromHost(hosts[Stripe::host(base, k + j, hosts.size())],
+                                          Stripe::parityName(base, j)));
+  auto parity = co_await coro::whenAll(std::move(parityFetches));
+
+  std::vector<size_t> sizes;
+  size_t len = 0;
+  std::vector<const uint8_t*> fragments(k + EC_PARITY_FRAGMENTS, nullptr);
+  for (size_t j = 0; j < parity.size(); j++)
+  {
+    std::vector<size_t> parsedSizes;
+    const uint8_t* bytes = nullptr;
+    size_t parsedLen = 0;
+    if (!parity[j] || !decodeParity(*parity[j], parsedSizes, bytes, parsedLen))
+      continue;
+
+    // Parity of a later encoding of the stripe does not mix with this one
+    if (sizes.empty())
+    {
+      sizes = parsedSizes;
+      len = parsedLen;
+    }
+    if (parsedSizes == sizes && parsedLen == len)
+      fragments[k + j] = bytes;
+  }
+
+  if (sizes.empty() || index >= sizes.size() || sizes[index] == 0 || sizes[index] > len)
+  {
+    RLOG_DEBUG("#{} : RECONSTRUCT_FAILED : {} : NO_PARITY", m_bucket.id, name);
+    co_return nullptr;
+  }
+
+  // Other members present in the stripe
+  std::vector<size_t> memberIndexes;
+  std::vector<coro::Task<std::shared_ptr<const ndn::Data>>> memberFetches;
+  for (size_t i = 0; i < sizes.size(); i++)
+  {
+    if (i == index || sizes[i] == 0)
+      continue;
+    memberIndexes.push_back(i);
+    memberFetches.push_back(fetchFromHost(hosts[Stripe::host(base, i, hosts.size())],
+                                          Stripe::member(base, i)));
+  }
+  auto members = co_await coro::whenAll(std::move(memberFetches));
+
+  const std::vector<uint8_t> zero(len, 0);
+  std::vector<std::vector<uint8_t>> padded(sizes.size());
+  for (size_t i = 0; i < sizes.size(); i++)
+  {
+    if (sizes[i] == 0)
+      fragments[i] = zero.data();
+  }
+  for (size_t m = 0; m < memberIndexes.size(); m++)
+  {
+    const size_t i = memberIndexes[m];
+    if (!members[m] || members[m]->wireEncode().size() != sizes[i])
+      continue;
+
+    padded[i].assign(len, 0);
+    std::memcpy(padded[i].data(), members[m]->wireEncode().wire(), sizes[i]);
+    fragments[i] = padded[i].data();
+  }
+
+  std::vector<uint8_t> decoded(len);
+  std::vector<uint8_t*> output(k, nullptr);
+  output[index] = decoded.data();
+  if (!m_erasureCode->reconstruct(fragments, sizes.size(), output, len))
+  {
+    RLOG_DEBUG("#{} : RECONSTRUCT_FAILED : {} : TOO_FEW_FRAGMENTS", m_bucket.id, name);
+    co_return nullptr;
+  }
+
+  try {
+    auto data = std::make_shared<ndn::Data>(ndn::Block(decoded.data(), sizes[index]));
+    if (data->getName() != name)
+      co_return nullptr;
+
+    RLOG_TRACE("#{} : RECONSTRUCTED : {}", m_bucket.id, name);
+    co_return data;
+  }
+  catch (const ndn::tlv::Error& e) {
+    RLOG_DEBUG("#{} : RECONSTRUCT_FAILED : {} : {}", m_bucket.id, name, e.what());
+    co_return nullptr;
+  }
+}
+
+coro::Task<>
+Worker::remove(ndn::Name dataName, ndn::Interest request, uint64_t commandCode)
+{
+  if (commandCode & CommandCodes::NO_REPLICATE)
+  {
+    // Acknowledged only once the removal would survive a restart
+    if (co_await removeNoReplicate(dataName, commandCode))
+      replyCommand(request);
+    co_return;
+  }
+
+  // Delete at all replicas; every host of an erasure-coded bucket has some fragments
+  int replicaCount = co_await replicate(dataName, commandCode, 0);
+  const size_t needed = m_erasureCode ? m_bucket.confirmedHosts.size() : NUM_REPLICA;
+
+  if (static_cast<size_t>(replicaCount) >= needed)
+  {
+    RLOG_DEBUG("#{} : ALL_REPLICAS_DELETED : {}", m_bucket.id, dataName);
+    replyCommand(request);
+  }
+  else
+  {
+    NDN_LOG_INFO("#" << m_bucket.id << " : DELETE_FAILED : " << dataName
+                 << " : REPLICAS " << replicaCount);
+  }
+}
+
+coro::Task<bool>
+Worker::removeNoReplicate(ndn::Name dataName, uint64_t commandCode)
+{
+  std::vector<ndn::Name> names;
+  if (!(commandCode & CommandCodes::IS_RANGE))
+  {
+    names.push_back(dataName);
+
+    // Parity of a stripe of one name goes with it
+    if (m_erasureCode && Stripe::base(dataName) == dataName && Stripe::width(dataName) == 1)
+    {
+      for (size_t j = 0; j < EC_PARITY_FRAGMENTS; j++)
+        names.push_back(Stripe::parityName(dataName, j));
+    }
+
+    RLOG_TRACE("#{} : DELETED : {}", m_bucket.id, dataName);
+    co_return co_await removeEntries(std::move(names));
+  }
+
+  if (dataName.size() <= 2 || !dataName[-1].isSegment() || !dataName[-2].isSegment())
+    co_return true;
+
+  const auto startSeg = dataName[-2].toSegment();
+  const auto endSeg = dataName[-1].toSegment();
+
+  for (auto currSeg = startSeg; currSeg <= endSeg; currSeg++)
+  {
+    ndn::Name name(dataName.getPrefix(-2));
+    name.appendSegment(currSeg);
+    names.push_back(name);
+  }
+
+  // Parity goes with stripes deleted whole; it still protects the rest of the others
+  for (auto currSeg = startSeg; m_erasureCode && currSeg <= endSeg; )
+  {
+    const ndn::Name base = Stripe::base(dataName.getPrefix(-2).appendSegment(currSeg));
+    const uint64_t baseSeg = base[-1].toSegment();
+    const uint64_t stripeEnd = baseSeg + Stripe::width(base) - 1;
+
+    if (baseSeg >= startSeg && stripeEnd <= endSeg)
+    {
+      for (size_t j = 0; j < EC_PARITY_FRAGMENTS; j++)
+        names.push_back(Stripe::parityName(base, j));
+    }
+    currSeg = stripeEnd + 1;
+  }
+
+  RLOG_TRACE("#{} : DELETED : {}", m_bucket.id, dataName);
+  co_return co_await removeEntries(std::move(names));
+}
+
+coro::Task<bool>
+Worker::removeEntries(std::vector<ndn::Name> dataNames)
+{
+  for (const auto& name : dataNames)
+    store->remove(name);
+
+  // All removals of a command go in one log record group
+  if (m_wal)
+  {
+    if (!co_await coro::logErase(*m_wal, m_face.getIoService(), m_bucket.id, dataNames, m_cancel))
+    {
+      RLOG_TRACE("#{} : FAILED_LOG_ERASE : {} names", m_bucket.id, dataNames.size());
+      co_return false;
+    }
+    size_t size = 0;
+    for (const auto& name : dataNames)
+      size += name.wireEncode().size();
+    onLogged(size);
+  }
+  co_return true;
+}
+
+void
+Worker::replyCommand(const ndn::Interest& request, const ndn::Block& content)
+{
+  RLOG_TRACE("#{} : COMMAND_SUCCESS_REPLY : {}", m_bucket.id, request.getName());
   ndn::Data response(request.getName());
+  if (content.isValid())
+    response.setContent(content);
   response.setFreshnessPeriod(ndn::time::seconds(10));
   ndn::security::SigningInfo info;
   info.setSha256Signing();
   m_keyChain.sign(response, info);
-  m_face.put(response);
+  m_dispatcher.put(response);
 }
 
 void
-Worker::fetch(const ndn::Interest& request)
+Worker::list(const ndn::Name& prefix, const ndn::Name& after, const ndn::Interest& request)
 {
-  auto data = this->store->get(request.getName());
+  ndn::Block content(ndn::tlv::Content);
+  size_t size = 0;
+  ndn::Name last;
+  bool isTruncated = false;
+
+  store->list(prefix, after, [&] (const ndn::Name& name) {
+    if (m_erasureCode && Stripe::isParityName(name))
+      return true;
+
+    const auto& wire = name.wireEncode();
+    if (size + wire.size() > LIST_PAGE_BYTES && size > 0)
+    {
+      isTruncated = true;
+      return false;
+    }
+
+    content.push_back(wire);
+    size += wire.size();
+    last = name;
+    return true;
+  });
+
+  // The last name resumes the listing, on this or any other replica
+  if (isTruncated)
+    content.push_back(ndn::encoding::makeNestedBlock(tlv::ListResumeToken, last));
+
+  content.encode();
+
+  ndn::Data response(request.getName());
+  response.setContent(content);
+  response.setFreshnessPeriod(ndn::time::milliseconds(0));
+
+  ndn::security::SigningInfo info;
+  info.setSha256Signing();
+  m_keyChain.sign(response, info);
+  m_dispatcher.put(response);
+
+  RLOG_TRACE("#{} : LIST : {} : {}", m_bucket.id, prefix, content.elements_size());
+}
+
+coro::Task<>
+Worker::fetch(ndn::Interest request)
+{
+  // Requests for a specific version carry the implicit digest
+  const ndn::Name& name = request.getName();
+  const ndn::Name dataName = name.size() > 0 && name[-1].isImplicitSha256Digest() ? name.getPrefix(-1) : name;
+
+  // Fragments being placed
+  auto it = m_outgoing.find(dataName);
+  if (it != m_outgoing.end())
+  {
+    m_dispatcher.put(*it->second);
+    co_return;
+  }
+
+  auto data = co_await coro::get(*store, dataName, m_cancel);
+  if (data || store->isRemoved(dataName))
+  {
+    if (data)
+      m_dispatcher.put(*data);
+    co_return;
+  }
+
+  // Other hosts asking for the local copy only get that
+  bool isClientRead = false;
+  for (const auto& delegation : request.getForwardingHint())
+    isClientRead |= m_configBundle.kuaPrefix.isPrefixOf(delegation.name);
+  if (!isClientRead)
+    co_return;
+
+  // Reads from clients may land on any host of a stripe
+  if (m_erasureCode)
+    data = co_await reconstruct(dataName);
+
+  // Read replicas catch up with new entries lazily; until then a write host has them
+  if (isReadReplica() && !m_bucket.confirmedHosts.empty())
+  {
+    auto host = m_bucket.confirmedHosts.begin();
+    std::advance(host, std::hash<ndn::Name>()(dataName) % m_bucket.confirmedHosts.size());
+    data = co_await fetchFromHost(host->first, dataName);
+  }
+
   if (data)
-    m_face.put(*data);
+    m_dispatcher.put(*data);
 }
 
 } // namespace kua
\ No newline at end of file
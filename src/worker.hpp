@@ -2,63 +2,277 @@
 
 #include <ndn-cxx/util/scheduler.hpp>
 
+#include <atomic>
+#include <thread>
+
 #include "config-bundle.hpp"
 #include "bucket.hpp"
 #include "store.hpp"
-#include "nlsr.hpp"
+#include "dispatcher.hpp"
+#include "anti-entropy.hpp"
+#include "erasure-code.hpp"
+#include "write-ahead-log.hpp"
+#include "coro.hpp"
+#include "timer-wheel.hpp"
+
+#include <deque>
+#include <map>
+#include <unordered_map>
 
 namespace kua {
 
 class Worker
 {
 public:
-  Worker(ConfigBundle& configBundle, const Bucket& bucket);
+  Worker(ConfigBundle& configBundle, const Bucket& bucket, Dispatcher& dispatcher);
 
   ~Worker();
 
-private:
+  /**
+   * Queue an INSERT command parsed by the dispatcher, with a TTL in ms or 0.
+   * The data is fetched from the source node if not empty, else by name.
+   */
+  void
+  handleInsert(const ndn::Name& dataName, const ndn::Interest& request, uint64_t commandCode,
+               uint64_t ttl, const ndn::Name& source);
+
+  /** Queue a DELETE command parsed by the dispatcher */
+  void
+  handleDelete(const ndn::Name& dataName, const ndn::Interest& request, uint64_t commandCode);
+
+  /** Queue a FETCH request routed by the dispatcher */
+  void
+  handleFetch(const ndn::Interest& request);
+
+  /** Queue a DIGEST request from another replica */
+  void
+  handleDigest(const ndn::Name& node, const ndn::Interest& request);
+
+  /** Queue a LIST request for names under a prefix, resuming after a name if not empty */
   void
-  onRegisterFailed(const ndn::Name& prefix, const std::string& reason);
+  handleList(const ndn::Name& prefix, const ndn::Name& after, const ndn::Interest& request);
 
+  /**
+   * Hand new hosts of the bucket to the worker thread, which keeps its own
+   * copy. Called from the thread running the bidder.
+   */
   void
-  onInterest(const ndn::InterestFilter&, const ndn::Interest& interest);
+  setHosts(const Bucket& bucket);
 
+  /** Get the number of reads since the last call. May be called from any thread. */
+  uint64_t
+  takeReadCount()
+  {
+    return m_nReads.exchange(0);
+  }
+
+private:
   void
   run();
 
+  /** Checkpoint now and then even if little was logged, so the log can be truncated */
+  void
+  checkpoint();
+
+  /**
+   * Count bytes logged for the bucket, and checkpoint once they reach a
+   * fraction of the store, so merges cost a bounded multiple of the log
+   */
   void
-  insert(const ndn::Name& dataName, const ndn::Interest& request, const uint64_t& commandCode);
+  onLogged(size_t size);
+
+  /** Merge the records logged since the last checkpoint into it, off the event loop */
+  coro::Task<>
+  saveCheckpoint();
 
+  /** Remove entries whose TTL has passed and forget old range progress */
   void
-  insertNoReplicate(const ndn::Name& dataName, const ndn::Interest& request, const uint64_t& commandCode);
+  expire();
+
+  /** Tick of the range progress wheel, in TTL_TICK_MS since the worker started */
+  uint64_t
+  rangeProgressTick() const;
+
+  /** Make a signed command for one host, not to be replicated further */
+  ndn::Interest
+  makeCommand(const ndn::Name& host, const ndn::Name& dataName, uint64_t commandCode, uint64_t ttl,
+              uint64_t writeTime, const ndn::Name& source = ndn::Name(), uint64_t insertId = 0);
+
+  /** Send a command to all replicas; returns the number that acknowledged */
+  coro::Task<int>
+  replicate(ndn::Name dataName, uint64_t commandCode, uint64_t ttl);
+
+  /** Send a command to a read replica without holding up the reply */
+  coro::Task<>
+  updateReader(ndn::Interest command);
+
+  coro::Task<>
+  insert(ndn::Name dataName, ndn::Interest request, uint64_t commandCode, uint64_t ttl,
+         ndn::Name source);
+
+  /**
+   * Insert a range of segments at all replicas.
+   * The reply has a bitmap of the segments stored at enough replicas.
+   */
+  coro::Task<>
+  insertRange(ndn::Name dataName, ndn::Interest request, uint64_t commandCode, uint64_t ttl);
 
+  coro::Task<>
+  insertNoReplicate(ndn::Name dataName, ndn::Interest request, uint64_t commandCode, uint64_t ttl,
+                    ndn::Name source);
+
+  /**
+   * Store a range of segments; the reply has a bitmap of them.
+   * Segments an earlier command of the same put stored are not fetched again.
+   */
+  coro::Task<>
+  insertNoReplicateRange(ndn::Name dataName, ndn::Interest request, uint64_t commandCode,
+                         uint64_t ttl, ndn::Name source);
+
+  /** Fetch a data packet from the inserting client or the source node and store it */
+  coro::Task<bool>
+  fetchAndStore(ndn::Interest interest, coro::CancelToken token, uint64_t ttl, uint64_t writeTime);
+
+  /**
+   * Store an inserted packet written at a time in ms since the epoch, or 0 for now,
+   * unless a later version is stored; completes once it survives a restart
+   */
+  coro::Task<bool>
+  storeDurably(ndn::Data data, uint64_t ttl, uint64_t writeTime);
+
+  /** Store an entry anti-entropy fetched the same way as an insert */
+  coro::Task<>
+  repair(ndn::Data data, uint64_t ttl, uint64_t writeTime, std::function<void(bool)> done);
+
+  /**
+   * Insert into an erasure-coded bucket.
+   * The data is fetched here once, encoded into stripes, and every fragment
+   * is stored at one host, which fetches it from this node. Members of a
+   * stripe that the command does not cover are loaded from their hosts so
+   * the new parity still protects them.
+   */
+  coro::Task<>
+  insertErasureCoded(ndn::Name dataName, ndn::Interest request, uint64_t commandCode, uint64_t ttl);
+
+  /** Wait for the turn of a command to update a stripe */
+  coro::Task<>
+  lockStripe(ndn::Name base);
+
+  /** End the turn of a command on a stripe and start the next one */
   void
-  insertNoReplicateRange(const ndn::Name& dataName, const ndn::Interest& request, const uint64_t& commandCode);
+  unlockStripe(const ndn::Name& base);
+
+  /** Compute the parity packets of a stripe; members are in stripe order, nullptr if absent */
+  std::vector<std::shared_ptr<const ndn::Data>>
+  encodeStripe(const ndn::Name& base, const std::vector<std::shared_ptr<const ndn::Data>>& members);
+
+  /** Store one fragment of a stripe at a host */
+  coro::Task<bool>
+  placeFragment(ndn::Name host, std::shared_ptr<const ndn::Data> fragment, uint64_t commandCode,
+                uint64_t ttl, coro::CancelToken token);
+
+  /** Get a packet from the store of one host only */
+  coro::Task<std::shared_ptr<const ndn::Data>>
+  fetchFromHost(ndn::Name host, ndn::Name name);
+
+  /** Get a packet of an erasure-coded bucket from its host, or decode it from the rest of its stripe */
+  coro::Task<std::shared_ptr<const ndn::Data>>
+  reconstruct(ndn::Name name);
 
+  coro::Task<>
+  remove(ndn::Name dataName, ndn::Interest request, uint64_t commandCode);
+
+  /**
+   * Remove a name, or a range /<prefix>/<start>/<end> of segments
+   * @return false if the removal could not be logged
+   */
+  coro::Task<bool>
+  removeNoReplicate(ndn::Name dataName, uint64_t commandCode);
+
+  /** Remove entries and wait until the removal is logged */
+  coro::Task<bool>
+  removeEntries(std::vector<ndn::Name> dataNames);
+
+  /** Acknowledge a command that completed, with optional reply content */
   void
-  replyInsert(const ndn::Interest& request);
+  replyCommand(const ndn::Interest& request, const ndn::Block& content = ndn::Block());
 
+  /** Reply with one page of names; the page ends with a resume token if more follow */
   void
-  fetch(const ndn::Interest& request);
+  list(const ndn::Name& prefix, const ndn::Name& after, const ndn::Interest& request);
+
+  /** Reply to a FETCH once the store completes the read */
+  coro::Task<>
+  fetch(ndn::Interest request);
+
+  /** Check if this node is an extra read-only replica of the bucket */
+  bool
+  isReadReplica() const
+  {
+    return m_bucket.readHosts.count(m_nodePrefix) > 0;
+  }
 
 public:
   std::shared_ptr<Store> store;
 
 private:
   ConfigBundle& m_configBundle;
-  const Bucket& m_bucket;
+  /** Hosts as last seen by the worker thread; the bidder changes its own copy */
+  Bucket m_bucket;
+  Dispatcher& m_dispatcher;
 
   ndn::Name m_nodePrefix;
-  ndn::Face m_face;
+  std::shared_ptr<ndn::Face> m_facePtr;
+  ndn::Face& m_face;
   ndn::Scheduler m_scheduler;
   ndn::KeyChain& m_keyChain;
 
-  ndn::Name m_bucketPrefix;
-  ndn::Name m_bucketNodePrefix;
+  /** Not used by erasure-coded buckets, which keep one copy of each fragment */
+  std::unique_ptr<AntiEntropy> m_antiEntropy;
+
+  /** Set for erasure-coded buckets */
+  std::unique_ptr<ErasureCode> m_erasureCode;
+  /** Fragments being placed, served to the hosts fetching them */
+  std::unordered_map<ndn::Name, std::shared_ptr<const ndn::Data>> m_outgoing;
+  /** Commands updating each stripe, the one holding it first */
+  std::map<ndn::Name, std::deque<std::shared_ptr<coro::Event>>> m_stripeQueues;
+
+  /** Put and object prefix of a range insert */
+  using RangeKey = std::pair<uint64_t, ndn::Name>;
+  struct RangeProgress
+  {
+    /** Segments stored, from the first segment number */
+    uint64_t first = 0;
+    std::vector<bool> stored;
+    /** Tick of the wheel entry that forgets it */
+    uint64_t expiry = 0;
+  };
+  /** Segments stored by recent range inserts, by the put that sent them */
+  std::map<RangeKey, RangeProgress> m_rangeProgress;
+  TimerWheel<RangeKey> m_rangeProgressWheel;
+  ndn::time::steady_clock::time_point m_rangeProgressStart = ndn::time::steady_clock::now();
+
+  ndn::scheduler::ScopedEventId m_expiryEvent;
+
+  /** Cancelled on shutdown to unwind pending requests */
+  coro::CancelToken m_cancel;
+
+  std::string m_checkpointPath;
+  /** Log position the checkpoint covers, and bytes logged since */
+  uint64_t m_checkpointPosition = 0;
+  uint64_t m_loggedBytes = 0;
+  /** A checkpoint is being written; the next one waits for it */
+  bool m_isCheckpointing = false;
+  ndn::scheduler::ScopedEventId m_checkpointEvent;
+  /** Runs checkpoint merges; joined before the face goes away */
+  std::thread m_checkpointThread;
+
+  /** Shared by the workers of the node; null if inserts are not logged */
+  std::shared_ptr<WriteAheadLog> m_wal;
 
-  std::shared_ptr<NLSR> nlsr;
+  std::atomic<uint64_t> m_nReads{0};
 
-  size_t m_failedRegistrations = 0;
+  std::thread m_thread;
 };
 
 } // namespace kua
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include "workload-trace.hpp"
+#include "ring-buffer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#define WORKLOAD_TRACE_HEADER "KUATRC2\n"
+#define WORKLOAD_TRACE_HEADER_V1 "KUATRC1\n"
+
+namespace kua {
+
+namespace {
+
+using TraceBuffer = RingBuffer<WORKLOAD_TRACE_BUFFER_BYTES>;
+
+struct State
+{
+  std::mutex mutex;
+  std::vector<std::shared_ptr<TraceBuffer>> buffers;
+  uint32_t nThreads = 0;
+
+  /** Writer state, guarded by the mutex */
+  FILE* file = nullptr;
+  bool isRunning = false;
+  std::condition_variable wake;
+  std::thread writer;
+};
+
+State&
+state()
+{
+  // Leaked so replies posted during exit never see it destroyed
+  static State* s = new State;
+  return *s;
+}
+
+thread_local ThreadBuffer<TraceBuffer> t_buffer;
+
+TraceBuffer&
+threadBuffer()
+{
+  if (!t_buffer.buffer)
+  {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    t_buffer.buffer = std::make_shared<TraceBuffer>(s.nThreads++);
+    s.buffers.push_back(t_buffer.buffer);
+  }
+  return *t_buffer.buffer;
+}
+
+/** Encode a record at the end of a buffer */
+void
+encode(std::vector<uint8_t>& out, WorkloadTrace::Kind kind, uint8_t flags, uint16_t command,
+       uint32_t bucket, uint32_t size, const ndn::Block& name, const ndn::Block* parameters = nullptr)
+{
+  const uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+  const uint16_t nameSize = name.size();
+  const uint16_t parametersSize = parameters != nullptr ? parameters->size() : 0;
+
+  auto put = [&out] (const auto& value) {
+    const auto* p = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), p, p + sizeof(value));
+  };
+  put(kind);
+  put(flags);
+  put(command);
+  put(bucket);
+  put(size);
+  put(time);
+  put(nameSize);
+  put(parametersSize);
+  out.insert(out.end(), name.wire(), name.wire() + nameSize);
+  if (parametersSize > 0)
+    out.insert(out.end(), parameters->wire(), parameters->wire() + parametersSize);
+}
+
+/** Hand a record to the buffer of this thread, which counts it as dropped if full */
+void
+append(WorkloadTrace::Kind kind, uint8_t flags, uint16_t command, uint32_t bucket, uint32_t size,
+       const ndn::Block& name, const ndn::Block* parameters = nullptr)
+{
+  // Names and parameters longer than a size field cannot be read back
+  if (name.size() > UINT16_MAX || (parameters != nullptr && parameters->size() > UINT16_MAX))
+    return;
+
+  thread_local std::vector<uint8_t> record;
+  record.clear();
+  encode(record, kind, flags, command, bucket, size, name, parameters);
+  threadBuffer().push(record.data(), record.size());
+}
+
+/** Write the records of each thread; buffers of exited threads are removed once drained */
+void
+flush(State& s, std::vector<uint8_t>& out)
+{
+  std::vector<std::shared_ptr<TraceBuffer>> buffers;
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    buffers = s.buffers;
+  }
+
+  std::vector<TraceBuffer*> released;
+  for (const auto& buffer : buffers)
+  {
+    // Checked first, so the drain below sees the last records of the thread
+    if (buffer->isReleased.load(std::memory_order_acquire))
+      released.push_back(buffer.get());
+
+    buffer->drain(out);
+
+    const uint64_t dropped = buffer->dropped.load(std::memory_order_relaxed);
+    if (dropped != buffer->droppedReported)
+    {
+      encode(out, WorkloadTrace::DROPPED, 0, 0, 0, dropped - buffer->droppedReported,
+             ndn::Name().wireEncode());
+      buffer->droppedReported = dropped;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(s.mutex);
+  s.buffers.erase(std::remove_if(s.buffers.begin(), s.buffers.end(), [&released] (const auto& buffer) {
+                    return std::find(released.begin(), released.end(), buffer.get()) != released.end();
+                  }),
+                  s.buffers.end());
+
+  if (s.file != nullptr)
+  {
+    std::fwrite(out.data(), 1, out.size(), s.file);
+    std::fflush(s.file);
+  }
+  out.clear();
+}
+
+} // namespace
+
+std::atomic<bool> WorkloadTrace::s_isEnabled{false};
+
+void
+WorkloadTrace::start(const std::string& path)
+{
+  std::string realPath = path;
+  const size_t pid = realPath.find("%p");
+  if (pid != std::string::npos)
+    realPath.replace(pid, 2, std::to_string(::getpid()));
+
+  auto& s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  if (s.isRunning)
+    return;
+
+  s.file = std::fopen(realPath.c_str(), "wb");
+  if (s.file == nullptr)
+    throw std::runtime_error("Cannot open trace file " + realPath);
+  std::fputs(WORKLOAD_TRACE_HEADER, s.file);
+
+  s.isRunning = true;
+  s.writer = std::thread([&s] {
+    std::vector<uint8_t> out;
+    std::unique_lock<std::mutex> lock(s.mutex);
+    while (s.isRunning)
+    {
+      s.wake.wait_for(lock, std::chrono::milliseconds(WORKLOAD_TRACE_FLUSH_MS));
+      lock.unlock();
+      flush(s, out);
+      lock.lock();
+    }
+  });
+
+  s_isEnabled.store(true, std::memory_order_relaxed);
+}
+
+void
+WorkloadTrace::startFromEnvironment()
+{
+  const char* path = std::getenv("KUA_TRACE_FILE");
+  if (path != nullptr && *path != '\0')
+    start(path);
+}
+
+void
+WorkloadTrace::stop()
+{
+  auto& s = state();
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.isRunning)
+      return;
+    s.isRunning = false;
+  }
+
+  s_isEnabled.store(false, std::memory_order_relaxed);
+  s.wake.notify_all();
+  s.writer.join();
+
+  std::vector<uint8_t> out;
+  flush(s, out);
+
+  std::lock_guard<std::mutex> lock(s.mutex);
+  std::fclose(s.file);
+  s.file = nullptr;
+}
+
+void
+WorkloadTrace::recordRequest(const ndn::Interest& interest, uint16_t command, uint32_t bucket,
+                             uint32_t size, uint8_t flags)
+{
+  if (interest.isSigned())
+    flags |= SIGNED;
+  append(REQUEST, flags, command, bucket, size, interest.getName().wireEncode(),
+         interest.hasApplicationParameters() ? &interest.getApplicationParameters() : nullptr);
+}
+
+void
+WorkloadTrace::recordReply(const ndn::Data& data)
+{
+  append(REPLY, 0, 0, 0, data.wireEncode().size(), data.getName().wireEncode());
+}
+
+WorkloadTrace::Reader::Reader(std::istream& is)
+  : m_is(is)
+{
+  char header[sizeof(WORKLOAD_TRACE_HEADER) - 1];
+  if (!m_is.read(header, sizeof(header)))
+    throw std::runtime_error("Not a kua trace file");
+
+  const std::string str(header, sizeof(header));
+  if (str == WORKLOAD_TRACE_HEADER)
+    m_version = 2;
+  else if (str == WORKLOAD_TRACE_HEADER_V1)
+    m_version = 1;
+  else
+    throw std::runtime_error("Not a kua trace file");
+}
+
+bool
+WorkloadTrace::Reader::read(Record& record)
+{
+  uint8_t header[WORKLOAD_TRACE_RECORD_HEADER + 2 * sizeof(uint16_t)];
+  const size_t headerSize = m_version >= 2 ? sizeof(header) : sizeof(header) - sizeof(uint16_t);
+  if (!m_is.read(reinterpret_cast<char*>(header), headerSize))
+    return false;
+
+  const uint8_t* p = header;
+  auto get = [&p] (auto& value) {
+    std::memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+  };
+  uint16_t nameSize, parametersSize = 0;
+  get(record.kind);
+  get(record.flags);
+  get(record.command);
+  get(record.bucket);
+  get(record.size);
+  get(record.time);
+  get(nameSize);
+  if (m_version >= 2)
+    get(parametersSize);
+
+  std::vector<uint8_t> wire(nameSize + parametersSize);
+  if (!m_is.read(reinterpret_cast<char*>(wire.data()), wire.size()))
+    return false;
+
+  try {
+    record.name = ndn::Name(ndn::Block(wire.data(), nameSize));
+    record.parameters = parametersSize > 0 ? ndn::Block(wire.data() + nameSize, parametersSize)
+                                           : ndn::Block();
+  }
+  catch (const ndn::tlv::Error&) {
+    return false;
+  }
+  return true;
+}
+
+} // namespace kua
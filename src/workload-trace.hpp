@@ -0,0 +1,114 @@
+#pragma once
+
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/interest.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <string>
+
+/** Bytes of records a thread holds for the writer before new ones are dropped */
+#define WORKLOAD_TRACE_BUFFER_BYTES (1 << 20)
+#define WORKLOAD_TRACE_FLUSH_MS 100
+/** Kind, flags, command, bucket, size and timestamp */
+#define WORKLOAD_TRACE_RECORD_HEADER 20
+
+namespace kua {
+
+/**
+ * Capture of the requests a node serves, for replay with kua-replay.
+ *
+ * The dispatcher records each command and fetch Interest it hands to a
+ * worker, with its parameters, and each Data it sends back, with a
+ * timestamp. Records go to a ring buffer of the calling thread, as in
+ * RingLog, and a background thread writes them to a file; a full buffer
+ * drops records and counts them in the file. Replies are matched to
+ * requests by name offline, which gives the service time of the node,
+ * without the network.
+ *
+ * Capture is off unless KUA_TRACE_FILE is set, and costs one relaxed
+ * load per request while off.
+ */
+class WorkloadTrace
+{
+public:
+  enum Kind : uint8_t
+  {
+    REQUEST = 'Q',
+    REPLY = 'R',
+    /** The size is the number of records dropped before this one */
+    DROPPED = 'D',
+  };
+
+  enum Flags : uint8_t
+  {
+    /** The last name component is the signature of the Interest */
+    SIGNED = 1,
+    /** Sent to the cluster prefix by a client, not to the node by a peer */
+    FROM_CLIENT = 2,
+  };
+
+  struct Record
+  {
+    Kind kind;
+    uint8_t flags = 0;
+    /** Command code, FETCH for reads */
+    uint16_t command = 0;
+    uint32_t bucket = 0;
+    /** Segments a request covers, or bytes of a reply */
+    uint32_t size = 0;
+    /** Nanoseconds since the epoch */
+    uint64_t time = 0;
+    ndn::Name name;
+    /** ApplicationParameters of a request, if it had any */
+    ndn::Block parameters;
+  };
+
+  static inline bool
+  isEnabled()
+  {
+    return s_isEnabled.load(std::memory_order_relaxed);
+  }
+
+  /** Start writing to a file; "%p" in the path is replaced by the process id */
+  static void
+  start(const std::string& path);
+
+  static void
+  startFromEnvironment();
+
+  /** Flush everything and stop the writer */
+  static void
+  stop();
+
+  static void
+  recordRequest(const ndn::Interest& interest, uint16_t command, uint32_t bucket, uint32_t size,
+                uint8_t flags);
+
+  static void
+  recordReply(const ndn::Data& data);
+
+  /** Reads the records of a trace file in the order they were written, which is per thread */
+  class Reader
+  {
+  public:
+    /** @throw std::runtime_error if the stream is not a trace */
+    explicit
+    Reader(std::istream& is);
+
+    /** Read the next record; false at the end or on a truncated record */
+    bool
+    read(Record& record);
+
+  private:
+    std::istream& m_is;
+    /** Traces before version 2 have no parameters */
+    int m_version;
+  };
+
+private:
+  static std::atomic<bool> s_isEnabled;
+};
+
+} // namespace kua
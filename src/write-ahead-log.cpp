@@ -0,0 +1,617 @@
+#include "write-ahead-log.hpp"
+
+#include <ndn-cxx/util/logger.hpp>
+
+#include <boost/crc.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#define WAL_SEGMENT_BYTES (64 << 20)
+/** Body size and CRC-32 of the body */
+#define WAL_RECORD_HEADER 8
+/** Type, bucket, and expiry and write time in ms since the epoch, before the block */
+#define WAL_RECORD_PREFIX 21
+#define WAL_MAX_RECORD_SIZE (1 << 24)
+
+namespace kua {
+
+NDN_LOG_INIT(kua.wal);
+
+namespace {
+
+uint32_t
+crc32(const uint8_t* data, size_t size)
+{
+  boost::crc_32_type crc;
+  crc.process_bytes(data, size);
+  return crc.checksum();
+}
+
+uint64_t
+nowMs()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/** Make a new file and its name durable */
+void
+syncDir(const std::string& dir)
+{
+  int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd >= 0)
+  {
+    ::fsync(fd);
+    ::close(fd);
+  }
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(const std::string& dir)
+  : m_dir(dir)
+{
+  std::filesystem::create_directories(m_dir);
+  scan();
+  openSegment(m_position);
+  m_committed = m_position;
+  m_committer = std::thread([this] { runCommitter(); });
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopping = true;
+  }
+  m_wake.notify_all();
+  m_committer.join();
+  ::close(m_fd);
+}
+
+std::string
+WriteAheadLog::dirPath(const std::string& stateDir)
+{
+  return stateDir + "/wal";
+}
+
+std::vector<uint8_t>
+WriteAheadLog::makeRecord(RecordType type, bucket_id_t bucketId, uint64_t expiry, uint64_t writeTime,
+                          const ndn::Block& block)
+{
+  const uint32_t bodySize = WAL_RECORD_PREFIX + block.size();
+  std::vector<uint8_t> record(WAL_RECORD_HEADER + bodySize);
+
+  uint8_t* body = record.data() + WAL_RECORD_HEADER;
+  const uint32_t bucket = bucketId;
+  body[0] = type;
+  std::memcpy(body + 1, &bucket, sizeof(bucket));
+  std::memcpy(body + 5, &expiry, sizeof(expiry));
+  std::memcpy(body + 13, &writeTime, sizeof(writeTime));
+  std::memcpy(body + WAL_RECORD_PREFIX, block.wire(), block.size());
+
+  const uint32_t crc = crc32(body, bodySize);
+  std::memcpy(record.data(), &bodySize, sizeof(bodySize));
+  std::memcpy(record.data() + 4, &crc, sizeof(crc));
+  return record;
+}
+
+void
+WriteAheadLog::appendPut(bucket_id_t bucketId, const ndn::Data& data, uint64_t ttl, uint64_t writeTime,
+                         boost::asio::io_service& ioService, Callback callback)
+{
+  const uint64_t expiry = ttl > 0 ? nowMs() + ttl : 0;
+  enqueue({ bucketId, makeRecord(PUT, bucketId, expiry, writeTime, data.wireEncode()),
+            &ioService, std::move(callback) });
+}
+
+void
+WriteAheadLog::appendErase(bucket_id_t bucketId, const std::vector<ndn::Name>& dataNames,
+                           boost::asio::io_service& ioService, Callback callback)
+{
+  std::vector<uint8_t> records;
+  for (const auto& name : dataNames)
+  {
+    const auto record = makeRecord(ERASE, bucketId, nowMs() + TOMBSTONE_LIFETIME_MS, nowMs(), name.wireEncode());
+    records.insert(records.end(), record.begin(), record.end());
+  }
+  enqueue({ bucketId, std::move(records), &ioService, std::move(callback) });
+}
+
+void
+WriteAheadLog::enqueue(Pending&& pending)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  // The first record opens the commit window; a full batch closes it early
+  if (m_queue.empty())
+    m_queueStart = std::chrono::steady_clock::now();
+
+  m_position += pending.record.size();
+  m_queueBytes += pending.record.size();
+  m_queue.push_back(std::move(pending));
+
+  if (m_queue.size() == 1 || m_queueBytes >= WAL_COMMIT_MAX_BYTES)
+    m_wake.notify_one();
+}
+
+uint64_t
+WriteAheadLog::committedPosition()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_committed;
+}
+
+void
+WriteAheadLog::readRecords(bucket_id_t bucketId, uint64_t from, uint64_t to, const RecordVisitor& visit)
+{
+  // Segments needed by the bucket are not deleted until it checkpoints past them
+  std::vector<std::pair<uint64_t, std::string>> files;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < m_segments.size(); i++)
+    {
+      const bool isBefore = i + 1 < m_segments.size() && m_segments[i + 1].first <= from;
+      if (!isBefore && m_segments[i].first < to && m_segments[i].buckets.count(bucketId) > 0)
+        files.emplace_back(m_segments[i].first, m_segments[i].path);
+    }
+  }
+
+  std::vector<uint8_t> body;
+  for (const auto& file : files)
+  {
+    // Bytes up to the committed position are synced, so the active segment can be read too
+    std::ifstream is(file.second, std::ios::binary);
+    for (uint64_t position = file.first; position < to; )
+    {
+      uint32_t header[2];
+      if (!is.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+          header[0] < WAL_RECORD_PREFIX || header[0] > WAL_MAX_RECORD_SIZE)
+        break;
+
+      body.resize(header[0]);
+      if (!is.read(reinterpret_cast<char*>(body.data()), body.size()) ||
+          crc32(body.data(), body.size()) != header[1])
+        break;
+
+      const uint64_t start = position;
+      position += WAL_RECORD_HEADER + body.size();
+
+      uint32_t id;
+      std::memcpy(&id, body.data() + 1, sizeof(id));
+      if (id != bucketId || start < from || position > to)
+        continue;
+
+      uint64_t expiry, writeTime;
+      std::memcpy(&expiry, body.data() + 5, sizeof(expiry));
+      std::memcpy(&writeTime, body.data() + 13, sizeof(writeTime));
+
+      try {
+        ndn::Block block(body.data() + WAL_RECORD_PREFIX, body.size() - WAL_RECORD_PREFIX);
+        visit(start, static_cast<RecordType>(body[0]), expiry, writeTime, block);
+      }
+      catch (const ndn::tlv::Error& e) {
+        NDN_LOG_WARN("Bad log record in " << file.second << " : " << e.what());
+      }
+    }
+  }
+}
+
+void
+WriteAheadLog::checkpointed(bucket_id_t bucketId, uint64_t position)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_checkpoints[bucketId] = std::max(m_checkpoints[bucketId], position);
+  truncate();
+}
+
+void
+WriteAheadLog::release(bucket_id_t bucketId)
+{
+  // Queued records go out with the batch after the one being written
+  std::unique_lock<std::mutex> lock(m_mutex);
+  const uint64_t batch = m_queue.empty() ? m_nBatches : m_nBatches + 1;
+  m_committedCv.wait(lock, [this, batch] { return m_nProcessed >= batch; });
+
+  m_active.erase(bucketId);
+  m_checkpoints.erase(bucketId);
+  truncate();
+}
+
+void
+WriteAheadLog::truncate()
+{
+  // The active segment is always kept
+  while (m_segments.size() > 1)
+  {
+    const Segment& segment = m_segments.front();
+    const uint64_t end = m_segments[1].first;
+
+    // Buckets no longer served here do not hold back the log
+    const bool isNeeded = std::any_of(segment.buckets.begin(), segment.buckets.end(), [&] (bucket_id_t id) {
+      auto it = m_checkpoints.find(id);
+      return m_active.count(id) > 0 && (it == m_checkpoints.end() || it->second < end);
+    });
+    if (isNeeded)
+      return;
+
+    std::filesystem::remove(segment.path);
+    for (auto& records : m_recovered)
+    {
+      records.second.erase(std::remove_if(records.second.begin(), records.second.end(),
+                                          [&] (const auto& r) { return r.first == segment.path; }),
+                           records.second.end());
+    }
+    NDN_LOG_DEBUG("Deleted log segment " << segment.path);
+    m_segments.pop_front();
+  }
+}
+
+void
+WriteAheadLog::scan()
+{
+  std::vector<std::pair<uint64_t, std::string>> files;
+  for (const auto& entry : std::filesystem::directory_iterator(m_dir))
+  {
+    if (entry.path().extension() != ".wal")
+      continue;
+
+    try {
+      files.emplace_back(std::stoull(entry.path().stem().string()), entry.path().string());
+    }
+    catch (const std::exception&) {
+    }
+  }
+  std::sort(files.begin(), files.end());
+
+  for (const auto& file : files)
+  {
+    Segment segment{ file.first, file.second, {} };
+    std::ifstream is(file.second, std::ios::binary);
+
+    // A torn record ends the segment; nothing after it was acknowledged
+    uint64_t offset = 0;
+    std::vector<uint8_t> body;
+    while (true)
+    {
+      uint32_t header[2];
+      if (!is.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+          header[0] < WAL_RECORD_PREFIX || header[0] > WAL_MAX_RECORD_SIZE)
+        break;
+
+      body.resize(header[0]);
+      if (!is.read(reinterpret_cast<char*>(body.data()), body.size()) ||
+          crc32(body.data(), body.size()) != header[1])
+        break;
+
+      uint32_t bucketId;
+      std::memcpy(&bucketId, body.data() + 1, sizeof(bucketId));
+      segment.buckets.insert(bucketId);
+      m_recovered[bucketId].emplace_back(file.second, offset);
+      offset += WAL_RECORD_HEADER + body.size();
+    }
+
+    // Segments cut off before their first record held nothing acknowledged
+    m_position = file.first + offset;
+    if (offset == 0)
+      std::filesystem::remove(file.second);
+    else
+      m_segments.push_back(std::move(segment));
+  }
+
+  if (!m_segments.empty())
+    NDN_LOG_INFO("Found " << m_segments.size() << " log segments up to position " << m_position);
+}
+
+size_t
+WriteAheadLog::replay(bucket_id_t bucketId, Store& store)
+{
+  std::vector<std::pair<std::string, uint64_t>> records;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_active.insert(bucketId);
+    auto it = m_recovered.find(bucketId);
+    if (it != m_recovered.end())
+    {
+      records = std::move(it->second);
+      m_recovered.erase(it);
+    }
+  }
+
+  size_t count = 0;
+  std::ifstream is;
+  std::string openPath;
+  std::vector<uint8_t> body;
+  const uint64_t now = nowMs();
+  for (const auto& record : records)
+  {
+    if (record.first != openPath)
+    {
+      is = std::ifstream(record.first, std::ios::binary);
+      openPath = record.first;
+    }
+
+    uint32_t header[2];
+    is.seekg(record.second);
+    if (!is.read(reinterpret_cast<char*>(header), sizeof(header)))
+      break;
+    body.resize(header[0]);
+    if (!is.read(reinterpret_cast<char*>(body.data()), body.size()))
+      break;
+
+    uint64_t expiry, writeTime;
+    std::memcpy(&expiry, body.data() + 5, sizeof(expiry));
+    std::memcpy(&writeTime, body.data() + 13, sizeof(writeTime));
+
+    try {
+      ndn::Block block(body.data() + WAL_RECORD_PREFIX, body.size() - WAL_RECORD_PREFIX);
+      if (body[0] == PUT)
+      {
+        ndn::Data data(block);
+        if (expiry > 0 && expiry <= now)
+        {
+          store.remove(data.getName());
+          continue;
+        }
+
+        store.put(data);
+        store.clearTombstone(data.getName());
+        store.setTtl(data.getName(), expiry > 0 ? expiry - now : 0);
+        store.setWriteTime(data.getName(), writeTime);
+      }
+      else if (body[0] == ERASE)
+      {
+        store.remove(ndn::Name(block));
+      }
+      count++;
+    }
+    catch (const ndn::tlv::Error& e) {
+      NDN_LOG_WARN("Bad log record in " << record.first << " : " << e.what());
+    }
+  }
+
+  return count;
+}
+
+void
+WriteAheadLog::openSegment(uint64_t first)
+{
+  char name[32];
+  std::snprintf(name, sizeof(name), "%020llu.wal", static_cast<unsigned long long>(first));
+  const std::string path = m_dir + "/" + name;
+
+  const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    throw std::runtime_error("Cannot open log segment " + path + ": " + std::strerror(errno));
+  syncDir(m_dir);
+
+  if (m_fd >= 0)
+    ::close(m_fd);
+  m_fd = fd;
+  m_segmentSize = 0;
+
+  // Reopening an empty segment after a failed write replaces it
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_segments.empty() || m_segments.back().first != first)
+    m_segments.push_back({ first, path, {} });
+}
+
+void
+WriteAheadLog::runCommitter()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true)
+  {
+    m_wake.wait(lock, [this] { return !m_queue.empty() || m_isStopping; });
+    if (m_queue.empty())
+      return;
+
+    // Let more records join the commit until the window closes
+    m_wake.wait_until(lock, m_queueStart + std::chrono::microseconds(WAL_COMMIT_WINDOW_US),
+                      [this] { return m_queueBytes >= WAL_COMMIT_MAX_BYTES || m_isStopping; });
+
+    std::vector<Pending> batch;
+    batch.swap(m_queue);
+    m_queueBytes = 0;
+    m_nBatches++;
+
+    lock.unlock();
+    commit(batch);
+    lock.lock();
+  }
+}
+
+void
+WriteAheadLog::commit(std::vector<Pending>& batch)
+{
+  uint64_t committed;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    committed = m_committed;
+  }
+
+  // Positions are offsets into the segment, so a segment must start where the batch does
+  bool ok = true;
+  if (m_needsSegment || m_segmentSize >= WAL_SEGMENT_BYTES)
+  {
+    try {
+      openSegment(committed);
+      m_needsSegment = false;
+    }
+    catch (const std::runtime_error& e) {
+      NDN_LOG_ERROR(e.what());
+      m_needsSegment = true;
+      ok = false;
+    }
+  }
+
+  size_t size = 0;
+  for (const auto& pending : batch)
+    size += pending.record.size();
+
+  std::vector<uint8_t> buffer;
+  buffer.reserve(size);
+  for (const auto& pending : batch)
+    buffer.insert(buffer.end(), pending.record.begin(), pending.record.end());
+
+  for (size_t written = 0; ok && written < buffer.size(); )
+  {
+    const ssize_t ret = ::write(m_fd, buffer.data() + written, buffer.size() - written);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+    {
+      ok = false;
+      break;
+    }
+    written += ret;
+  }
+  ok = ok && ::fdatasync(m_fd) == 0;
+
+  if (ok)
+  {
+    m_segmentSize += size;
+  }
+  else
+  {
+    NDN_LOG_ERROR("Failed to write " << batch.size() << " log records: " << std::strerror(errno));
+    if (!m_needsSegment)
+      discard();
+  }
+
+  for (auto& pending : batch)
+  {
+    if (pending.callback)
+      pending.ioService->post([callback = std::move(pending.callback), ok] { callback(ok); });
+  }
+
+  // Released buckets may destroy their io_service once this is seen
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (ok)
+    {
+      for (const auto& pending : batch)
+        m_segments.back().buckets.insert(pending.bucketId);
+    }
+    // The positions of a failed batch stay unused
+    m_committed += size;
+    m_nProcessed++;
+  }
+  m_committedCv.notify_all();
+}
+
+void
+WriteAheadLog::discard()
+{
+  // Records of the failed batch that reached the file must not be replayed
+  if (::ftruncate(m_fd, m_segmentSize) != 0 || ::fdatasync(m_fd) != 0)
+    NDN_LOG_ERROR("Failed to truncate log segment: " << std::strerror(errno));
+
+  // Later batches start past the gap the failed one leaves
+  m_needsSegment = true;
+}
+
+namespace coro {
+namespace {
+
+class LogPutAwaiter : public detail::CallbackAwaiter<bool>
+{
+public:
+  LogPutAwaiter(WriteAheadLog& wal, boost::asio::io_service& ioService, bucket_id_t bucketId,
+                const ndn::Data& data, uint64_t ttl, uint64_t writeTime, const CancelToken& token)
+    : CallbackAwaiter(token)
+    , m_wal(wal)
+    , m_ioService(ioService)
+    , m_bucketId(bucketId)
+    , m_data(data)
+    , m_ttl(ttl)
+    , m_writeTime(writeTime)
+  { }
+
+protected:
+  void
+  begin(const Pending& pending) final
+  {
+    m_wal.appendPut(m_bucketId, m_data, m_ttl, m_writeTime, m_ioService, [this, pending] (bool ok) {
+      if (*pending)
+        complete(ok);
+    });
+  }
+
+  void
+  onCancel() final
+  {
+    // The record is still written; only the wait ends
+  }
+
+private:
+  WriteAheadLog& m_wal;
+  boost::asio::io_service& m_ioService;
+  bucket_id_t m_bucketId;
+  const ndn::Data& m_data;
+  uint64_t m_ttl;
+  uint64_t m_writeTime;
+};
+
+class LogEraseAwaiter : public detail::CallbackAwaiter<bool>
+{
+public:
+  LogEraseAwaiter(WriteAheadLog& wal, boost::asio::io_service& ioService, bucket_id_t bucketId,
+                  const std::vector<ndn::Name>& dataNames, const CancelToken& token)
+    : CallbackAwaiter(token)
+    , m_wal(wal)
+    , m_ioService(ioService)
+    , m_bucketId(bucketId)
+    , m_dataNames(dataNames)
+  { }
+
+protected:
+  void
+  begin(const Pending& pending) final
+  {
+    m_wal.appendErase(m_bucketId, m_dataNames, m_ioService, [this, pending] (bool ok) {
+      if (*pending)
+        complete(ok);
+    });
+  }
+
+  void
+  onCancel() final
+  {
+    // The records are still written; only the wait ends
+  }
+
+private:
+  WriteAheadLog& m_wal;
+  boost::asio::io_service& m_ioService;
+  bucket_id_t m_bucketId;
+  const std::vector<ndn::Name>& m_dataNames;
+};
+
+} // namespace
+
+Task<bool>
+logPut(WriteAheadLog& wal, boost::asio::io_service& ioService, bucket_id_t bucketId,
+       ndn::Data data, uint64_t ttl, uint64_t writeTime, CancelToken token)
+{
+  co_return co_await LogPutAwaiter(wal, ioService, bucketId, data, ttl, writeTime, token);
+}
+
+Task<bool>
+logErase(WriteAheadLog& wal, boost::asio::io_service& ioService, bucket_id_t bucketId,
+         std::vector<ndn::Name> dataNames, CancelToken token)
+{
+  co_return co_await LogEraseAwaiter(wal, ioService, bucketId, dataNames, token);
+}
+
+} // namespace coro
+
+} // namespace kua
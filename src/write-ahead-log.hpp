@@ -0,0 +1,207 @@
+#pragma once
+
+#include "config-bundle.hpp"
+#include "bucket.hpp"
+#include "store.hpp"
+#include "coro.hpp"
+
+#include <boost/asio/io_service.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kua {
+
+/**
+ * Write-ahead log shared by all workers of a node.
+ *
+ * Workers append a record after changing their store, and acknowledge an
+ * insert once its record is on disk. Records of all buckets are written
+ * by one thread in group commits: the first record of a commit opens a
+ * window of WAL_COMMIT_WINDOW_US, and everything appended until it closes
+ * or WAL_COMMIT_MAX_BYTES are queued goes out with one write and one
+ * fdatasync. The log is a series of segment files named by the position
+ * of their first record. Checkpoints are built from the records of a
+ * bucket, and a segment is deleted once every bucket with records in it
+ * has saved a checkpoint past its end.
+ */
+class WriteAheadLog
+{
+public:
+  using Callback = std::function<void(bool)>;
+
+  enum RecordType : uint8_t
+  {
+    PUT = 1,
+    /** Expiry is when the tombstone can be forgotten */
+    ERASE = 2,
+  };
+
+  /**
+   * Called with the position, type, expiry and write time in ms since the
+   * epoch, and block of a record
+   */
+  using RecordVisitor = std::function<void(uint64_t, RecordType, uint64_t, uint64_t, const ndn::Block&)>;
+
+  /** Open the log in a directory, indexing the records left by the last run */
+  explicit
+  WriteAheadLog(const std::string& dir);
+
+  ~WriteAheadLog();
+
+  static std::string
+  dirPath(const std::string& stateDir);
+
+  /**
+   * Log a put with a TTL in ms, or 0, and the write time of the version.
+   * The callback is posted to the io_service once the record is durable.
+   */
+  void
+  appendPut(bucket_id_t bucketId, const ndn::Data& data, uint64_t ttl, uint64_t writeTime,
+            boost::asio::io_service& ioService, Callback callback);
+
+  /**
+   * Log the removal of some names in one go.
+   * The callback is posted to the io_service once the records are durable.
+   */
+  void
+  appendErase(bucket_id_t bucketId, const std::vector<ndn::Name>& dataNames,
+              boost::asio::io_service& ioService, Callback callback);
+
+  /**
+   * Apply the records of a bucket left by the last run to its store, in
+   * log order, and keep its records until it saves a checkpoint.
+   * @return number of records applied
+   */
+  size_t
+  replay(bucket_id_t bucketId, Store& store);
+
+  /** Position up to which records are on disk, or were dropped by a failed commit */
+  uint64_t
+  committedPosition();
+
+  /**
+   * Read the records of a bucket in a range of positions from disk, in log
+   * order; may be called from any thread
+   */
+  void
+  readRecords(bucket_id_t bucketId, uint64_t from, uint64_t to, const RecordVisitor& visit);
+
+  /** Note that a checkpoint of a bucket covers the log up to a position */
+  void
+  checkpointed(bucket_id_t bucketId, uint64_t position);
+
+  /**
+   * Wait for the commits of records appended so far, whether they succeed
+   * or not, and stop keeping records of a bucket
+   */
+  void
+  release(bucket_id_t bucketId);
+
+private:
+  struct Segment
+  {
+    uint64_t first;
+    std::string path;
+    /** Buckets with records in the segment */
+    std::set<bucket_id_t> buckets;
+  };
+
+  struct Pending
+  {
+    bucket_id_t bucketId;
+    /** One or more records, written together */
+    std::vector<uint8_t> record;
+    boost::asio::io_service* ioService;
+    Callback callback;
+  };
+
+  /** Make a record of a block, with its header */
+  static std::vector<uint8_t>
+  makeRecord(RecordType type, bucket_id_t bucketId, uint64_t expiry, uint64_t writeTime,
+             const ndn::Block& block);
+
+  void
+  enqueue(Pending&& pending);
+
+  /** Find the records in the segments of the last run */
+  void
+  scan();
+
+  void
+  openSegment(uint64_t first);
+
+  void
+  runCommitter();
+
+  /** Write and sync a batch, then run its callbacks */
+  void
+  commit(std::vector<Pending>& batch);
+
+  /**
+   * Drop the bytes of a batch that failed and continue in a new segment
+   * at the position after it, so records queued since keep their positions
+   */
+  void
+  discard();
+
+  /** Delete segments no bucket needs; call with the lock held */
+  void
+  truncate();
+
+private:
+  const std::string m_dir;
+  int m_fd = -1;
+  uint64_t m_segmentSize = 0;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_committedCv;
+  std::vector<Pending> m_queue;
+  size_t m_queueBytes = 0;
+  std::chrono::steady_clock::time_point m_queueStart;
+  /**
+   * Position of the next record appended, and of the end of the batches
+   * processed; a failed batch leaves a gap of unused positions
+   */
+  uint64_t m_position = 0;
+  uint64_t m_committed = 0;
+  /** Batches taken from the queue, and batches whose callbacks have run */
+  uint64_t m_nBatches = 0;
+  uint64_t m_nProcessed = 0;
+  /** The segment could not be cut back after a failure; open a new one first */
+  bool m_needsSegment = false;
+  bool m_isStopping = false;
+
+  std::deque<Segment> m_segments;
+  /** Records of the last run by bucket, as segment file and offset */
+  std::map<bucket_id_t, std::vector<std::pair<std::string, uint64_t>>> m_recovered;
+  std::set<bucket_id_t> m_active;
+  std::map<bucket_id_t, uint64_t> m_checkpoints;
+
+  std::thread m_committer;
+};
+
+namespace coro {
+
+/** Log a put and wait until it is durable */
+Task<bool>
+logPut(WriteAheadLog& wal, boost::asio::io_service& ioService, bucket_id_t bucketId,
+       ndn::Data data, uint64_t ttl, uint64_t writeTime, CancelToken token = CancelToken());
+
+/** Log removals and wait until they are durable */
+Task<bool>
+logErase(WriteAheadLog& wal, boost::asio::io_service& ioService, bucket_id_t bucketId,
+         std::vector<ndn::Name> dataNames, CancelToken token = CancelToken());
+
+} // namespace coro
+
+} // namespace kua